@@ -0,0 +1,70 @@
+// Copyright (C) 2015 chenqiang@outlook.com. All rights reserved.
+// Distributed under the terms and conditions of the Apache License.
+// See accompanying files LICENSE.
+
+#include "Arena.h"
+#include <stdlib.h>
+#include <new>
+
+
+namespace {
+
+// Block headers are padded so the data after them stays aligned
+const size_t kHeaderSize = 16;
+
+} // anonymous namespace
+
+Arena::Arena(size_t blockSize)
+    : blocks_(nullptr),
+      ptr_(nullptr),
+      end_(nullptr),
+      blockSize_(blockSize),
+      totalSize_(0)
+{
+}
+
+Arena::~Arena()
+{
+    clear();
+}
+
+void Arena::clear()
+{
+    while (blocks_ != nullptr)
+    {
+        Block* next = blocks_->next;
+        free(blocks_);
+        blocks_ = next;
+    }
+    ptr_ = end_ = nullptr;
+    totalSize_ = 0;
+}
+
+void* Arena::allocateSlow(size_t size)
+{
+    static_assert(sizeof(Block) <= kHeaderSize, "block header too big");
+
+    // Oversized requests get a dedicated block, which is linked behind the
+    // current one so the rest of the current block is still used
+    const bool dedicated = size > blockSize_ / 4;
+    const size_t allocSize = kHeaderSize + (dedicated ? size : blockSize_);
+    Block* block = static_cast<Block*>(malloc(allocSize));
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    totalSize_ += allocSize;
+
+    char* data = reinterpret_cast<char*>(block) + kHeaderSize;
+    if (dedicated && blocks_ != nullptr)
+    {
+        block->next = blocks_->next;
+        blocks_->next = block;
+        return data;
+    }
+    block->next = blocks_;
+    blocks_ = block;
+    ptr_ = data + size;
+    end_ = data + (dedicated ? size : blockSize_);
+    return data;
+}
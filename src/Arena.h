@@ -0,0 +1,86 @@
+// Copyright (C) 2015 chenqiang@outlook.com. All rights reserved.
+// Distributed under the terms and conditions of the Apache License.
+// See accompanying files LICENSE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Portability.h"
+
+
+/**
+ * Monotonic (bump-pointer) allocator.
+ *
+ * Memory is carved sequentially out of large blocks obtained from the
+ * heap, and is only given back, all at once, by clear() or the
+ * destructor.  Nothing allocated from an arena ever has its destructor
+ * run, so it should only hold objects that don't own other resources.
+ *
+ * Not thread safe.
+ */
+class Arena
+{
+public:
+    enum { kDefaultBlockSize = 32 * 1024 };
+
+    explicit Arena(size_t blockSize = kDefaultBlockSize);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /*
+     * Allocate size bytes aligned for any fundamental type.  Requests
+     * larger than a quarter of the block size get a block of their own.
+     * Throws std::bad_alloc on failure.
+     */
+    void* allocate(size_t size)
+    {
+        size = (size + kAlign - 1) & ~(kAlign - 1);
+        if (static_cast<size_t>(end_ - ptr_) < size)
+        {
+            return allocateSlow(size);
+        }
+        void* result = ptr_;
+        ptr_ += size;
+        return result;
+    }
+
+    /*
+     * Allocate uninitialized storage for count objects of type T.
+     */
+    template <typename T>
+    T* allocateArray(size_t count)
+    {
+        static_assert(alignof(T) <= kAlign, "over-aligned type");
+        return static_cast<T*>(allocate(sizeof(T) * count));
+    }
+
+    /*
+     * Release every block.  Everything allocated so far becomes invalid.
+     */
+    void clear();
+
+    /*
+     * Bytes obtained from the heap, including block headers and unused
+     * tails of blocks.
+     */
+    size_t totalSize() const { return totalSize_; }
+
+private:
+    enum { kAlign = 16 };
+
+    struct Block
+    {
+        Block* next;
+    };
+
+    void* allocateSlow(size_t size);
+
+    Block*      blocks_;
+    char*       ptr_;
+    char*       end_;
+    size_t      blockSize_;
+    size_t      totalSize_;
+};
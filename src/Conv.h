@@ -25,8 +25,8 @@
 
 #include <stdint.h>
 #include <assert.h>
-#include <float.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <typeinfo>
 #include <stdexcept>
@@ -36,6 +36,7 @@
 #include "Preprocessor.h"
 #include "Logging.h"
 #include "Range.h"
+#include "Bits.h"
 
 
 #define FOLLY_RANGE_CHECK(condition, message, src)          \
@@ -204,13 +205,207 @@ inline uint32_t uint64ToBufferUnsafe(uint64_t v, char *const buffer)
 }
 
 
+namespace detail {
+
+// "00".."99" split in tens and units; see Conv.cpp
+extern const char digit1[101];
+extern const char digit2[101];
+
+// 10^0 .. 10^19
+extern const uint64_t powersOf10[20];
+
+/*
+ * Same as digits10(), without branches: log10 is estimated from log2
+ * and corrected by one comparison.
+ */
+inline uint32_t digitCount(uint64_t v)
+{
+    v |= 1;     // counts the same, and makes zero one digit long
+    const uint32_t t = (findLastSet(v) * 1233) >> 12;
+    return t + 1 - (v < powersOf10[t]);
+}
+
+/*
+ * Writes the digits of v so the last one is just before end, two at a
+ * time.  Assumes there are digitCount(v) bytes before end.
+ */
+inline void writeDigitsBackward(uint64_t v, char* end)
+{
+    // 32-bit division is much cheaper, so only the top digits of large
+    // values go through 64-bit arithmetic
+    while (v > 0xFFFFFFFF)
+    {
+        const uint32_t r = static_cast<uint32_t>(v % 100);
+        v /= 100;
+        *--end = digit2[r];
+        *--end = digit1[r];
+    }
+    uint32_t w = static_cast<uint32_t>(v);
+    while (w >= 100)
+    {
+        const uint32_t r = w % 100;
+        w /= 100;
+        *--end = digit2[r];
+        *--end = digit1[r];
+    }
+    if (w >= 10)
+    {
+        *--end = digit2[w];
+        *--end = digit1[w];
+    }
+    else
+    {
+        *--end = static_cast<char>('0' + w);
+    }
+}
+
+template <class Src>
+inline typename std::enable_if<std::is_signed<Src>::value, bool>::type
+isNegative(Src value)
+{
+    return value < 0;
+}
+
+template <class Src>
+inline typename std::enable_if<!std::is_signed<Src>::value, bool>::type
+isNegative(Src)
+{
+    return false;
+}
+
+} // namespace detail
+
+/*******************************************************************************
+ * Output sinks.  toAppend() writes to any type with a member
+ *
+ *   append(const char* data, size_t size)
+ *
+ * such as std::string, or a BufferAppender over memory the caller owns.
+ ******************************************************************************/
+
+/**
+ * A toAppend() sink over a caller-provided buffer, such as a char array on
+ * the stack or the free space of an I/O buffer, so hot paths can format
+ * without a heap string in between.
+ *
+ *   char buffer[64];
+ *   BufferAppender out(buffer);
+ *   toAppend(&out, "id=", id, " elapsed=", seconds);
+ *   if (!out.overflowed())
+ *   {
+ *       write(fd, out.data(), out.size());
+ *   }
+ *
+ * As with snprintf, output is cut off at the end of the buffer; it is then
+ * incomplete and overflowed() is set.  Nothing is NUL terminated.
+ */
+class BufferAppender
+{
+public:
+    explicit BufferAppender(MutableStringPiece buffer)
+        : begin_(buffer.begin()),
+          pos_(buffer.begin()),
+          end_(buffer.end()),
+          overflowed_(false)
+    {
+    }
+
+    template <size_t N>
+    explicit BufferAppender(char (&buffer)[N])
+        : BufferAppender(MutableStringPiece(buffer, N))
+    {
+    }
+
+    void append(const char* data, size_t size)
+    {
+        if (size > static_cast<size_t>(end_ - pos_))
+        {
+            size = end_ - pos_;
+            overflowed_ = true;
+        }
+        memcpy(pos_, data, size);
+        pos_ += size;
+    }
+
+    void push_back(char c)
+    {
+        if (pos_ == end_)
+        {
+            overflowed_ = true;
+            return;
+        }
+        *pos_++ = c;
+    }
+
+    /*
+     * Start over at the beginning of the buffer.
+     */
+    void clear()
+    {
+        pos_ = begin_;
+        overflowed_ = false;
+    }
+
+    const char* data() const { return begin_; }
+    size_t size() const { return pos_ - begin_; }
+    size_t capacity() const { return end_ - begin_; }
+    bool overflowed() const { return overflowed_; }
+
+    /*
+     * What has been written so far.
+     */
+    StringPiece str() const { return StringPiece(begin_, pos_); }
+
+private:
+    char*   begin_;
+    char*   pos_;
+    char*   end_;
+    bool    overflowed_;
+};
+
+namespace detail {
+
+template <class T>
+struct IsAppendable
+{
+    template <class U>
+    static auto test(U* u)
+        -> decltype(u->append(static_cast<const char*>(nullptr), size_t(0)),
+                    std::true_type());
+
+    template <class U>
+    static std::false_type test(...);
+
+    static const bool value = decltype(test<T>(nullptr))::value;
+};
+
+inline void appendChar(std::string* result, char c)
+{
+    result->push_back(c);
+}
+
+inline void appendChar(BufferAppender* result, char c)
+{
+    result->push_back(c);
+}
+
+template <class Tgt>
+void appendChar(Tgt* result, char c)
+{
+    result->append(&c, 1);
+}
+
+} // namespace detail
+
 /**
  * A single char gets appended.
  */
-inline void toAppend(std::string* result, char value)
+template <class Tgt>
+typename std::enable_if<detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* result, char value)
 {
     DCHECK_NOTNULL(result);
-    *result += value;
+    detail::appendChar(result, value);
 }
 
 template<class T>
@@ -225,10 +420,11 @@ constexpr typename std::enable_if <
 /**
  * Everything implicitly convertible to const char* gets appended.
  */
-template <class Src>
+template <class Tgt, class Src>
 typename std::enable_if<
-    std::is_convertible<Src, const char*>::value>::type
-toAppend(std::string* result, Src value)
+    std::is_convertible<Src, const char*>::value
+    && detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* result, Src value)
 {
     DCHECK_NOTNULL(result);
     // Treat null pointers like an empty string, as in:
@@ -236,16 +432,33 @@ toAppend(std::string* result, Src value)
     const char* c = value;
     if (c)
     {
-        result->append(value);
+        result->append(c, strlen(c));
     }
 }
 
-inline void toAppend(std::string* result, StringPiece value)
+template <class Src>
+typename std::enable_if<
+    std::is_convertible<Src, const char*>::value,
+    size_t>::type
+estimateSpaceNeeded(Src value)
+{
+    const char* c = value;
+    return c ? strlen(c) : 0;
+}
+
+template <class Tgt>
+typename std::enable_if<detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* result, StringPiece value)
 {
     DCHECK_NOTNULL(result);
     result->append(value.data(), value.size());
 }
 
+inline size_t estimateSpaceNeeded(StringPiece value)
+{
+    return value.size();
+}
+
 /**
  * int32_t and int64_t to string (by appending) go through here. The
  * result is APPENDED to a preexisting string passed as the second
@@ -254,19 +467,22 @@ inline void toAppend(std::string* result, StringPiece value)
  * than 22 bytes in its textual representation (20 for digits, one for
  * sign, one for the terminating 0).
  */
-template <class Src>
+template <class Tgt, class Src>
 typename std::enable_if<
     std::is_integral<Src>::value
     && std::is_signed<Src>::value
-    && sizeof(Src) >= 4>::type
-toAppend(std::string* result, Src value)
+    && sizeof(Src) >= 4
+    && detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* result, Src value)
 {
     DCHECK_NOTNULL(result);
-    char buffer[20];
+    char buffer[21];
     if (value < 0)
     {
-        result->push_back('-');
-        result->append(buffer, uint64ToBufferUnsafe(-int64_t(value), buffer));
+        buffer[0] = '-';
+        result->append(buffer,
+            1 + uint64ToBufferUnsafe(0 - static_cast<uint64_t>(value),
+                                     buffer + 1));
     }
     else
     {
@@ -274,30 +490,57 @@ toAppend(std::string* result, Src value)
     }
 }
 
+template <class Src>
+typename std::enable_if<
+    std::is_integral<Src>::value
+    && std::is_signed<Src>::value
+    && sizeof(Src) >= 4,
+    size_t>::type
+estimateSpaceNeeded(Src value)
+{
+    return value < 0
+        ? 1 + detail::digitCount(0 - static_cast<uint64_t>(value))
+        : detail::digitCount(static_cast<uint64_t>(value));
+}
+
 /**
  * As above, but for uint32_t and uint64_t.
  */
-template <class Src>
+template <class Tgt, class Src>
 typename std::enable_if<
     std::is_integral<Src>::value
     && !std::is_signed<Src>::value
-    && sizeof(Src) >= 4>::type
-toAppend(std::string* result, Src value)
+    && sizeof(Src) >= 4
+    && detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* result, Src value)
 {
     DCHECK_NOTNULL(result);
     char buffer[20];
-    result->append(buffer, buffer + uint64ToBufferUnsafe(value, buffer));
+    result->append(buffer, uint64ToBufferUnsafe(value, buffer));
+}
+
+template <class Src>
+typename std::enable_if<
+    std::is_integral<Src>::value
+    && !std::is_signed<Src>::value
+    && sizeof(Src) >= 4,
+    size_t>::type
+estimateSpaceNeeded(Src value)
+{
+    return detail::digitCount(value);
 }
 
 /**
  * All small signed and unsigned integers to string go through 32-bit
  * types int32_t and uint32_t, respectively.
  */
-template <class Src>
+template <class Tgt, class Src>
 typename std::enable_if<
     std::is_integral<Src>::value
-    && sizeof(Src) < 4>::type
-toAppend(std::string* result, Src value)
+    && sizeof(Src) < 4
+    && !std::is_same<Src, char>::value
+    && detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* result, Src value)
 {
     DCHECK_NOTNULL(result);
     typedef typename
@@ -306,58 +549,273 @@ toAppend(std::string* result, Src value)
     toAppend(result, static_cast<Intermediate>(value));
 }
 
+template <class Src>
+typename std::enable_if<
+    std::is_integral<Src>::value
+    && sizeof(Src) < 4
+    && !std::is_same<Src, char>::value,
+    size_t>::type
+estimateSpaceNeeded(Src value)
+{
+    typedef typename
+        std::conditional<std::is_signed<Src>::value,
+        int64_t, uint64_t>::type Intermediate;
+    return estimateSpaceNeeded(static_cast<Intermediate>(value));
+}
+
 /**
- * Enumerated values get appended as integers.
+ * Appends the integers in [begin, end) to *result, with separator between
+ * them, e.g. "3,-1,4" for a CSV row or column.  The length of the whole
+ * text is computed first, so the string grows once and each number is
+ * written in place, two digits at a time.
  */
 template <class Src>
 typename std::enable_if<
-    std::is_enum<Src>::value>::type
-toAppend(std::string* result, Src value)
+    std::is_integral<Src>::value
+    && !std::is_same<Src, bool>::value
+    && !std::is_same<Src, char>::value>::type
+toAppendDelimited(std::string* result, StringPiece separator,
+                  const Src* begin, const Src* end)
+{
+    DCHECK_NOTNULL(result);
+    if (begin == end)
+    {
+        return;
+    }
+
+    size_t size = separator.size() * (end - begin - 1);
+    for (const Src* p = begin; p != end; ++p)
+    {
+        const bool negative = detail::isNegative(*p);
+        const uint64_t magnitude = negative
+            ? 0 - static_cast<uint64_t>(*p) : static_cast<uint64_t>(*p);
+        size += negative + detail::digitCount(magnitude);
+    }
+
+    const size_t oldSize = result->size();
+    result->resize(oldSize + size);
+    char* out = &(*result)[oldSize];
+    for (const Src* p = begin; ; )
+    {
+        const bool negative = detail::isNegative(*p);
+        const uint64_t magnitude = negative
+            ? 0 - static_cast<uint64_t>(*p) : static_cast<uint64_t>(*p);
+        *out = '-';
+        out += negative + detail::digitCount(magnitude);
+        detail::writeDigitsBackward(magnitude, out);
+        if (++p == end)
+        {
+            break;
+        }
+        memcpy(out, separator.data(), separator.size());
+        out += separator.size();
+    }
+    DCHECK(out == &(*result)[0] + oldSize + size);
+}
+
+/**
+ * Enumerated values get appended as integers.
+ */
+template <class Tgt, class Src>
+typename std::enable_if<
+    std::is_enum<Src>::value
+    && detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* result, Src value)
 {
     toAppend(result,
         static_cast<typename std::underlying_type<Src>::type>(value));
 }
 
+template <class Src>
+typename std::enable_if<
+    std::is_enum<Src>::value,
+    size_t>::type
+estimateSpaceNeeded(Src value)
+{
+    return estimateSpaceNeeded(
+        static_cast<typename std::underlying_type<Src>::type>(value));
+}
+
 /*******************************************************************************
  * Conversions from floating-point types to string types.
  ******************************************************************************/
 
 /**
- * As above, but for floating point
+ * How toAppend() writes a floating point value.
+ */
+enum class DtoaMode
+{
+    SHORTEST,   // as few digits as read back to the same value
+    FIXED,      // numDigits digits after the point, never an exponent
+    EXPONENT,   // one digit, numDigits digits after the point, an exponent
+                // of at least two digits
+};
+
+namespace detail {
+
+// The longest output of floatingPointToBuffer()
+enum { kMaxFloatingPointSize = 25 };
+
+size_t floatingPointToBuffer(double value, bool single, char* buffer);
+
+void appendFloatingPoint(std::string* result, double value, bool single,
+                         DtoaMode mode, unsigned numDigits);
+
+} // namespace detail
+
+/**
+ * As above, but for floating point.  Writes the shortest digits that read
+ * back to the same value (as a float for floats), in plain notation with
+ * at least one digit after the point when the decimal exponent is in
+ * [-6, 21), and as e.g. "1.5e+300" otherwise.  NaN and infinities are
+ * written "nan", "inf" and "-inf".  No locale is involved.
+ */
+template <class Tgt, class Src>
+typename std::enable_if<
+    std::is_floating_point<Src>::value
+    && detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* result, Src value)
+{
+    DCHECK_NOTNULL(result);
+    char buffer[detail::kMaxFloatingPointSize];
+    result->append(buffer, detail::floatingPointToBuffer(
+        static_cast<double>(value), std::is_same<Src, float>::value, buffer));
+}
+
+/**
+ * An upper bound: a sign, 17 digits, a point and "e-324", or up to 21
+ * digits before the point, or "0.00000" before 17 digits.
+ */
+template <class Src>
+typename std::enable_if<
+    std::is_floating_point<Src>::value,
+    size_t>::type
+estimateSpaceNeeded(Src)
+{
+    return detail::kMaxFloatingPointSize;
+}
+
+/**
+ * As above, in the given mode.  FIXED and EXPONENT round the shortest
+ * digits to numDigits after the point, as printf's "%.*f" and "%.*e" do,
+ * but write zeros past them: 0.1 in FIXED mode with 20 digits is
+ * "0.10000000000000000000".  Like printf, EXPONENT writes at least two
+ * exponent digits, as in "1.00e+03".
  */
 template <class Src>
 typename std::enable_if<
     std::is_floating_point<Src>::value>::type
-toAppend(std::string* result, Src value)
+toAppend(Src value, std::string* result, DtoaMode mode, unsigned numDigits)
 {
-    char buffer[32];
-    int count = snprintf(buffer, 32, "%.*f", FLT_DIG, value);
-    DCHECK(count > 0);
-    for (int i = count - 1; i > 1; i--)
-    {
-        if (buffer[i] == '0' && buffer[i - 1] != '.')
-            count--;
-        else
-            break;
-    }
-    toAppend(result, StringPiece(buffer, count));
+    DCHECK_NOTNULL(result);
+    detail::appendFloatingPoint(result, static_cast<double>(value),
+        std::is_same<Src, float>::value, mode, numDigits);
 }
 
 /**
  * Variadic base case: do nothing.
  */
-inline void toAppend(std::string* ) {}
+template <class Tgt>
+typename std::enable_if<detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* ) {}
 
+namespace detail {
+
+// Types without an estimateSpaceNeeded() overload count as zero
+struct EstimateFallback {};
+struct EstimatePreferred : EstimateFallback {};
+
+template <class T>
+auto estimateSpace(const T& v, EstimatePreferred)
+    -> decltype(estimateSpaceNeeded(v))
+{
+    return estimateSpaceNeeded(v);
+}
+
+template <class T>
+size_t estimateSpace(const T&, EstimateFallback)
+{
+    return 0;
+}
+
+inline size_t estimateSpaceNeededAll()
+{
+    return 0;
+}
 
-/**
- * Variadic conversion to string. Appends each element in turn.
- */
 template <class T, class... Ts>
-typename std::enable_if<sizeof...(Ts) >= 1>::type
-toAppend(std::string* result, const T& v, const Ts&... vs)
+size_t estimateSpaceNeededAll(const T& v, const Ts&... vs)
+{
+    return estimateSpace(v, EstimatePreferred()) + estimateSpaceNeededAll(vs...);
+}
+
+template <class Tgt>
+void toAppendStrImpl(Tgt* ) {}
+
+template <class Tgt, class T, class... Ts>
+void toAppendStrImpl(Tgt* result, const T& v, const Ts&... vs)
 {
     toAppend(result, v);
-    toAppend(result, vs...);
+    toAppendStrImpl(result, vs...);
+}
+
+// Strings grow once to fit all the pieces; other sinks manage their own
+// space
+template <class... Ts>
+void reserveForAll(std::string* result, const Ts&... vs)
+{
+    const size_t needed = result->size() + estimateSpaceNeededAll(vs...);
+    if (needed > result->capacity())
+    {
+        result->reserve(needed);
+    }
+}
+
+template <class Tgt, class... Ts>
+void reserveForAll(Tgt* , const Ts&... ) {}
+
+} // namespace detail
+
+/**
+ * Variadic conversion to string. Appends each element in turn, after
+ * growing a std::string once to fit them all.
+ */
+template <class Tgt, class T, class... Ts>
+typename std::enable_if<
+    (sizeof...(Ts) >= 1) && detail::IsAppendable<Tgt>::value>::type
+toAppend(Tgt* result, const T& v, const Ts&... vs)
+{
+    DCHECK_NOTNULL(result);
+    detail::reserveForAll(result, v, vs...);
+    detail::toAppendStrImpl(result, v, vs...);
+}
+
+/**
+ * Formats vs at the start of *buffer and advances *buffer past them, so
+ * successive calls fill it up.  Returns false if they don't fit, leaving
+ * *buffer where it was; the bytes it covers may have been overwritten.
+ *
+ *   MutableStringPiece space(buf, sizeof(buf));
+ *   while (...)
+ *   {
+ *       if (!toAppend(&space, key, '=', value, '\n'))
+ *       {
+ *           // flush and retry
+ *       }
+ *   }
+ */
+template <class... Ts>
+bool toAppend(MutableStringPiece* buffer, const Ts&... vs)
+{
+    DCHECK_NOTNULL(buffer);
+    BufferAppender out(*buffer);
+    detail::toAppendStrImpl(&out, vs...);
+    if (out.overflowed())
+    {
+        return false;
+    }
+    buffer->advance(out.size());
+    return true;
 }
 
 template <class Tgt, class... Ts>
@@ -367,7 +825,8 @@ typename std::enable_if<
 to(const Ts&... vs)
 {
     Tgt result;
-    toAppend(&result, vs...);
+    result.reserve(detail::estimateSpaceNeededAll(vs...));
+    detail::toAppendStrImpl(&result, vs...);
     return std::move(result);
 }
 
@@ -378,6 +837,39 @@ to(const Ts&... vs)
 
 namespace detail {
 
+/*
+ * SWAR (SIMD within a register) helpers for eight characters at a time,
+ * loaded so the first character is in the low byte.
+ */
+inline uint64_t loadEightChars(const char* p)
+{
+    return Endian::little(loadUnaligned<uint64_t>(p));
+}
+
+/*
+ * The high bit of the byte of the first character that isn't a digit is
+ * set, and no bit below it is.  Zero if all are digits.
+ */
+inline uint64_t nonDigitMask(uint64_t chars)
+{
+    return ((chars + 0x4646464646464646ULL) | (chars - 0x3030303030303030ULL))
+        & 0x8080808080808080ULL;
+}
+
+/*
+ * The value of eight digits: each pair of digits is combined in one
+ * multiply, then pairs of pairs, then the two halves.
+ */
+inline uint32_t parseEightDigits(uint64_t chars)
+{
+    chars -= 0x3030303030303030ULL;
+    chars = chars * 10 + (chars >> 8);
+    return static_cast<uint32_t>(
+        ((chars & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))
+        + ((chars >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))
+        >> 32);
+}
+
 /**
  * Finds the first non-digit in a string. The number of digits
  * searched depends on the precision of the Tgt integral. Assumes the
@@ -388,13 +880,20 @@ namespace detail {
  *     if (b >= e || !isdigit(*b)) return b;
  *   }
  *
- *  Complete unrolling marks bottom-line (i.e. entire conversion)
- *  improvements of 20%.
+ * Long runs of digits are checked eight at a time.
  */
 template <class Tgt>
 const char* findFirstNonDigit(const char* b, const char* e)
 {
     DCHECK(b && e);
+    for (; e - b >= 8; b += 8)
+    {
+        const uint64_t nonDigits = nonDigitMask(loadEightChars(b));
+        if (nonDigits != 0)
+        {
+            return b + (findFirstSet(nonDigits) - 1) / 8;
+        }
+    }
     for (; b < e; ++b)
     {
         auto const c = static_cast<unsigned>(*b) - '0';
@@ -580,8 +1079,15 @@ Tgt digits_to(const char * b, const char * e)
     }
 
     // Here we know that the number won't overflow when
-    // converted. Proceed without checks.
+    // converted. Proceed without checks, eight digits at a time while
+    // there are that many, then four.
     Tgt result = 0;
+    for (; e - b >= 8; b += 8)
+    {
+        const uint64_t chars = loadEightChars(b);
+        assert(nonDigitMask(chars) == 0 && "Assumption: string only has digits");
+        result = static_cast<Tgt>(result * 100000000ULL + parseEightDigits(chars));
+    }
     for (; e - b >= 4; b += 4)
     {
         result = static_cast<Tgt>(result * 10000);
@@ -799,9 +1305,22 @@ to(StringPiece src)
  * Conversions from string types to floating-point types.
  ******************************************************************************/
 
+namespace detail {
+
+/*
+ * Parses the decimal number at the start of [b, e) as strtod() does in
+ * the C locale: an optional sign, digits with an optional '.', and an
+ * optional exponent.  The result is correctly rounded, and overflows to
+ * infinity.  Returns the end of the number, or b if there is none.
+ */
+const char* str_to_double(const char* b, const char* e, double* result);
+
+} // namespace detail
+
 /**
  * StringPiece to double, with progress information. Alters the
  * StringPiece parameter to munch the already-parsed characters.
+ * Leading whitespace is skipped; the decimal point is always '.'.
  */
 template <class Tgt>
 inline typename std::enable_if<
@@ -812,15 +1331,6 @@ to(StringPiece *const src)
     FOLLY_RANGE_CHECK_STRINGPIECE(!src->empty(),
         "No digits found in input string", *src);
 
-    char* end;
-    double result = strtod(src->data(), &end);
-    int length = static_cast<int>(end - src->data());
-    if (length > 0 && !std::isnan(result))
-    {
-        src->advance(length);
-        return result;
-    }
-
     for (;; src->advance(1))
     {
         if (src->empty())
@@ -833,6 +1343,14 @@ to(StringPiece *const src)
         }
     }
 
+    double result;
+    const char* end = detail::str_to_double(src->begin(), src->end(), &result);
+    if (end != src->begin())
+    {
+        src->assign(end, src->end());
+        return static_cast<Tgt>(result);
+    }
+
     // Was that "inf[inity]"?
     if (src->size() >= 3 && toupper((*src)[0]) == 'I'
         && toupper((*src)[1]) == 'N' && toupper((*src)[2]) == 'F')
@@ -44,6 +44,9 @@ public:
             f7b_ = reg[1];
             f7c_ = reg[2];
         }
+        if (osxsave()) {
+            xcr0_ = static_cast<uint32_t>(_xgetbv(0));
+        }
 #elif FOLLY_X64 || defined(__i386__)
         uint32_t n;
         __asm__("cpuid" : "=a"(n) : "a"(0) : "ebx", "edx", "ecx");
@@ -53,6 +56,9 @@ public:
         if (n >= 7) {
             __asm__("cpuid" : "=b"(f7b_), "=c"(f7c_) : "a"(7), "c"(0) : "edx");
         }
+        if (osxsave()) {
+            __asm__("xgetbv" : "=a"(xcr0_) : "c"(0) : "edx");
+        }
 #endif
     }
 
@@ -156,9 +162,17 @@ public:
 
 #undef X
 
+    // Whether the OS saves the wider registers on a context switch, as
+    // XCR0 says: XMM and YMM for AVX and AVX2, and the opmask and ZMM
+    // registers too for AVX-512.  The instructions fault without it, even
+    // on CPUs that have them, so check this as well as the feature flag.
+    bool osSupportsAvx() const { return (xcr0_ & 0x06) == 0x06; }
+    bool osSupportsAvx512() const { return (xcr0_ & 0xE6) == 0xE6; }
+
  private:
      uint32_t f1c_ = 0;
      uint32_t f1d_ = 0;
      uint32_t f7b_ = 0;
      uint32_t f7c_ = 0;
+     uint32_t xcr0_ = 0;    // XCR0, if osxsave()
 };
@@ -0,0 +1,204 @@
+// Copyright (C) 2015 chenqiang@outlook.com. All rights reserved.
+// Distributed under the terms and conditions of the Apache License.
+// See accompanying files LICENSE.
+
+#include "Format.h"
+#include <stdexcept>
+
+
+namespace {
+
+// Field widths and precisions beyond this are surely mistakes
+const int kMaxWidth = 1 << 20;
+
+FOLLY_NORETURN void throwFormatError(StringPiece format, const char* what)
+{
+    throw std::invalid_argument(to<std::string>(
+        "Invalid format string \"", format, "\": ", what));
+}
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+bool isAlign(char c)
+{
+    return c == '<' || c == '>' || c == '^' || c == '=';
+}
+
+// Digits at *p, which must be there
+int parseNumber(StringPiece format, const char** p, const char* e)
+{
+    if (*p == e || !isDigit(**p))
+    {
+        throwFormatError(format, "expected a number");
+    }
+    int value = 0;
+    for (; *p != e && isDigit(**p); ++*p)
+    {
+        value = value * 10 + (**p - '0');
+        if (value > kMaxWidth)
+        {
+            throwFormatError(format, "number too large");
+        }
+    }
+    return value;
+}
+
+// [[fill]align][0][width][.precision][type], all of [p, e)
+FormatSpec parseSpec(StringPiece format, const char* p, const char* e)
+{
+    FormatSpec spec = { ' ', 0, 0, 0, 6 };
+    bool fill = false;
+    if (e - p >= 2 && isAlign(p[1]))
+    {
+        spec.fill = p[0];
+        spec.align = p[1];
+        fill = true;
+        p += 2;
+    }
+    else if (p != e && isAlign(*p))
+    {
+        spec.align = *p++;
+    }
+    if (p != e && *p == '0')
+    {
+        if (!fill)
+        {
+            spec.fill = '0';
+        }
+        if (spec.align == 0)
+        {
+            spec.align = '=';
+        }
+        ++p;
+    }
+    if (p != e && isDigit(*p))
+    {
+        spec.width = parseNumber(format, &p, e);
+    }
+    bool precision = false;
+    if (p != e && *p == '.')
+    {
+        ++p;
+        spec.precision = parseNumber(format, &p, e);
+        precision = true;
+    }
+    if (p != e)
+    {
+        spec.type = *p++;
+        if (strchr("dsxXfe", spec.type) == nullptr)
+        {
+            throwFormatError(format, "unknown type");
+        }
+    }
+    if (p != e)
+    {
+        throwFormatError(format, "unexpected characters in a field");
+    }
+    if (precision && spec.type != 'f' && spec.type != 'e')
+    {
+        throwFormatError(format, "precision without 'f' or 'e'");
+    }
+    return spec;
+}
+
+} // anonymous namespace
+
+
+FormatString::FormatString(StringPiece format)
+    : argumentCount_(0)
+{
+    enum { kUnknown, kAutomatic, kManual } numbering = kUnknown;
+    Segment segment = { 0, 0, -1, FormatSpec() };
+    const char* p = format.begin();
+    const char* e = format.end();
+    while (p != e)
+    {
+        const char* brace = p;
+        while (brace != e && *brace != '{' && *brace != '}')
+        {
+            ++brace;
+        }
+        literals_.append(p, brace);
+        segment.literalSize += brace - p;
+        p = brace;
+        if (p == e)
+        {
+            break;
+        }
+
+        // "{{" and "}}" are part of the literal
+        if (p + 1 != e && p[1] == *p)
+        {
+            literals_.push_back(*p);
+            ++segment.literalSize;
+            p += 2;
+            continue;
+        }
+        if (*p == '}')
+        {
+            throwFormatError(format, "unmatched '}'");
+        }
+
+        const char* close = static_cast<const char*>(
+            memchr(p, '}', e - p));
+        if (close == nullptr)
+        {
+            throwFormatError(format, "unmatched '{'");
+        }
+        ++p;
+        if (p != close && isDigit(*p))
+        {
+            if (numbering == kAutomatic)
+            {
+                throwFormatError(format, "mixed \"{}\" and \"{n}\"");
+            }
+            numbering = kManual;
+            segment.arg = parseNumber(format, &p, close);
+        }
+        else
+        {
+            if (numbering == kManual)
+            {
+                throwFormatError(format, "mixed \"{}\" and \"{n}\"");
+            }
+            numbering = kAutomatic;
+            segment.arg = static_cast<int>(argumentCount_);
+        }
+        if (p != close && *p != ':')
+        {
+            throwFormatError(format, "bad argument index");
+        }
+        segment.spec = parseSpec(format, p == close ? p : p + 1, close);
+        argumentCount_ = std::max(argumentCount_,
+                                  static_cast<size_t>(segment.arg) + 1);
+        segments_.push_back(segment);
+        segment.literalBegin = literals_.size();
+        segment.literalSize = 0;
+        segment.arg = -1;
+        p = close + 1;
+    }
+    if (segment.literalSize != 0 || segments_.empty())
+    {
+        segments_.push_back(segment);
+    }
+}
+
+void FormatString::throwArgumentCount(size_t given) const
+{
+    throw std::invalid_argument(to<std::string>(
+        "Format expects ", argumentCount_, " arguments, got ", given));
+}
+
+namespace detail {
+
+void throwFormatTypeError(const FormatSpec& spec, const char* what)
+{
+    throw std::invalid_argument(to<std::string>(
+        "Format type '", spec.type, "' doesn't apply to a ", what,
+        " argument"));
+}
+
+} // namespace detail
@@ -0,0 +1,357 @@
+// Copyright (C) 2015 chenqiang@outlook.com. All rights reserved.
+// Distributed under the terms and conditions of the Apache License.
+// See accompanying files LICENSE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "Conv.h"
+#include "Range.h"
+
+
+/**
+ * How one replacement field is written; see FormatString.
+ */
+struct FormatSpec
+{
+    char    fill;       // padding character
+    char    align;      // '<', '>', '^', '=' (after the sign), or 0 for
+                        // right for numbers and left for everything else
+    char    type;       // 0, 'd', 's', 'x', 'X', 'f' or 'e'
+    int     width;      // minimum, 0 for none
+    int     precision;  // digits after the point for 'f' and 'e'
+};
+
+/**
+ * A type-safe replacement for stringPrintf().  The format is parsed once,
+ * when the FormatString is built, and every argument is written by the
+ * toAppend() of its own type, so nothing is guessed from the format at
+ * run time and vsnprintf is never called.  Keep the object around, e.g.
+ * as a static, to format many times:
+ *
+ *   static const FormatString kLine("{}:{} took {:.3f}ms");
+ *   std::string s = kLine.format(file, line, elapsed);
+ *   kLine.appendTo(&out, file, line, elapsed);     // any toAppend() sink
+ *
+ * "{}" is the next argument and "{n}" the nth; the two can't be mixed.
+ * "{{" and "}}" are literal braces.  A field may end with ":spec":
+ *
+ *   [[fill]align][0][width][.precision][type]
+ *
+ * align is '<', '>', '^' or '=', which pads numbers between the sign and
+ * the digits; a '0' before the width makes the fill '0' and the default
+ * alignment '='.
+ * type is 'd' for decimal integers, 'x' and 'X' for hexadecimal integers,
+ * 'f' and 'e' for fixed and exponent notation of numbers, with precision
+ * digits after the point (6 by default), and 's' for anything else.  By
+ * default each type is written as toAppend() writes it.
+ *
+ * The constructor throws std::invalid_argument on a malformed format, and
+ * formatting throws it when the arguments don't match the format: a wrong
+ * count, or a type that doesn't apply to one.
+ */
+class FormatString
+{
+public:
+    explicit FormatString(StringPiece format);
+
+    /*
+     * Append the formatted arguments to *out.
+     */
+    template <class Tgt, class... Args>
+    void appendTo(Tgt* out, const Args&... args) const;
+
+    template <class... Args>
+    std::string format(const Args&... args) const
+    {
+        std::string result;
+        appendTo(&result, args...);
+        return result;
+    }
+
+    /*
+     * Number of arguments the format takes.
+     */
+    size_t argumentCount() const { return argumentCount_; }
+
+private:
+    // Literal text, then a field unless arg is -1
+    struct Segment
+    {
+        size_t      literalBegin;   // in literals_
+        size_t      literalSize;
+        int         arg;
+        FormatSpec  spec;
+    };
+
+    FOLLY_NORETURN void throwArgumentCount(size_t given) const;
+
+    std::string             literals_;
+    std::vector<Segment>    segments_;
+    size_t                  argumentCount_;
+};
+
+
+namespace detail {
+
+FOLLY_NORETURN void throwFormatTypeError(const FormatSpec& spec,
+                                         const char* what);
+
+template <class Tgt>
+void appendFill(Tgt* out, char fill, size_t count)
+{
+    char buffer[32];
+    memset(buffer, fill, sizeof(buffer));
+    for (; count > sizeof(buffer); count -= sizeof(buffer))
+    {
+        out->append(buffer, sizeof(buffer));
+    }
+    out->append(buffer, count);
+}
+
+/*
+ * text padded out to spec.width.
+ */
+template <class Tgt>
+void appendPadded(Tgt* out, StringPiece text, const FormatSpec& spec,
+                  bool numeric)
+{
+    size_t width = spec.width;
+    if (text.size() >= width)
+    {
+        out->append(text.data(), text.size());
+        return;
+    }
+    size_t padding = width - text.size();
+    char align = spec.align ? spec.align : numeric ? '>' : '<';
+    if (align == '=')
+    {
+        if (numeric && !text.empty() && text[0] == '-')
+        {
+            out->append(text.data(), 1);
+            text.advance(1);
+        }
+        align = '>';
+    }
+    size_t before = align == '>' ? padding : align == '^' ? padding / 2 : 0;
+    appendFill(out, spec.fill, before);
+    out->append(text.data(), text.size());
+    appendFill(out, spec.fill, padding - before);
+}
+
+/*
+ * The digits of magnitude in base 16, written backwards from end.
+ * Returns where they start.
+ */
+inline char* writeHexBackward(uint64_t magnitude, char* end, bool upper)
+{
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    do
+    {
+        *--end = digits[magnitude & 0xF];
+        magnitude >>= 4;
+    }
+    while (magnitude != 0);
+    return end;
+}
+
+inline void appendFormattedFloat(std::string* out, double value, bool single,
+                                 const FormatSpec& spec, DtoaMode mode)
+{
+    if (spec.width == 0)
+    {
+        appendFloatingPoint(out, value, single, mode, spec.precision);
+        return;
+    }
+    std::string text;
+    appendFloatingPoint(&text, value, single, mode, spec.precision);
+    appendPadded(out, text, spec, true);
+}
+
+template <class Tgt>
+void appendFormattedFloat(Tgt* out, double value, bool single,
+                          const FormatSpec& spec, DtoaMode mode)
+{
+    std::string text;
+    appendFloatingPoint(&text, value, single, mode, spec.precision);
+    appendPadded(out, text, spec, true);
+}
+
+template <class Tgt, class T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+formatValue(Tgt* out, T value, const FormatSpec& spec)
+{
+    const bool single = std::is_same<T, float>::value;
+    switch (spec.type)
+    {
+    case 0:
+        if (spec.width == 0)
+        {
+            toAppend(out, value);
+        }
+        else
+        {
+            char buffer[kMaxFloatingPointSize];
+            appendPadded(out, StringPiece(buffer,
+                floatingPointToBuffer(value, single, buffer)), spec, true);
+        }
+        break;
+    case 'f':
+        appendFormattedFloat(out, value, single, spec, DtoaMode::FIXED);
+        break;
+    case 'e':
+        appendFormattedFloat(out, value, single, spec, DtoaMode::EXPONENT);
+        break;
+    default:
+        throwFormatTypeError(spec, "floating point");
+    }
+}
+
+template <class Tgt, class T>
+typename std::enable_if<
+    std::is_integral<T>::value
+    && !std::is_same<T, bool>::value
+    && !std::is_same<T, char>::value>::type
+formatValue(Tgt* out, T value, const FormatSpec& spec)
+{
+    if (spec.type == 0 || spec.type == 'd')
+    {
+        if (spec.width == 0)
+        {
+            toAppend(out, value);
+            return;
+        }
+    }
+    else if (spec.type == 'f' || spec.type == 'e')
+    {
+        formatValue(out, static_cast<double>(value), spec);
+        return;
+    }
+    else if (spec.type != 'x' && spec.type != 'X')
+    {
+        throwFormatTypeError(spec, "integer");
+    }
+
+    const bool negative = isNegative(value);
+    const uint64_t magnitude = negative
+        ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    char buffer[21];
+    char* end = buffer + sizeof(buffer);
+    char* begin;
+    if (spec.type == 'x' || spec.type == 'X')
+    {
+        begin = writeHexBackward(magnitude, end, spec.type == 'X');
+    }
+    else
+    {
+        begin = end - digitCount(magnitude);
+        writeDigitsBackward(magnitude, end);
+    }
+    if (negative)
+    {
+        *--begin = '-';
+    }
+    if (spec.width == 0)
+    {
+        out->append(begin, end - begin);
+    }
+    else
+    {
+        appendPadded(out, StringPiece(begin, end), spec, true);
+    }
+}
+
+// Everything else, as toAppend() writes it
+template <class Tgt, class T>
+typename std::enable_if<
+    !std::is_arithmetic<T>::value
+    || std::is_same<T, bool>::value
+    || std::is_same<T, char>::value>::type
+formatValue(Tgt* out, const T& value, const FormatSpec& spec)
+{
+    if (spec.type != 0 && spec.type != 's')
+    {
+        throwFormatTypeError(spec, "non-numeric");
+    }
+    if (spec.width == 0)
+    {
+        toAppend(out, value);
+        return;
+    }
+    std::string text;
+    toAppend(&text, value);
+    appendPadded(out, text, spec, false);
+}
+
+// An argument, with the type that writes it
+template <class Tgt>
+struct FormatArg
+{
+    const void* value;
+    void (*append)(Tgt* out, const void* value, const FormatSpec& spec);
+};
+
+template <class Tgt, class T>
+void appendFormatArg(Tgt* out, const void* value, const FormatSpec& spec)
+{
+    formatValue(out, *static_cast<const T*>(value), spec);
+}
+
+template <class Tgt, class T>
+FormatArg<Tgt> makeFormatArg(const T& value)
+{
+    FormatArg<Tgt> arg = { &value, &appendFormatArg<Tgt, T> };
+    return arg;
+}
+
+// Strings grow once to fit the literals and the arguments
+template <class... Args>
+void reserveFormatted(std::string* out, size_t literalSize,
+                      const Args&... args)
+{
+    const size_t needed = out->size() + literalSize
+        + estimateSpaceNeededAll(args...);
+    if (needed > out->capacity())
+    {
+        out->reserve(needed);
+    }
+}
+
+template <class Tgt, class... Args>
+void reserveFormatted(Tgt* , size_t , const Args&... ) {}
+
+} // namespace detail
+
+
+template <class Tgt, class... Args>
+void FormatString::appendTo(Tgt* out, const Args&... args) const
+{
+    static_assert(detail::IsAppendable<Tgt>::value,
+                  "appendTo() needs a toAppend() sink");
+    DCHECK_NOTNULL(out);
+    if (sizeof...(Args) != argumentCount_)
+    {
+        throwArgumentCount(sizeof...(Args));
+    }
+    detail::reserveFormatted(out, literals_.size(), args...);
+
+    // One more than needed, so there is no empty array
+    const detail::FormatArg<Tgt> table[] = {
+        detail::makeFormatArg<Tgt>(args)..., { nullptr, nullptr },
+    };
+    const char* literals = literals_.data();
+    for (const Segment& segment : segments_)
+    {
+        out->append(literals + segment.literalBegin, segment.literalSize);
+        if (segment.arg >= 0)
+        {
+            const detail::FormatArg<Tgt>& arg = table[segment.arg];
+            arg.append(out, arg.value, segment.spec);
+        }
+    }
+}
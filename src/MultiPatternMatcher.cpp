@@ -0,0 +1,500 @@
+// Copyright (C) 2015 chenqiang@outlook.com. All rights reserved.
+// Distributed under the terms and conditions of the Apache License.
+// See accompanying files LICENSE.
+
+#include "MultiPatternMatcher.h"
+#include <string.h>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "Bits.h"
+#if FOLLY_HAVE_EMMINTRIN_H
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+// Teddy has 8 buckets to tell the patterns apart; past this many they get
+// crowded and Aho-Corasick wins
+const size_t kMaxTeddyPatterns = 32;
+
+// In the Aho-Corasick transitions, set on states where a pattern ends
+const uint32_t kReports = 0x80000000;
+
+// Whether Teddy has compared so many bytes of its candidates, for the
+// scanned bytes of the haystack, that the haystack must look like the
+// patterns over and over; as in qfind, the rest is better searched in
+// linear time
+inline bool comparedTooMuch(size_t compared, size_t scanned)
+{
+    return compared > 8 * scanned + 4096;
+}
+
+// By offset, then by pattern
+bool comesBefore(const MultiPatternMatcher::Match& a,
+                 const MultiPatternMatcher::Match& b)
+{
+    return a.offset != b.offset ? a.offset < b.offset : a.pattern < b.pattern;
+}
+
+typedef size_t (*TeddyFindFn)(const uint8_t* masks, const char* p,
+                              size_t size, size_t i, uint32_t* found);
+
+#if FOLLY_HAVE_EMMINTRIN_H
+
+// From position i on, the first block of positions where the first K bytes
+// of the haystack could begin a pattern: for each, the masks of the low and
+// the high nibble of each byte are shuffled to the buckets holding it at
+// that place in a pattern, and the buckets left in all of them are the
+// candidates.  Returns where the block starts, with the candidates set in
+// *found, or where it stopped with *found 0 once there are no whole blocks
+// left.
+template <size_t K>
+size_t teddyFind_ssse3(const uint8_t* masks, const char* p, size_t size,
+                       size_t i, uint32_t* found)
+    __attribute__((__target__("ssse3"), noinline));
+
+template <size_t K>
+size_t teddyFind_ssse3(const uint8_t* masks, const char* p, size_t size,
+                       size_t i, uint32_t* found)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i low[K], high[K];
+    for (size_t j = 0; j < K; ++j)
+    {
+        low[j] = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(masks + 32 * j));
+        high[j] = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(masks + 32 * j + 16));
+    }
+    for (; i + 16 + K - 1 <= size; i += 16)
+    {
+        __m128i buckets = _mm_set1_epi8(-1);
+        for (size_t j = 0; j < K; ++j)
+        {
+            const __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(p + i + j));
+            buckets = _mm_and_si128(buckets, _mm_and_si128(
+                _mm_shuffle_epi8(low[j], _mm_and_si128(v, nibble)),
+                _mm_shuffle_epi8(high[j],
+                                 _mm_and_si128(_mm_srli_epi16(v, 4), nibble))));
+        }
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_cmpeq_epi8(buckets, _mm_setzero_si128()))) ^ 0xFFFF;
+        if (mask != 0)
+        {
+            *found = mask;
+            return i;
+        }
+    }
+    *found = 0;
+    return i;
+}
+
+template <size_t K>
+size_t teddyFind_avx2(const uint8_t* masks, const char* p, size_t size,
+                      size_t i, uint32_t* found)
+    __attribute__((__target__("avx2"), noinline));
+
+// As teddyFind_ssse3(), 32 positions at a time
+template <size_t K>
+size_t teddyFind_avx2(const uint8_t* masks, const char* p, size_t size,
+                      size_t i, uint32_t* found)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i low[K], high[K];
+    for (size_t j = 0; j < K; ++j)
+    {
+        low[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(masks + 32 * j)));
+        high[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(masks + 32 * j + 16)));
+    }
+    for (; i + 32 + K - 1 <= size; i += 32)
+    {
+        __m256i buckets = _mm256_set1_epi8(-1);
+        for (size_t j = 0; j < K; ++j)
+        {
+            const __m256i v = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(p + i + j));
+            buckets = _mm256_and_si256(buckets, _mm256_and_si256(
+                _mm256_shuffle_epi8(low[j], _mm256_and_si256(v, nibble)),
+                _mm256_shuffle_epi8(high[j], _mm256_and_si256(
+                    _mm256_srli_epi16(v, 4), nibble))));
+        }
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(buckets, _mm256_setzero_si256())));
+        if (mask != 0)
+        {
+            *found = mask;
+            return i;
+        }
+    }
+    *found = 0;
+    return i;
+}
+
+#endif // FOLLY_HAVE_EMMINTRIN_H
+
+} // anonymous namespace
+
+
+MultiPatternMatcher::MultiPatternMatcher(
+    const std::vector<StringPiece>& patterns)
+    : minLength_(std::numeric_limits<size_t>::max()),
+      maxLength_(0),
+      teddyFind_(nullptr),
+      teddyWidth_(0),
+      fingerprintLength_(0),
+      classShift_(0)
+{
+    patternBegin_.push_back(0);
+    for (auto& pattern : patterns)
+    {
+        if (pattern.empty())
+        {
+            throw std::invalid_argument(
+                "MultiPatternMatcher: patterns can't be empty");
+        }
+        storage_.append(pattern.data(), pattern.size());
+        patternBegin_.push_back(storage_.size());
+        minLength_ = std::min(minLength_, pattern.size());
+        maxLength_ = std::max(maxLength_, pattern.size());
+    }
+    // Teddy falls back on the automaton too, so every set gets one
+    buildAhoCorasick();
+#if FOLLY_HAVE_EMMINTRIN_H
+    if (size() != 0 && size() <= kMaxTeddyPatterns && CpuId().ssse3())
+    {
+        buildTeddy();
+    }
+#endif
+}
+
+MultiPatternMatcher::MultiPatternMatcher(
+    std::initializer_list<StringPiece> patterns)
+    : MultiPatternMatcher(std::vector<StringPiece>(patterns))
+{
+}
+
+void MultiPatternMatcher::buildTeddy()
+{
+#if FOLLY_HAVE_EMMINTRIN_H
+    fingerprintLength_ = std::min<size_t>(3, minLength_);
+
+    // Patterns with the same first bytes share a bucket, so that they
+    // don't make candidates of each other's
+    std::vector<uint32_t> order(size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [this](uint32_t a, uint32_t b)
+    {
+        return pattern(a) < pattern(b);
+    });
+    const size_t perBucket = (size() + 7) / 8;
+    memset(teddyMasks_, 0, sizeof(teddyMasks_));
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const size_t bucket = i / perBucket;
+        const StringPiece p = pattern(order[i]);
+        buckets_[bucket].push_back(order[i]);
+        for (size_t j = 0; j < fingerprintLength_; ++j)
+        {
+            const uint8_t c = p[j];
+            teddyMasks_[j][0][c & 0xF] |= 1 << bucket;
+            teddyMasks_[j][1][c >> 4] |= 1 << bucket;
+        }
+    }
+    for (auto& bucket : buckets_)
+    {
+        std::sort(bucket.begin(), bucket.end());
+    }
+
+    static const TeddyFindFn kAvx2[] = {
+        teddyFind_avx2<1>, teddyFind_avx2<2>, teddyFind_avx2<3>,
+    };
+    static const TeddyFindFn kSsse3[] = {
+        teddyFind_ssse3<1>, teddyFind_ssse3<2>, teddyFind_ssse3<3>,
+    };
+    static const bool avx2 = CpuId().avx2() && CpuId().osSupportsAvx();
+    teddyFind_ = (avx2 ? kAvx2 : kSsse3)[fingerprintLength_ - 1];
+    teddyWidth_ = avx2 ? 32 : 16;
+#endif
+}
+
+void MultiPatternMatcher::buildAhoCorasick()
+{
+    // Bytes that are in no pattern are class 0, unless all of them are
+    unsigned classCount = 1;
+    memset(classes_, 0, sizeof(classes_));
+    for (char c : storage_)
+    {
+        const uint8_t b = c;
+        if (classes_[b] == 0 && classCount < 256)
+        {
+            classes_[b] = static_cast<uint8_t>(classCount++);
+        }
+        else if (classes_[b] == 0)
+        {
+            // The 256th byte; every byte is its own class then
+            for (unsigned i = 0; i < 256; ++i)
+            {
+                classes_[i] = static_cast<uint8_t>(i);
+            }
+            classCount = 256;
+            break;
+        }
+    }
+    classShift_ = 0;
+    while ((1U << classShift_) < classCount)
+    {
+        ++classShift_;
+    }
+    const size_t width = size_t(1) << classShift_;
+
+    // The trie, as state numbers, kNone for no edge yet
+    const uint32_t kNone = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> next(width, kNone);
+    std::vector<std::vector<uint32_t>> ends(1);
+    for (size_t id = 0; id < size(); ++id)
+    {
+        uint32_t s = 0;
+        for (char c : pattern(id))
+        {
+            const size_t edge = (s << classShift_) | classes_[uint8_t(c)];
+            if (next[edge] == kNone)
+            {
+                next[edge] = static_cast<uint32_t>(ends.size());
+                ends.emplace_back();
+                next.resize(next.size() + width, kNone);
+            }
+            s = next[edge];
+        }
+        ends[s].push_back(static_cast<uint32_t>(id));
+    }
+    const size_t states = ends.size();
+    if ((states << classShift_) > kReports)
+    {
+        throw std::invalid_argument("MultiPatternMatcher: too many patterns");
+    }
+
+    // Breadth first, each state's failure link is done before its own
+    // transitions are; missing edges go where the failure link's go
+    std::vector<uint32_t> failure(states, 0);
+    std::vector<uint32_t> queue;
+    queue.reserve(states);
+    outputLink_.assign(states, 0);
+    for (size_t c = 0; c < width; ++c)
+    {
+        if (next[c] == kNone)
+        {
+            next[c] = 0;
+        }
+        else
+        {
+            queue.push_back(next[c]);
+        }
+    }
+    for (size_t q = 0; q < queue.size(); ++q)
+    {
+        const uint32_t s = queue[q];
+        const uint32_t f = failure[s];
+        outputLink_[s] = ends[f].empty() ? outputLink_[f] : f;
+        for (size_t c = 0; c < width; ++c)
+        {
+            const size_t edge = (size_t(s) << classShift_) | c;
+            const uint32_t fallback = next[(size_t(f) << classShift_) | c];
+            if (next[edge] == kNone)
+            {
+                next[edge] = fallback;
+            }
+            else
+            {
+                failure[next[edge]] = fallback;
+                queue.push_back(next[edge]);
+            }
+        }
+    }
+
+    transitions_.resize(next.size());
+    for (size_t edge = 0; edge < next.size(); ++edge)
+    {
+        const uint32_t t = next[edge];
+        transitions_[edge] = (t << classShift_)
+            | (!ends[t].empty() || outputLink_[t] != 0 ? kReports : 0);
+    }
+    outputBegin_.assign(1, 0);
+    for (auto& patterns : ends)
+    {
+        outputs_.insert(outputs_.end(), patterns.begin(), patterns.end());
+        outputBegin_.push_back(static_cast<uint32_t>(outputs_.size()));
+    }
+}
+
+inline void MultiPatternMatcher::addMatch(StringPiece haystack, size_t id,
+                                          size_t offset,
+                                          std::vector<Match>* matches) const
+{
+    const Match match = {
+        id, offset,
+        StringPiece(haystack.data() + offset, pattern(id).size()),
+    };
+    matches->push_back(match);
+}
+
+void MultiPatternMatcher::teddyMatches(StringPiece haystack, bool firstOnly,
+                                       std::vector<Match>* matches) const
+{
+    const char* p = haystack.data();
+    const size_t size = haystack.size();
+    if (size < minLength_)
+    {
+        return;
+    }
+
+    // The patterns of the candidate buckets that are at position i, with
+    // the bytes of those compared added up in compared
+    size_t compared = 0;
+    auto check = [&](size_t i)
+    {
+        uint32_t buckets = 0xFF;
+        for (size_t j = 0; j < fingerprintLength_; ++j)
+        {
+            const uint8_t c = p[i + j];
+            buckets &= teddyMasks_[j][0][c & 0xF] & teddyMasks_[j][1][c >> 4];
+        }
+        bool any = false;
+        for (; buckets != 0; buckets &= buckets - 1)
+        {
+            for (uint32_t id : buckets_[findFirstSet(buckets) - 1])
+            {
+                const StringPiece pat = pattern(id);
+                if (pat.size() > size - i)
+                {
+                    continue;
+                }
+                compared += pat.size();
+                if (memcmp(p + i, pat.data(), pat.size()) == 0)
+                {
+                    addMatch(haystack, id, i, matches);
+                    any = true;
+                }
+            }
+        }
+        return any;
+    };
+
+    // Where the shortest pattern still fits
+    const size_t end = size - minLength_ + 1;
+    size_t i = 0;
+    for (;;)
+    {
+        uint32_t found;
+        i = teddyFind_(&teddyMasks_[0][0][0], p, size, i, &found);
+        if (found == 0)
+        {
+            break;
+        }
+        for (; found != 0; found &= found - 1)
+        {
+            const size_t at = i + findFirstSet(found) - 1;
+            if (at >= end)
+            {
+                return;
+            }
+            if (comparedTooMuch(compared, at))
+            {
+                ahoCorasickMatches(haystack, at, firstOnly, matches);
+                return;
+            }
+            if (check(at) && firstOnly)
+            {
+                return;
+            }
+        }
+        i += teddyWidth_;
+    }
+    for (; i < end; ++i)
+    {
+        if (comparedTooMuch(compared, i))
+        {
+            ahoCorasickMatches(haystack, i, firstOnly, matches);
+            return;
+        }
+        if (check(i) && firstOnly)
+        {
+            return;
+        }
+    }
+}
+
+void MultiPatternMatcher::ahoCorasickMatches(StringPiece haystack,
+                                             size_t from, bool firstOnly,
+                                             std::vector<Match>* matches) const
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(haystack.data());
+    const uint32_t* transitions = transitions_.data();
+    size_t stop = haystack.size();
+    uint32_t row = 0;
+    for (size_t i = from; i < stop; ++i)
+    {
+        row = transitions[(row & ~kReports) | classes_[p[i]]];
+        if (!(row & kReports))
+        {
+            continue;
+        }
+        for (uint32_t s = (row & ~kReports) >> classShift_; s != 0;
+             s = outputLink_[s])
+        {
+            for (uint32_t k = outputBegin_[s]; k != outputBegin_[s + 1]; ++k)
+            {
+                const uint32_t id = outputs_[k];
+                const size_t offset = i + 1 - pattern(id).size();
+                addMatch(haystack, id, offset, matches);
+                // Matches that end later start later too, once they are
+                // past the longest pattern
+                if (firstOnly)
+                {
+                    stop = std::min(stop, offset + maxLength_);
+                }
+            }
+        }
+    }
+}
+
+std::vector<MultiPatternMatcher::Match>
+MultiPatternMatcher::findAll(StringPiece haystack) const
+{
+    std::vector<Match> matches;
+    if (teddyFind_ != nullptr)
+    {
+        teddyMatches(haystack, false, &matches);
+    }
+    else
+    {
+        ahoCorasickMatches(haystack, 0, false, &matches);
+    }
+    std::sort(matches.begin(), matches.end(), comesBefore);
+    return matches;
+}
+
+bool MultiPatternMatcher::find(StringPiece haystack, Match* match) const
+{
+    std::vector<Match> matches;
+    if (teddyFind_ != nullptr)
+    {
+        teddyMatches(haystack, true, &matches);
+    }
+    else
+    {
+        ahoCorasickMatches(haystack, 0, true, &matches);
+    }
+    if (matches.empty())
+    {
+        return false;
+    }
+    *match = *std::min_element(matches.begin(), matches.end(), comesBefore);
+    return true;
+}
@@ -0,0 +1,119 @@
+// Copyright (C) 2015 chenqiang@outlook.com. All rights reserved.
+// Distributed under the terms and conditions of the Apache License.
+// See accompanying files LICENSE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <initializer_list>
+#include "Range.h"
+
+
+/**
+ * Finds any of a fixed set of patterns with one pass over the haystack,
+ * instead of a find() for each of them.  The patterns are compiled once,
+ * so keep the matcher around:
+ *
+ *   static const MultiPatternMatcher kTokens({ "<script", "javascript:",
+ *                                              "onload=" });
+ *   for (auto& match : kTokens.findAll(body)) {
+ *     // match.pattern is 0, 1 or 2, match.piece a subpiece of body
+ *   }
+ *
+ * Small sets are searched with Teddy, a SIMD filter on the first bytes of
+ * the patterns, and only its candidates are compared in full; larger ones
+ * with an Aho-Corasick automaton.  A haystack that makes Teddy compare
+ * much more than it scans, e.g. one built to look like the patterns, is
+ * searched with the automaton from there on.  Either way the time is
+ * linear in the haystack plus the matches, however many patterns there
+ * are, so haystacks from untrusted input are fine.
+ *
+ * The constructor throws std::invalid_argument on an empty pattern.
+ */
+class MultiPatternMatcher
+{
+public:
+    struct Match
+    {
+        size_t      pattern;    // index in the patterns given
+        size_t      offset;     // in the haystack
+        StringPiece piece;      // the match, a subpiece of the haystack
+    };
+
+    explicit MultiPatternMatcher(const std::vector<StringPiece>& patterns);
+    MultiPatternMatcher(std::initializer_list<StringPiece> patterns);
+
+    /*
+     * Every occurrence of every pattern, overlapping ones too, by offset
+     * and then by pattern.
+     */
+    std::vector<Match> findAll(StringPiece haystack) const;
+
+    /*
+     * The occurrence at the lowest offset, and of those the first pattern.
+     * Returns false if there is none.
+     */
+    bool find(StringPiece haystack, Match* match) const;
+
+    bool contains(StringPiece haystack) const
+    {
+        Match match;
+        return find(haystack, &match);
+    }
+
+    size_t size() const { return patternBegin_.size() - 1; }
+
+    StringPiece pattern(size_t i) const
+    {
+        return StringPiece(storage_.data() + patternBegin_[i],
+                           storage_.data() + patternBegin_[i + 1]);
+    }
+
+private:
+    // Teddy finds the positions whose first fingerprintLength_ bytes could
+    // start a pattern of a bucket, a block at a time
+    typedef size_t (*TeddyFind)(const uint8_t* masks, const char* p,
+                                size_t size, size_t i, uint32_t* found);
+
+    void buildTeddy();
+    void buildAhoCorasick();
+
+    void teddyMatches(StringPiece haystack, bool firstOnly,
+                      std::vector<Match>* matches) const;
+    // The matches at from and after it
+    void ahoCorasickMatches(StringPiece haystack, size_t from, bool firstOnly,
+                            std::vector<Match>* matches) const;
+
+    void addMatch(StringPiece haystack, size_t pattern, size_t offset,
+                  std::vector<Match>* matches) const;
+
+    std::string                 storage_;       // the patterns' bytes;
+    std::vector<size_t>         patternBegin_;  // pattern i is [patternBegin_[i],
+                                                // patternBegin_[i + 1])
+    size_t                      minLength_;
+    size_t                      maxLength_;
+
+    // Teddy, for up to kMaxTeddyPatterns
+    TeddyFind                   teddyFind_;     // null for Aho-Corasick only
+    size_t                      teddyWidth_;
+    size_t                      fingerprintLength_;
+    uint8_t                     teddyMasks_[3][2][16];  // bucket bits of
+                                                        // low, high nibbles
+    std::vector<uint32_t>       buckets_[8];    // patterns, in order
+
+    // Aho-Corasick, for every set: a DFA on classes of the bytes in the
+    // patterns.  The transitions of state s are the row at s << classShift_,
+    // and each is the row of the next state, with kReports set if it ends a
+    // pattern.
+    uint8_t                     classes_[256];
+    unsigned                    classShift_;
+    std::vector<uint32_t>       transitions_;
+    std::vector<uint32_t>       outputBegin_;   // patterns ending at a state,
+    std::vector<uint32_t>       outputs_;       // in [outputBegin_[s],
+                                                // outputBegin_[s + 1])
+    std::vector<uint32_t>       outputLink_;    // the longest suffix state
+                                                // with outputs, or 0
+};
@@ -154,6 +154,18 @@ struct MaxAlign { char c; } __attribute__((__aligned__));
 # error cannot define platform specific thread local storage
 #endif
 
+/* Whether the build has AddressSanitizer instrumentation: GCC defines
+ * __SANITIZE_ADDRESS__, clang answers __has_feature(address_sanitizer). */
+#ifndef FOLLY_SANITIZE_ADDRESS
+# if defined(__SANITIZE_ADDRESS__)
+#  define FOLLY_SANITIZE_ADDRESS 1
+# elif defined(__has_feature)
+#  if __has_feature(address_sanitizer)
+#   define FOLLY_SANITIZE_ADDRESS 1
+#  endif
+# endif
+#endif
+
 /* Define attribute wrapper for function attribute used to disable
  * address sanitizer instrumentation. Unfortunately, this attribute
  * has issues when inlining is used, so disable that as well. */
@@ -175,6 +187,13 @@ struct MaxAlign { char c; } __attribute__((__aligned__));
 # define FOLLY_DISABLE_ADDRESS_SANITIZER
 #endif
 
+// The SSE code paths are written with GCC builtins and per-function target
+// attributes, and are selected at runtime with CpuId.
+#if !defined(FOLLY_HAVE_EMMINTRIN_H) && defined(__GNUC__) && \
+    !defined(__clang__) && (FOLLY_X64 || defined(__i386__))
+# define FOLLY_HAVE_EMMINTRIN_H 1
+#endif
+
 #if !defined(__clang__) && !defined(_MSC_VER)
 #define FOLLY_CONSTEXPR constexpr
 #else
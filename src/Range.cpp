@@ -19,8 +19,10 @@
 
 #include "Range.h"
 #include <iostream>
+#include "Bits.h"
 #if FOLLY_HAVE_EMMINTRIN_H
 #include <emmintrin.h>  // __v16qi
+#include <immintrin.h>
 #endif
 
 /**
@@ -163,8 +165,9 @@ size_t scanHaystackBlock(const StringPiece haystack,
     const StringPiece needles,
     uint64_t blockStartIdx) {
     DCHECK_GT(needles.size(), 16);  // should handled by *needles16() method
+    // A load past the end stays on the page of the last byte
     DCHECK(blockStartIdx + 16 <= haystack.size() ||
-        (PAGE_FOR(haystack.data() + blockStartIdx) ==
+        (PAGE_FOR(haystack.end() - 1) ==
         PAGE_FOR(haystack.data() + blockStartIdx + 15)));
 
     __v16qi arr1;
@@ -236,8 +239,550 @@ size_t qfind_first_byte_of_sse42(const StringPiece haystack,
 
     return StringPiece::npos;
 }
+
+// The needles as a set of 256 bits, laid out for lookups with a byte
+// shuffle: the byte (h << 4 | l) is bit (h & 7) of byte l of the low lane
+// if h < 8, and of the high lane otherwise.  It takes a compare per needle,
+// all in registers, and then three shuffles tell a whole vector of the
+// haystack apart, however many needles there are.
+inline __m256i makeNibbleSet(const StringPiece needles)
+    __attribute__((__target__("avx2")));
+
+inline __m256i makeNibbleSet(const StringPiece needles) {
+    const __m256i slots = _mm256_setr_epi8(
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        -128, -127, -126, -125, -124, -123, -122, -121,
+        -120, -119, -118, -117, -116, -115, -114, -113);
+    __m256i set = _mm256_setzero_si256();
+    for (auto needle : needles) {
+        const uint8_t b = needle;
+        set = _mm256_or_si256(set, _mm256_and_si256(
+            _mm256_cmpeq_epi8(slots, _mm256_set1_epi8(b & 0x8F)),
+            _mm256_set1_epi8(static_cast<char>(1 << ((b >> 4) & 7)))));
+    }
+    return set;
+}
+
+// 1 << (h & 7) at index h
+inline __m128i nibbleSetBits() __attribute__((__target__("sse2")));
+
+inline __m128i nibbleSetBits() {
+    return _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                         1, 2, 4, 8, 16, 32, 64, -128);
+}
+
+// Bytes of v in the set, with its halves in every lane of lower and upper.
+// An index with the top bit set shuffles in zero, which keeps each half to
+// its own bytes.
+inline __m256i matchNibbleSet(__m256i v, __m256i lower, __m256i upper,
+                              __m256i bits)
+    __attribute__((__target__("avx2")));
+
+inline __m256i matchNibbleSet(__m256i v, __m256i lower, __m256i upper,
+                              __m256i bits) {
+    const __m256i index = _mm256_and_si256(v, _mm256_set1_epi8(0x8F));
+    const __m256i row = _mm256_or_si256(
+        _mm256_shuffle_epi8(lower, index),
+        _mm256_shuffle_epi8(upper,
+                            _mm256_xor_si256(index, _mm256_set1_epi8(0x80))));
+    const __m256i bit = _mm256_shuffle_epi8(bits,
+        _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F)));
+    return _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+}
+
+// Building the set costs about as much as SSE 4.2 takes to search a short
+// haystack, so it only pays from this size on.  Like the thresholds in
+// qfind_first_byte_of_nosse(), this was determined by benchmarking.
+inline size_t nibbleSetMinHaystack(const StringPiece needles) {
+    return std::min<size_t>(128, 40 + 8 * needles.size());
+}
+
+// The bytes of p[0, 16) in the set of lower and upper (or not in it, if
+// !kMember), as matchNibbleSet() finds them, as a bit mask
+template <bool kMember>
+inline uint32_t matchNibbleSet16(const char* p, __m128i lower, __m128i upper)
+    __attribute__((__target__("ssse3")));
+
+template <bool kMember>
+inline uint32_t matchNibbleSet16(const char* p, __m128i lower, __m128i upper) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    auto index = _mm_and_si128(v, _mm_set1_epi8(0x8F));
+    auto row = _mm_or_si128(
+        _mm_shuffle_epi8(lower, index),
+        _mm_shuffle_epi8(upper, _mm_xor_si128(index, _mm_set1_epi8(0x80))));
+    auto bit = _mm_shuffle_epi8(nibbleSetBits(),
+        _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F)));
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit)));
+    return kMember ? mask : mask ^ 0xFFFF;
+}
+
+// The first byte of haystack, which is at least 16 bytes long, that is in
+// the set (or isn't, if !kMember).  16 bytes at a time, the last block
+// overlapping the one before it.
+template <bool kMember>
+inline size_t scanNibbleSet_ssse3(const StringPiece haystack, __m128i lower,
+                                  __m128i upper)
+    __attribute__((__target__("ssse3")));
+
+template <bool kMember>
+inline size_t scanNibbleSet_ssse3(const StringPiece haystack, __m128i lower,
+                                  __m128i upper) {
+    const char* p = haystack.begin();
+    const size_t last = haystack.size() - 16;
+    for (size_t i = 0; ; i = std::min(i + 16, last)) {
+        uint32_t mask = matchNibbleSet16<kMember>(p + i, lower, upper);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        if (i == last) {
+            return StringPiece::npos;
+        }
+    }
+}
+
+// As scanNibbleSet_ssse3(), 32 bytes at a time, for haystacks of at least
+// 32 bytes; lower and upper are in both lanes.
+template <bool kMember>
+inline size_t scanNibbleSet_avx2(const StringPiece haystack, __m256i lower,
+                                 __m256i upper)
+    __attribute__((__target__("avx2")));
+
+template <bool kMember>
+inline size_t scanNibbleSet_avx2(const StringPiece haystack, __m256i lower,
+                                 __m256i upper) {
+    const __m256i bits = _mm256_broadcastsi128_si256(nibbleSetBits());
+    const char* p = haystack.begin();
+    const size_t last = haystack.size() - 32;
+    for (size_t i = 0; ; i = std::min(i + 32, last)) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            matchNibbleSet(v, lower, upper, bits)));
+        if (!kMember) {
+            mask = ~mask;
+        }
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        if (i == last) {
+            return StringPiece::npos;
+        }
+    }
+}
+
+// _mm512_broadcast_i32x4(), without the undefined pass-through operand
+// that GCC 12 warns about as maybe uninitialized
+inline __m512i broadcast128(__m128i v)
+    __attribute__((__target__("avx512bw")));
+
+inline __m512i broadcast128(__m128i v) {
+    return _mm512_maskz_broadcast_i32x4(0xFFFF, v);
+}
+
+// As matchNibbleSet(), the bytes of v among live that are in the set of
+// lower and upper (or aren't, if !kMember), as a bit mask
+template <bool kMember>
+inline uint64_t matchNibbleSet512(__m512i v, __mmask64 live, __m512i lower,
+                                  __m512i upper)
+    __attribute__((__target__("avx512bw")));
+
+template <bool kMember>
+inline uint64_t matchNibbleSet512(__m512i v, __mmask64 live, __m512i lower,
+                                  __m512i upper) {
+    auto index = _mm512_and_si512(v, _mm512_set1_epi8(0x8F));
+    auto row = _mm512_or_si512(
+        _mm512_shuffle_epi8(lower, index),
+        _mm512_shuffle_epi8(upper,
+                            _mm512_xor_si512(index, _mm512_set1_epi8(0x80))));
+    auto bit = _mm512_shuffle_epi8(broadcast128(nibbleSetBits()),
+        _mm512_and_si512(_mm512_srli_epi16(v, 4), _mm512_set1_epi8(0x0F)));
+    return kMember ? _mm512_mask_test_epi8_mask(live, row, bit)
+                   : _mm512_mask_testn_epi8_mask(live, row, bit);
+}
+
+// As scanNibbleSet_avx2(), 64 bytes at a time, for haystacks of any size.
+// The tail is a masked load, which never faults on the bytes it leaves out.
+template <bool kMember>
+inline size_t scanNibbleSet_avx512(const StringPiece haystack, __m512i lower,
+                                   __m512i upper)
+    __attribute__((__target__("avx512bw")));
+
+template <bool kMember>
+inline size_t scanNibbleSet_avx512(const StringPiece haystack, __m512i lower,
+                                   __m512i upper) {
+    const char* p = haystack.begin();
+    const size_t size = haystack.size();
+    for (size_t i = 0; i < size; i += 64) {
+        __mmask64 live = ~0ULL;
+        if (size - i < 64) {
+            live >>= 64 - (size - i);
+        }
+        auto v = _mm512_maskz_loadu_epi8(live, p + i);
+        uint64_t mask = matchNibbleSet512<kMember>(v, live, lower, upper);
+        if (mask != 0) {
+            return i + __builtin_ctzll(mask);
+        }
+    }
+    return StringPiece::npos;
+}
+
+// The reverse scans: the last byte of haystack that is in the set (or
+// isn't, if !kMember).  From the end, a block at a time, the first block
+// overlapping the one after it.  Haystacks are at least a block long.
+template <bool kMember>
+inline size_t rscanNibbleSet_ssse3(const StringPiece haystack, __m128i lower,
+                                   __m128i upper)
+    __attribute__((__target__("ssse3")));
+
+template <bool kMember>
+inline size_t rscanNibbleSet_ssse3(const StringPiece haystack, __m128i lower,
+                                   __m128i upper) {
+    const char* p = haystack.begin();
+    for (size_t i = haystack.size() - 16; ; i = i > 16 ? i - 16 : 0) {
+        uint32_t mask = matchNibbleSet16<kMember>(p + i, lower, upper);
+        if (mask != 0) {
+            return i + 31 - __builtin_clz(mask);
+        }
+        if (i == 0) {
+            return StringPiece::npos;
+        }
+    }
+}
+
+template <bool kMember>
+inline size_t rscanNibbleSet_avx2(const StringPiece haystack, __m256i lower,
+                                  __m256i upper)
+    __attribute__((__target__("avx2")));
+
+template <bool kMember>
+inline size_t rscanNibbleSet_avx2(const StringPiece haystack, __m256i lower,
+                                  __m256i upper) {
+    const __m256i bits = _mm256_broadcastsi128_si256(nibbleSetBits());
+    const char* p = haystack.begin();
+    for (size_t i = haystack.size() - 32; ; i = i > 32 ? i - 32 : 0) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            matchNibbleSet(v, lower, upper, bits)));
+        if (!kMember) {
+            mask = ~mask;
+        }
+        if (mask != 0) {
+            return i + 31 - __builtin_clz(mask);
+        }
+        if (i == 0) {
+            return StringPiece::npos;
+        }
+    }
+}
+
+template <bool kMember>
+inline size_t rscanNibbleSet_avx512(const StringPiece haystack, __m512i lower,
+                                    __m512i upper)
+    __attribute__((__target__("avx512bw")));
+
+template <bool kMember>
+inline size_t rscanNibbleSet_avx512(const StringPiece haystack, __m512i lower,
+                                    __m512i upper) {
+    const char* p = haystack.begin();
+    for (size_t i = haystack.size() - 64; ; i = i > 64 ? i - 64 : 0) {
+        auto v = _mm512_loadu_si512(p + i);
+        uint64_t mask = matchNibbleSet512<kMember>(v, ~0ULL, lower, upper);
+        if (mask != 0) {
+            return i + 63 - __builtin_clzll(mask);
+        }
+        if (i == 0) {
+            return StringPiece::npos;
+        }
+    }
+}
+
+size_t qfind_first_byte_of_avx2(const StringPiece haystack,
+    const StringPiece needles)
+    __attribute__((__target__("avx2"), noinline));
+
+// Any number of needles is one pass over the haystack, 32 bytes at a time.
+size_t qfind_first_byte_of_avx2(const StringPiece haystack,
+    const StringPiece needles) {
+    if (UNLIKELY(needles.empty() || haystack.empty())) {
+        return StringPiece::npos;
+    }
+    else if (needles.size() == 1) {
+        return qfind(haystack, needles[0]);
+    }
+    else if (haystack.size() < nibbleSetMinHaystack(needles)) {
+        return qfind_first_byte_of_sse42(haystack, needles);
+    }
+    const __m256i set = makeNibbleSet(needles);
+    return scanNibbleSet_avx2<true>(haystack,
+                                    _mm256_permute2x128_si256(set, set, 0x00),
+                                    _mm256_permute2x128_si256(set, set, 0x11));
+}
+
+size_t qfind_first_byte_of_avx512(const StringPiece haystack,
+    const StringPiece needles)
+    __attribute__((__target__("avx512bw"), noinline));
+
+// As qfind_first_byte_of_avx2(), 64 bytes at a time
+size_t qfind_first_byte_of_avx512(const StringPiece haystack,
+    const StringPiece needles) {
+    if (UNLIKELY(needles.empty() || haystack.empty())) {
+        return StringPiece::npos;
+    }
+    else if (needles.size() == 1) {
+        return qfind(haystack, needles[0]);
+    }
+    else if (haystack.size() < nibbleSetMinHaystack(needles)) {
+        return qfind_first_byte_of_sse42(haystack, needles);
+    }
+    const __m256i set = makeNibbleSet(needles);
+    return scanNibbleSet_avx512<true>(haystack,
+        broadcast128(_mm256_castsi256_si128(set)),
+        broadcast128(_mm256_extracti128_si256(set, 1)));
+}
+
+// A ByteSet is already laid out as makeNibbleSet() would, so these only
+// load its halves into every lane; short haystacks go down to the narrower
+// ones.
+size_t qfind_byteset_ssse3(const StringPiece haystack, const ByteSet& set,
+                           bool member)
+    __attribute__((__target__("ssse3"), noinline));
+
+size_t qfind_byteset_ssse3(const StringPiece haystack, const ByteSet& set,
+                           bool member) {
+    if (haystack.size() < 16) {
+        return qfind_byteset_nosse(haystack, set, member);
+    }
+    auto table = reinterpret_cast<const __m128i*>(set.table());
+    auto lower = _mm_loadu_si128(table);
+    auto upper = _mm_loadu_si128(table + 1);
+    return member ? scanNibbleSet_ssse3<true>(haystack, lower, upper)
+                  : scanNibbleSet_ssse3<false>(haystack, lower, upper);
+}
+
+size_t qfind_byteset_avx2(const StringPiece haystack, const ByteSet& set,
+                          bool member)
+    __attribute__((__target__("avx2"), noinline));
+
+size_t qfind_byteset_avx2(const StringPiece haystack, const ByteSet& set,
+                          bool member) {
+    if (haystack.size() < 48) {
+        return qfind_byteset_ssse3(haystack, set, member);
+    }
+    // The bytes sought are often close, and a narrow block is cheaper to
+    // look at first: wide loads straddle cache lines twice as often.
+    auto table = reinterpret_cast<const __m128i*>(set.table());
+    auto lower = _mm_loadu_si128(table);
+    auto upper = _mm_loadu_si128(table + 1);
+    const char* p = haystack.data();
+    uint32_t mask = member ? matchNibbleSet16<true>(p, lower, upper)
+                           : matchNibbleSet16<false>(p, lower, upper);
+    if (mask != 0) {
+        return __builtin_ctz(mask);
+    }
+    const StringPiece rest = haystack.subpiece(16);
+    const size_t i = member
+        ? scanNibbleSet_avx2<true>(rest, _mm256_broadcastsi128_si256(lower),
+                                   _mm256_broadcastsi128_si256(upper))
+        : scanNibbleSet_avx2<false>(rest, _mm256_broadcastsi128_si256(lower),
+                                    _mm256_broadcastsi128_si256(upper));
+    return i == StringPiece::npos ? i : i + 16;
+}
+
+size_t qfind_byteset_avx512(const StringPiece haystack, const ByteSet& set,
+                            bool member)
+    __attribute__((__target__("avx512bw"), noinline));
+
+size_t qfind_byteset_avx512(const StringPiece haystack, const ByteSet& set,
+                            bool member) {
+    if (haystack.size() < 48) {
+        return qfind_byteset_ssse3(haystack, set, member);
+    }
+    // As in qfind_byteset_avx2()
+    auto table = reinterpret_cast<const __m128i*>(set.table());
+    auto lower = _mm_loadu_si128(table);
+    auto upper = _mm_loadu_si128(table + 1);
+    const char* p = haystack.data();
+    uint32_t mask = member ? matchNibbleSet16<true>(p, lower, upper)
+                           : matchNibbleSet16<false>(p, lower, upper);
+    if (mask != 0) {
+        return __builtin_ctz(mask);
+    }
+    const StringPiece rest = haystack.subpiece(16);
+    const size_t i = member
+        ? scanNibbleSet_avx512<true>(rest, broadcast128(lower),
+                                     broadcast128(upper))
+        : scanNibbleSet_avx512<false>(rest, broadcast128(lower),
+                                      broadcast128(upper));
+    return i == StringPiece::npos ? i : i + 16;
+}
+
+size_t rfind_byteset_ssse3(const StringPiece haystack, const ByteSet& set,
+                           bool member)
+    __attribute__((__target__("ssse3"), noinline));
+
+size_t rfind_byteset_ssse3(const StringPiece haystack, const ByteSet& set,
+                           bool member) {
+    if (haystack.size() < 16) {
+        return rfind_byteset_nosse(haystack, set, member);
+    }
+    auto table = reinterpret_cast<const __m128i*>(set.table());
+    auto lower = _mm_loadu_si128(table);
+    auto upper = _mm_loadu_si128(table + 1);
+    return member ? rscanNibbleSet_ssse3<true>(haystack, lower, upper)
+                  : rscanNibbleSet_ssse3<false>(haystack, lower, upper);
+}
+
+size_t rfind_byteset_avx2(const StringPiece haystack, const ByteSet& set,
+                          bool member)
+    __attribute__((__target__("avx2"), noinline));
+
+// As qfind_byteset_avx2(), with the last 16 bytes first
+size_t rfind_byteset_avx2(const StringPiece haystack, const ByteSet& set,
+                          bool member) {
+    const size_t size = haystack.size();
+    if (size < 48) {
+        return rfind_byteset_ssse3(haystack, set, member);
+    }
+    auto table = reinterpret_cast<const __m128i*>(set.table());
+    auto lower = _mm_loadu_si128(table);
+    auto upper = _mm_loadu_si128(table + 1);
+    const char* p = haystack.data() + size - 16;
+    uint32_t mask = member ? matchNibbleSet16<true>(p, lower, upper)
+                           : matchNibbleSet16<false>(p, lower, upper);
+    if (mask != 0) {
+        return size - 16 + 31 - __builtin_clz(mask);
+    }
+    const StringPiece rest = haystack.subpiece(0, size - 16);
+    return member
+        ? rscanNibbleSet_avx2<true>(rest, _mm256_broadcastsi128_si256(lower),
+                                    _mm256_broadcastsi128_si256(upper))
+        : rscanNibbleSet_avx2<false>(rest, _mm256_broadcastsi128_si256(lower),
+                                     _mm256_broadcastsi128_si256(upper));
+}
+
+size_t rfind_byteset_avx512(const StringPiece haystack, const ByteSet& set,
+                            bool member)
+    __attribute__((__target__("avx512bw"), noinline));
+
+size_t rfind_byteset_avx512(const StringPiece haystack, const ByteSet& set,
+                            bool member) {
+    const size_t size = haystack.size();
+    if (size < 80) {
+        return rfind_byteset_avx2(haystack, set, member);
+    }
+    auto table = reinterpret_cast<const __m128i*>(set.table());
+    auto lower = _mm_loadu_si128(table);
+    auto upper = _mm_loadu_si128(table + 1);
+    const char* p = haystack.data() + size - 16;
+    uint32_t mask = member ? matchNibbleSet16<true>(p, lower, upper)
+                           : matchNibbleSet16<false>(p, lower, upper);
+    if (mask != 0) {
+        return size - 16 + 31 - __builtin_clz(mask);
+    }
+    const StringPiece rest = haystack.subpiece(0, size - 16);
+    return member
+        ? rscanNibbleSet_avx512<true>(rest, broadcast128(lower),
+                                      broadcast128(upper))
+        : rscanNibbleSet_avx512<false>(rest, broadcast128(lower),
+                                       broadcast128(upper));
+}
+
+size_t rfind_byte_sse2(const StringPiece haystack, char needle)
+    __attribute__((__target__("sse2"), noinline));
+
+// From the end, a block at a time, the first block overlapping the one
+// after it
+size_t rfind_byte_sse2(const StringPiece haystack, char needle) {
+    if (haystack.size() < 16) {
+        return rfind_byte_nosse(haystack, needle);
+    }
+    const __m128i n = _mm_set1_epi8(needle);
+    const char* p = haystack.data();
+    for (size_t i = haystack.size() - 16; ; i = i > 16 ? i - 16 : 0) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        auto mask = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, n)));
+        if (mask != 0) {
+            return i + 31 - __builtin_clz(mask);
+        }
+        if (i == 0) {
+            return StringPiece::npos;
+        }
+    }
+}
+
+size_t rfind_byte_avx2(const StringPiece haystack, char needle)
+    __attribute__((__target__("avx2"), noinline));
+
+size_t rfind_byte_avx2(const StringPiece haystack, char needle) {
+    if (haystack.size() < 32) {
+        return rfind_byte_sse2(haystack, needle);
+    }
+    const __m256i n = _mm256_set1_epi8(needle);
+    const char* p = haystack.data();
+    for (size_t i = haystack.size() - 32; ; i = i > 32 ? i - 32 : 0) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        auto mask = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, n)));
+        if (mask != 0) {
+            return i + 31 - __builtin_clz(mask);
+        }
+        if (i == 0) {
+            return StringPiece::npos;
+        }
+    }
+}
+
+size_t rfind_byte_avx512(const StringPiece haystack, char needle)
+    __attribute__((__target__("avx512bw"), noinline));
+
+size_t rfind_byte_avx512(const StringPiece haystack, char needle) {
+    if (haystack.size() < 64) {
+        return rfind_byte_avx2(haystack, needle);
+    }
+    const __m512i n = _mm512_set1_epi8(needle);
+    const char* p = haystack.data();
+    for (size_t i = haystack.size() - 64; ; i = i > 64 ? i - 64 : 0) {
+        uint64_t mask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(p + i), n);
+        if (mask != 0) {
+            return i + 63 - __builtin_clzll(mask);
+        }
+        if (i == 0) {
+            return StringPiece::npos;
+        }
+    }
+}
 #endif // FOLLY_HAVE_EMMINTRIN_H
 
+size_t qfind_byteset_nosse(const StringPiece haystack, const ByteSet& set,
+                           bool member) {
+    for (size_t i = 0; i < haystack.size(); ++i) {
+        if (set.contains(haystack[i]) == member) {
+            return i;
+        }
+    }
+    return StringPiece::npos;
+}
+
+size_t rfind_byteset_nosse(const StringPiece haystack, const ByteSet& set,
+                           bool member) {
+    for (size_t i = haystack.size(); i-- > 0; ) {
+        if (set.contains(haystack[i]) == member) {
+            return i;
+        }
+    }
+    return StringPiece::npos;
+}
+
+size_t rfind_byte_nosse(const StringPiece haystack, char needle) {
+    for (size_t i = haystack.size(); i-- > 0; ) {
+        if (haystack[i] == needle) {
+            return i;
+        }
+    }
+    return StringPiece::npos;
+}
+
 size_t qfind_first_byte_of_nosse(const StringPiece haystack,
     const StringPiece needles) {
     if (UNLIKELY(needles.empty() || haystack.empty())) {
@@ -255,3 +800,349 @@ size_t qfind_first_byte_of_nosse(const StringPiece haystack,
 }
 
 } // namespace detail
+
+
+namespace {
+
+// ASCII letters in lower case, other bytes as they are
+inline char foldCase(char c) {
+    return static_cast<unsigned char>(c - 'A') < 26
+        ? static_cast<char>(c | 0x20) : c;
+}
+
+template <bool kNoCase>
+inline char searchByte(char c) {
+    return kNoCase ? foldCase(c) : c;
+}
+
+// Length of the common prefix of a and b, at most n
+template <bool kNoCase>
+size_t commonPrefix(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+    if (!kNoCase) {
+        for (; i + 8 <= n; i += 8) {
+            uint64_t x, y;
+            memcpy(&x, a + i, 8);
+            memcpy(&y, b + i, 8);
+            if (x != y) {
+                break;
+            }
+        }
+    }
+    while (i < n && searchByte<kNoCase>(a[i]) == searchByte<kNoCase>(b[i])) {
+        ++i;
+    }
+    return i;
+}
+
+// The maximal suffix of x under the byte order, or under its reverse, as
+// where it starts (-1 for all of x) and its period
+template <bool kNoCase>
+void maximalSuffix(const char* x, ptrdiff_t m, bool reverse,
+                   ptrdiff_t* start, ptrdiff_t* period) {
+    ptrdiff_t s = -1, j = 0, k = 1, p = 1;
+    while (j + k < m) {
+        const uint8_t a = searchByte<kNoCase>(x[j + k]);
+        const uint8_t b = searchByte<kNoCase>(x[s + k]);
+        if (reverse ? a > b : a < b) {
+            j += k;
+            k = 1;
+            p = j - s;
+        }
+        else if (a == b) {
+            if (k != p) {
+                ++k;
+            }
+            else {
+                j += p;
+                k = 1;
+            }
+        }
+        else {
+            s = j++;
+            k = p = 1;
+        }
+    }
+    *start = s;
+    *period = p;
+}
+
+// Two-Way string matching (Crochemore and Perrin, 1991): linear in the
+// haystack however the needle repeats itself, in constant space.
+template <bool kNoCase>
+size_t twoWaySearch(const StringPiece haystack, const StringPiece needle) {
+    const char* x = needle.data();
+    const char* y = haystack.data();
+    const ptrdiff_t m = needle.size();
+    const ptrdiff_t n = haystack.size();
+    if (n < m) {
+        return StringPiece::npos;
+    }
+
+    // The critical factorization, x[0, ell] and x(ell, m)
+    ptrdiff_t ell, period, ell2, period2;
+    maximalSuffix<kNoCase>(x, m, false, &ell, &period);
+    maximalSuffix<kNoCase>(x, m, true, &ell2, &period2);
+    if (ell2 > ell) {
+        ell = ell2;
+        period = period2;
+    }
+    auto same = [](char a, char b) {
+        return searchByte<kNoCase>(a) == searchByte<kNoCase>(b);
+    };
+
+    if (static_cast<ptrdiff_t>(commonPrefix<kNoCase>(x, x + period, ell + 1))
+        == ell + 1) {
+        // x is periodic; the part of the left half known to match after a
+        // shift by the period isn't compared again
+        ptrdiff_t memory = -1;
+        for (ptrdiff_t j = 0; j <= n - m; ) {
+            ptrdiff_t i = std::max(ell, memory) + 1;
+            while (i < m && same(x[i], y[i + j])) {
+                ++i;
+            }
+            if (i < m) {
+                j += i - ell;
+                memory = -1;
+                continue;
+            }
+            i = ell;
+            while (i > memory && same(x[i], y[i + j])) {
+                --i;
+            }
+            if (i <= memory) {
+                return j;
+            }
+            j += period;
+            memory = m - period - 1;
+        }
+        return StringPiece::npos;
+    }
+
+    period = std::max(ell + 1, m - ell - 1) + 1;
+    for (ptrdiff_t j = 0; j <= n - m; ) {
+        ptrdiff_t i = ell + 1;
+        while (i < m && same(x[i], y[i + j])) {
+            ++i;
+        }
+        if (i < m) {
+            j += i - ell;
+            continue;
+        }
+        i = ell;
+        while (i >= 0 && same(x[i], y[i + j])) {
+            --i;
+        }
+        if (i < 0) {
+            return j;
+        }
+        j += period;
+    }
+    return StringPiece::npos;
+}
+
+// The positions that match the needle's first and last bytes are found a
+// vector at a time, and only those are compared in full (the "generic SIMD"
+// substring search).  That is quadratic at worst, e.g. for "aa...ab" in
+// "aaaa...", so once the full comparisons have taken much longer than the
+// scan itself, the rest of the haystack is left to Two-Way.
+inline bool comparedTooMuch(size_t compared, size_t scanned) {
+    return compared > 8 * scanned + 4096;
+}
+
+// The rest of the search, from position i on
+template <bool kNoCase>
+size_t twoWaySearchFrom(const StringPiece haystack, const StringPiece needle,
+                        size_t i) {
+    size_t found = twoWaySearch<kNoCase>(haystack.subpiece(i), needle);
+    return found == StringPiece::npos ? found : i + found;
+}
+
+// The first of the positions in mask, counted from p, where all of the
+// needle matches; *compared adds up the bytes compared at the others
+template <bool kNoCase>
+inline size_t checkCandidates(uint32_t mask, const char* p,
+                              const StringPiece needle, size_t* compared) {
+    const size_t m = needle.size();
+    for (; mask != 0; mask &= mask - 1) {
+        const size_t i = findFirstSet(mask) - 1;
+        if (m <= 2) {
+            return i;
+        }
+        const size_t same = commonPrefix<kNoCase>(p + i + 1, needle.data() + 1,
+                                                  m - 2);
+        if (same == m - 2) {
+            return i;
+        }
+        *compared += same + 1;
+    }
+    return StringPiece::npos;
+}
+
+template <bool kNoCase>
+size_t qfind_bytes_scalar(const StringPiece haystack,
+                          const StringPiece needle) {
+    const char* p = haystack.data();
+    const size_t m = needle.size();
+    const size_t positions = haystack.size() - m + 1;
+    const char first = searchByte<kNoCase>(needle[0]);
+    const char last = searchByte<kNoCase>(needle[m - 1]);
+    size_t compared = 0;
+    for (size_t i = 0; i < positions; ++i) {
+        if (searchByte<kNoCase>(p[i]) != first
+            || searchByte<kNoCase>(p[i + m - 1]) != last) {
+            continue;
+        }
+        if (checkCandidates<kNoCase>(1, p + i, needle, &compared) == 0) {
+            return i;
+        }
+        if (comparedTooMuch(compared, i)) {
+            return twoWaySearchFrom<kNoCase>(haystack, needle, i + 1);
+        }
+    }
+    return StringPiece::npos;
+}
+
+#if FOLLY_HAVE_EMMINTRIN_H
+
+// ASCII letters in lower case, as foldCase() does
+inline __m128i foldCase(__m128i v) __attribute__((__target__("sse2")));
+
+inline __m128i foldCase(__m128i v) {
+    const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(-128 + 26),
+        _mm_add_epi8(v, _mm_set1_epi8(0x80 - 'A')));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+inline __m256i foldCase(__m256i v) __attribute__((__target__("avx2")));
+
+inline __m256i foldCase(__m256i v) {
+    const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26),
+        _mm256_add_epi8(v, _mm256_set1_epi8(0x80 - 'A')));
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+template <bool kNoCase>
+size_t qfind_bytes_sse2(const StringPiece haystack, const StringPiece needle)
+    __attribute__((__target__("sse2"), noinline));
+
+// 16 positions at a time; the last block overlaps the one before it rather
+// than reading past the haystack
+template <bool kNoCase>
+size_t qfind_bytes_sse2(const StringPiece haystack, const StringPiece needle) {
+    const size_t m = needle.size();
+    if (haystack.size() - m + 1 < 16) {
+        return qfind_bytes_scalar<kNoCase>(haystack, needle);
+    }
+    const char* p = haystack.data();
+    const size_t end = haystack.size() - m + 1 - 16;
+    const __m128i first = _mm_set1_epi8(searchByte<kNoCase>(needle[0]));
+    const __m128i last = _mm_set1_epi8(searchByte<kNoCase>(needle[m - 1]));
+    size_t compared = 0;
+    for (size_t i = 0; ; i = std::min(i + 16, end)) {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        auto b = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(p + i + m - 1));
+        if (kNoCase) {
+            a = foldCase(a);
+            b = foldCase(b);
+        }
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+        if (mask != 0) {
+            size_t found = checkCandidates<kNoCase>(mask, p + i, needle,
+                                                    &compared);
+            if (found != StringPiece::npos) {
+                return i + found;
+            }
+        }
+        if (i == end) {
+            return StringPiece::npos;
+        }
+        if (comparedTooMuch(compared, i)) {
+            return twoWaySearchFrom<kNoCase>(haystack, needle, i + 16);
+        }
+    }
+}
+
+template <bool kNoCase>
+size_t qfind_bytes_avx2(const StringPiece haystack, const StringPiece needle)
+    __attribute__((__target__("avx2"), noinline));
+
+// As qfind_bytes_sse2(), 32 positions at a time
+template <bool kNoCase>
+size_t qfind_bytes_avx2(const StringPiece haystack, const StringPiece needle) {
+    const size_t m = needle.size();
+    if (haystack.size() - m + 1 < 32) {
+        return qfind_bytes_sse2<kNoCase>(haystack, needle);
+    }
+    const char* p = haystack.data();
+    const size_t end = haystack.size() - m + 1 - 32;
+    const __m256i first = _mm256_set1_epi8(searchByte<kNoCase>(needle[0]));
+    const __m256i last = _mm256_set1_epi8(searchByte<kNoCase>(needle[m - 1]));
+    size_t compared = 0;
+    for (size_t i = 0; ; i = std::min(i + 32, end)) {
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        auto b = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(p + i + m - 1));
+        if (kNoCase) {
+            a = foldCase(a);
+            b = foldCase(b);
+        }
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                             _mm256_cmpeq_epi8(b, last))));
+        if (mask != 0) {
+            size_t found = checkCandidates<kNoCase>(mask, p + i, needle,
+                                                    &compared);
+            if (found != StringPiece::npos) {
+                return i + found;
+            }
+        }
+        if (i == end) {
+            return StringPiece::npos;
+        }
+        if (comparedTooMuch(compared, i)) {
+            _mm256_zeroupper();
+            return twoWaySearchFrom<kNoCase>(haystack, needle, i + 32);
+        }
+    }
+}
+
+#endif // FOLLY_HAVE_EMMINTRIN_H
+
+template <bool kNoCase>
+size_t qfindBytes(const StringPiece haystack, const StringPiece needle) {
+    if (needle.size() > haystack.size()) {
+        return StringPiece::npos;
+    }
+    else if (needle.empty()) {
+        return 0;
+    }
+#if FOLLY_HAVE_EMMINTRIN_H
+    static auto const qfind_bytes_fn =
+        CpuId().avx2() && CpuId().osSupportsAvx()
+            ? &qfind_bytes_avx2<kNoCase> : &qfind_bytes_sse2<kNoCase>;
+    return qfind_bytes_fn(haystack, needle);
+#else
+    return qfind_bytes_scalar<kNoCase>(haystack, needle);
+#endif
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+size_t qfind_bytes(const StringPiece haystack, const StringPiece needle) {
+    if (needle.size() == 1) {
+        return qfind(haystack, needle[0]);
+    }
+    return qfindBytes<false>(haystack, needle);
+}
+
+size_t qfind_bytes_nocase(const StringPiece haystack,
+                          const StringPiece needle) {
+    return qfindBytes<true>(haystack, needle);
+}
+
+} // namespace detail
@@ -27,20 +27,27 @@
 #include <string>
 #include <stdexcept>
 #include <algorithm>
+#include <functional>
 #include <type_traits>
 #include "Portability.h"
 #include "Preprocessor.h"
 #include "Logging.h"
+#if FOLLY_HAVE_EMMINTRIN_H
+#include "CpuId.h"
+#endif
 
 
 
 template <class T> class Range;
+class ByteSet;
 
 /**
  * Finds the first occurrence of needle in haystack. The algorithm is on
  * average faster than O(haystack.size() * needle.size()) but not as fast
  * as Boyer-Moore. On the upside, it does not do any upfront
  * preprocessing and does not allocate memory.
+ * Char and byte ranges, compared exactly or with AsciiCaseInsensitive,
+ * are searched with SIMD instead, in linear time at worst.
  */
 template <class T, class Comp = std::equal_to<typename Range<T>::value_type>>
 inline size_t qfind(const Range<T> & haystack,
@@ -74,6 +81,21 @@ template <class T>
 inline size_t qfind_first_of(const Range<T> & haystack,
                              const Range<T> & needle);
 
+/**
+ * Finds the first element of haystack that is not in needles, and the
+ * last one that is, or that isn't.  O(haystack.size() * needles.size()),
+ * except for char and byte ranges, which are searched with SIMD through
+ * a ByteSet of the needles.
+ */
+template <class T>
+size_t qfind_first_not_of(const Range<T>& haystack, const Range<T>& needles);
+
+template <class T>
+size_t qfind_last_of(const Range<T>& haystack, const Range<T>& needles);
+
+template <class T>
+size_t qfind_last_not_of(const Range<T>& haystack, const Range<T>& needles);
+
 /**
  * Small internal helper - returns the value just before an iterator.
  */
@@ -556,6 +578,77 @@ public:
         return find(c, pos);
     }
 
+    // Works only for StringPiece and ByteRange
+    size_type find_first_of(const ByteSet& set) const
+    {
+        return qfind_first_of(castToConst(), set);
+    }
+
+    size_type find_first_of(const ByteSet& set, size_t pos) const
+    {
+        if (pos > size()) return std::string::npos;
+        size_type ret = qfind_first_of(castToConst().subpiece(pos), set);
+        return ret == npos ? ret : ret + pos;
+    }
+
+    size_type find_first_not_of(const_range_type needles) const
+    {
+        return qfind_first_not_of(castToConst(), needles);
+    }
+
+    size_type find_first_not_of(const_range_type needles, size_t pos) const
+    {
+        if (pos > size()) return std::string::npos;
+        size_type ret = qfind_first_not_of(castToConst().subpiece(pos),
+                                           needles);
+        return ret == npos ? ret : ret + pos;
+    }
+
+    // Works only for Range<(const) (unsigned) char*>
+    size_type find_first_not_of(value_type c) const
+    {
+        return find_first_not_of(const_range_type(&c, 1));
+    }
+
+    // Works only for StringPiece and ByteRange
+    size_type find_first_not_of(const ByteSet& set) const
+    {
+        return qfind_first_not_of(castToConst(), set);
+    }
+
+    size_type find_last_of(const_range_type needles) const
+    {
+        return qfind_last_of(castToConst(), needles);
+    }
+
+    size_type find_last_of(value_type c) const
+    {
+        return rfind(c);
+    }
+
+    // Works only for StringPiece and ByteRange
+    size_type find_last_of(const ByteSet& set) const
+    {
+        return qfind_last_of(castToConst(), set);
+    }
+
+    size_type find_last_not_of(const_range_type needles) const
+    {
+        return qfind_last_not_of(castToConst(), needles);
+    }
+
+    // Works only for Range<(const) (unsigned) char*>
+    size_type find_last_not_of(value_type c) const
+    {
+        return find_last_not_of(const_range_type(&c, 1));
+    }
+
+    // Works only for StringPiece and ByteRange
+    size_type find_last_not_of(const ByteSet& set) const
+    {
+        return qfind_last_not_of(castToConst(), set);
+    }
+
     /**
      * Determine whether the range contains the given subrange or item.
      *
@@ -876,11 +969,74 @@ operator>=(const T& lhs, const U& rhs)
 }
 
 
+struct AsciiCaseSensitive 
+{
+    bool operator()(char lhs, char rhs) const 
+    {
+        return lhs == rhs;
+    }
+};
+
+/**
+ * Check if two ascii characters are case insensitive equal.
+ * The difference between the lower/upper case characters are the 6-th bit.
+ * We also check they are alpha chars, in case of xor = 32.
+ */
+struct AsciiCaseInsensitive 
+{
+    bool operator()(char lhs, char rhs) const 
+    {
+        char k = lhs ^ rhs;
+        if (k == 0) return true;
+        if (k != 32) return false;
+        k = lhs | rhs;
+        return (k >= 'a' && k <= 'z');
+    }
+};
+
+extern const AsciiCaseSensitive asciiCaseSensitive;
+extern const AsciiCaseInsensitive asciiCaseInsensitive;
+
+namespace detail {
+
+size_t qfind_bytes(const StringPiece haystack, const StringPiece needle);
+size_t qfind_bytes_nocase(const StringPiece haystack, const StringPiece needle);
+
+// How qfind() searches Range<T> with Comp: 1 for char and byte ranges
+// compared exactly and 2 for those compared with AsciiCaseInsensitive,
+// both with SIMD, and 0 for the rest, one comparison at a time
+template <class T, class Comp,
+          class V = typename std::iterator_traits<T>::value_type>
+struct QfindKind : std::integral_constant<int,
+    !(std::is_same<T, const char*>::value
+      || std::is_same<T, const unsigned char*>::value) ? 0 :
+    std::is_same<Comp, AsciiCaseInsensitive>::value ? 2 :
+    std::is_same<Comp, AsciiCaseSensitive>::value
+    || std::is_same<Comp, std::equal_to<V>>::value
+    || std::is_same<Comp, std::equal_to<const V>>::value ? 1 : 0>
+{
+};
+
+template <class T, class Comp>
+inline size_t qfind_subrange(const Range<T>& haystack, const Range<T>& needle,
+                             Comp , std::integral_constant<int, 1>)
+{
+    return qfind_bytes(StringPiece(haystack), StringPiece(needle));
+}
+
+template <class T, class Comp>
+inline size_t qfind_subrange(const Range<T>& haystack, const Range<T>& needle,
+                             Comp , std::integral_constant<int, 2>)
+{
+    return qfind_bytes_nocase(StringPiece(haystack), StringPiece(needle));
+}
+
 /**
  * Finds substrings faster than brute force by borrowing from Boyer-Moore
  */
 template <class T, class Comp>
-size_t qfind(const Range<T>& haystack, const Range<T>& needle, Comp eq) 
+size_t qfind_subrange(const Range<T>& haystack, const Range<T>& needle,
+                      Comp eq, std::integral_constant<int, 0>)
 {
     // Don't use std::search, use a Boyer-Moore-like trick by comparing
     // the last characters first
@@ -934,19 +1090,126 @@ size_t qfind(const Range<T>& haystack, const Range<T>& needle, Comp eq)
     return std::string::npos;
 }
 
+} // namespace detail
+
+template <class T, class Comp>
+size_t qfind(const Range<T>& haystack, const Range<T>& needle, Comp eq)
+{
+    return detail::qfind_subrange(haystack, needle, eq,
+        std::integral_constant<int, detail::QfindKind<T, Comp>::value>());
+}
+
+/**
+ * A set of bytes to find any of, built once.  It is kept in the layout the
+ * SIMD searches look bytes up in, so a search has nothing to set up, and it
+ * can be built at compile time from a literal:
+ *
+ *   constexpr ByteSet kDelimiters(" ,;\t");
+ *   size_t i = qfind_first_of(line, kDelimiters);
+ *   size_t j = qfind_first_not_of(line, kDelimiters);
+ *   split(kDelimiters, line, fields);
+ *
+ * A literal gives all of its bytes but the terminating NUL, embedded NULs
+ * included.
+ */
+class ByteSet
+{
+public:
+    constexpr ByteSet() : table_() {}
+
+    template <size_t N>
+    constexpr explicit ByteSet(const char (&bytes)[N])
+        : ByteSet(bytes, N - 1)
+    {
+    }
+
+    constexpr ByteSet(const char* bytes, size_t size)
+        : table_{
+            slot(bytes, size, 0), slot(bytes, size, 1),
+            slot(bytes, size, 2), slot(bytes, size, 3),
+            slot(bytes, size, 4), slot(bytes, size, 5),
+            slot(bytes, size, 6), slot(bytes, size, 7),
+            slot(bytes, size, 8), slot(bytes, size, 9),
+            slot(bytes, size, 10), slot(bytes, size, 11),
+            slot(bytes, size, 12), slot(bytes, size, 13),
+            slot(bytes, size, 14), slot(bytes, size, 15),
+            slot(bytes, size, 16), slot(bytes, size, 17),
+            slot(bytes, size, 18), slot(bytes, size, 19),
+            slot(bytes, size, 20), slot(bytes, size, 21),
+            slot(bytes, size, 22), slot(bytes, size, 23),
+            slot(bytes, size, 24), slot(bytes, size, 25),
+            slot(bytes, size, 26), slot(bytes, size, 27),
+            slot(bytes, size, 28), slot(bytes, size, 29),
+            slot(bytes, size, 30), slot(bytes, size, 31) }
+    {
+    }
+
+    // At run time, a byte at a time rather than a slot at a time
+    explicit ByteSet(StringPiece bytes)
+        : table_()
+    {
+        for (char c : bytes) {
+            table_[slotOf(static_cast<uint8_t>(c))]
+                |= bitOf(static_cast<uint8_t>(c));
+        }
+    }
+
+    constexpr bool contains(char c) const
+    {
+        return (table_[slotOf(static_cast<uint8_t>(c))]
+                & bitOf(static_cast<uint8_t>(c))) != 0;
+    }
+
+    /*
+     * The byte (h << 4 | l) is bit (h & 7) of table()[l] if h < 8, and of
+     * table()[16 + l] otherwise; 32 bytes.
+     */
+    const uint8_t* table() const { return table_; }
+
+private:
+    static constexpr size_t slotOf(uint8_t c)
+    {
+        return ((c >> 3) & 16) | (c & 15);
+    }
+
+    static constexpr uint8_t bitOf(uint8_t c)
+    {
+        return static_cast<uint8_t>(1 << ((c >> 4) & 7));
+    }
+
+    // table_[i] for bytes[0, size), halving so as not to recurse deeply
+    static constexpr uint8_t slot(const char* bytes, size_t size, size_t i)
+    {
+        return size == 0 ? 0
+            : size == 1
+            ? (slotOf(static_cast<uint8_t>(bytes[0])) == i
+               ? bitOf(static_cast<uint8_t>(bytes[0])) : 0)
+            : static_cast<uint8_t>(slot(bytes, size / 2, i)
+                | slot(bytes + size / 2, size - size / 2, i));
+    }
+
+    uint8_t table_[32];
+};
+
 namespace detail {
 
 size_t qfind_first_byte_of_nosse(const StringPiece haystack, const StringPiece needles);
         
 #if FOLLY_HAVE_EMMINTRIN_H
 size_t qfind_first_byte_of_sse42(const StringPiece haystack, const StringPiece needles);
+size_t qfind_first_byte_of_avx2(const StringPiece haystack, const StringPiece needles);
+size_t qfind_first_byte_of_avx512(const StringPiece haystack, const StringPiece needles);
+
+// The widest one the CPU has, chosen on the first call
 inline size_t qfind_first_byte_of(const StringPiece haystack, const StringPiece needles) 
 {        
     static auto const qfind_first_byte_of_fn =
-        CpuId().sse42() ? qfind_first_byte_of_sse42
-        : qfind_first_byte_of_nosse;
+        CpuId().avx512bw() && CpuId().osSupportsAvx512() ? qfind_first_byte_of_avx512 :
+        CpuId().avx2() && CpuId().osSupportsAvx() ? qfind_first_byte_of_avx2 :
+        CpuId().sse42() ? qfind_first_byte_of_sse42 :
+        qfind_first_byte_of_nosse;
     return qfind_first_byte_of_fn(haystack, needles);
-    }
+}
 
 #else
 inline size_t qfind_first_byte_of(const StringPiece haystack, const StringPiece needles)
@@ -955,6 +1218,90 @@ inline size_t qfind_first_byte_of(const StringPiece haystack, const StringPiece
 }
 #endif // FOLLY_HAVE_EMMINTRIN_H
 
+// The first byte of haystack that is in set if member, or isn't otherwise
+size_t qfind_byteset_nosse(const StringPiece haystack, const ByteSet& set,
+                           bool member);
+
+#if FOLLY_HAVE_EMMINTRIN_H
+size_t qfind_byteset_ssse3(const StringPiece haystack, const ByteSet& set,
+                           bool member);
+size_t qfind_byteset_avx2(const StringPiece haystack, const ByteSet& set,
+                          bool member);
+size_t qfind_byteset_avx512(const StringPiece haystack, const ByteSet& set,
+                            bool member);
+
+inline size_t qfind_byteset(const StringPiece haystack, const ByteSet& set,
+                            bool member)
+{
+    static auto const qfind_byteset_fn =
+        CpuId().avx512bw() && CpuId().osSupportsAvx512() ? qfind_byteset_avx512 :
+        CpuId().avx2() && CpuId().osSupportsAvx() ? qfind_byteset_avx2 :
+        CpuId().ssse3() ? qfind_byteset_ssse3 :
+        qfind_byteset_nosse;
+    return qfind_byteset_fn(haystack, set, member);
+}
+
+#else
+inline size_t qfind_byteset(const StringPiece haystack, const ByteSet& set,
+                            bool member)
+{
+    return qfind_byteset_nosse(haystack, set, member);
+}
+#endif // FOLLY_HAVE_EMMINTRIN_H
+
+// As qfind_byteset(), the last such byte
+size_t rfind_byteset_nosse(const StringPiece haystack, const ByteSet& set,
+                           bool member);
+
+// The last needle in haystack
+size_t rfind_byte_nosse(const StringPiece haystack, char needle);
+
+#if FOLLY_HAVE_EMMINTRIN_H
+size_t rfind_byteset_ssse3(const StringPiece haystack, const ByteSet& set,
+                           bool member);
+size_t rfind_byteset_avx2(const StringPiece haystack, const ByteSet& set,
+                          bool member);
+size_t rfind_byteset_avx512(const StringPiece haystack, const ByteSet& set,
+                            bool member);
+
+inline size_t rfind_byteset(const StringPiece haystack, const ByteSet& set,
+                            bool member)
+{
+    static auto const rfind_byteset_fn =
+        CpuId().avx512bw() && CpuId().osSupportsAvx512() ? rfind_byteset_avx512 :
+        CpuId().avx2() && CpuId().osSupportsAvx() ? rfind_byteset_avx2 :
+        CpuId().ssse3() ? rfind_byteset_ssse3 :
+        rfind_byteset_nosse;
+    return rfind_byteset_fn(haystack, set, member);
+}
+
+size_t rfind_byte_sse2(const StringPiece haystack, char needle);
+size_t rfind_byte_avx2(const StringPiece haystack, char needle);
+size_t rfind_byte_avx512(const StringPiece haystack, char needle);
+
+inline size_t rfind_byte(const StringPiece haystack, char needle)
+{
+    static auto const rfind_byte_fn =
+        CpuId().avx512bw() && CpuId().osSupportsAvx512() ? rfind_byte_avx512 :
+        CpuId().avx2() && CpuId().osSupportsAvx() ? rfind_byte_avx2 :
+        CpuId().sse2() ? rfind_byte_sse2 :
+        rfind_byte_nosse;
+    return rfind_byte_fn(haystack, needle);
+}
+
+#else
+inline size_t rfind_byteset(const StringPiece haystack, const ByteSet& set,
+                            bool member)
+{
+    return rfind_byteset_nosse(haystack, set, member);
+}
+
+inline size_t rfind_byte(const StringPiece haystack, char needle)
+{
+    return rfind_byte_nosse(haystack, needle);
+}
+#endif // FOLLY_HAVE_EMMINTRIN_H
+
 } // namespace detail
 
 
@@ -967,35 +1314,6 @@ size_t qfind_first_of(const Range<T> & haystack, const Range<T> & needles, Comp
     return ret == haystack.end() ? std::string::npos : ret - haystack.begin();
 }
 
-struct AsciiCaseSensitive 
-{
-    bool operator()(char lhs, char rhs) const 
-    {
-        return lhs == rhs;
-    }
-};
-
-/**
- * Check if two ascii characters are case insensitive equal.
- * The difference between the lower/upper case characters are the 6-th bit.
- * We also check they are alpha chars, in case of xor = 32.
- */
-struct AsciiCaseInsensitive 
-{
-    bool operator()(char lhs, char rhs) const 
-    {
-        char k = lhs ^ rhs;
-        if (k == 0) return true;
-        if (k != 32) return false;
-        k = lhs | rhs;
-        return (k >= 'a' && k <= 'z');
-    }
-};
-
-extern const AsciiCaseSensitive asciiCaseSensitive;
-extern const AsciiCaseInsensitive asciiCaseInsensitive;
-
-
 template <class T>
 size_t qfind(const Range<T>& haystack,
              const typename Range<T>::value_type& needle) 
@@ -1025,15 +1343,11 @@ inline size_t qfind(const Range<const char*>& haystack, const char& needle)
   return pos == nullptr ? std::string::npos : pos - haystack.data();
 }
 
-#if FOLLY_HAVE_MEMRCHR
 template <>
 inline size_t rfind(const Range<const char*>& haystack, const char& needle) 
 {
-    auto pos = static_cast<const char*>(
-        ::memrchr(haystack.data(), needle, haystack.size()));
-    return pos == nullptr ? std::string::npos : pos - haystack.data();
+  return detail::rfind_byte(haystack, needle);
 }
-#endif
 
 // specialization for ByteRange
 template <>
@@ -1045,16 +1359,12 @@ inline size_t qfind(const Range<const unsigned char*>& haystack,
   return pos == nullptr ? std::string::npos : pos - haystack.data();
 }
 
-#if FOLLY_HAVE_MEMRCHR
 template <>
 inline size_t rfind(const Range<const unsigned char*>& haystack,
                     const unsigned char& needle) 
 {
-  auto pos = static_cast<const unsigned char*>(
-    ::memrchr(haystack.data(), needle, haystack.size()));
-  return pos == nullptr ? std::string::npos : pos - haystack.data();
+  return detail::rfind_byte(StringPiece(haystack), static_cast<char>(needle));
 }
-#endif
 
 template <class T>
 size_t qfind_first_of(const Range<T>& haystack,
@@ -1079,3 +1389,143 @@ inline size_t qfind_first_of(const Range<const unsigned char*>& haystack,
   return detail::qfind_first_byte_of(StringPiece(haystack),
                                      StringPiece(needles));
 }
+
+/**
+ * Finds the first byte of haystack that is in set, or that isn't.
+ */
+inline size_t qfind_first_of(const StringPiece& haystack, const ByteSet& set)
+{
+  return detail::qfind_byteset(haystack, set, true);
+}
+
+inline size_t qfind_first_of(const ByteRange& haystack, const ByteSet& set)
+{
+  return detail::qfind_byteset(StringPiece(haystack), set, true);
+}
+
+inline size_t qfind_first_not_of(const StringPiece& haystack,
+                                 const ByteSet& set)
+{
+  return detail::qfind_byteset(haystack, set, false);
+}
+
+inline size_t qfind_first_not_of(const ByteRange& haystack,
+                                 const ByteSet& set)
+{
+  return detail::qfind_byteset(StringPiece(haystack), set, false);
+}
+
+/**
+ * Finds the last byte of haystack that is in set, or that isn't.
+ */
+inline size_t qfind_last_of(const StringPiece& haystack, const ByteSet& set)
+{
+  return detail::rfind_byteset(haystack, set, true);
+}
+
+inline size_t qfind_last_of(const ByteRange& haystack, const ByteSet& set)
+{
+  return detail::rfind_byteset(StringPiece(haystack), set, true);
+}
+
+inline size_t qfind_last_not_of(const StringPiece& haystack,
+                                const ByteSet& set)
+{
+  return detail::rfind_byteset(haystack, set, false);
+}
+
+inline size_t qfind_last_not_of(const ByteRange& haystack, const ByteSet& set)
+{
+  return detail::rfind_byteset(StringPiece(haystack), set, false);
+}
+
+namespace detail {
+
+template <class T>
+bool containsElement(const Range<T>& needles,
+                     const typename Range<T>::value_type& value)
+{
+  return std::find(needles.begin(), needles.end(), value) != needles.end();
+}
+
+} // namespace detail
+
+template <class T>
+size_t qfind_first_not_of(const Range<T>& haystack, const Range<T>& needles)
+{
+  for (size_t i = 0; i < haystack.size(); ++i) {
+    if (!detail::containsElement(needles, haystack[i])) {
+      return i;
+    }
+  }
+  return std::string::npos;
+}
+
+template <class T>
+size_t qfind_last_of(const Range<T>& haystack, const Range<T>& needles)
+{
+  for (auto i = haystack.size(); i-- > 0; ) {
+    if (detail::containsElement(needles, haystack[i])) {
+      return i;
+    }
+  }
+  return std::string::npos;
+}
+
+template <class T>
+size_t qfind_last_not_of(const Range<T>& haystack, const Range<T>& needles)
+{
+  for (auto i = haystack.size(); i-- > 0; ) {
+    if (!detail::containsElement(needles, haystack[i])) {
+      return i;
+    }
+  }
+  return std::string::npos;
+}
+
+// specializations for StringPiece and ByteRange
+template <>
+inline size_t qfind_first_not_of(const Range<const char*>& haystack,
+                                 const Range<const char*>& needles)
+{
+  return detail::qfind_byteset(haystack, ByteSet(needles), false);
+}
+
+template <>
+inline size_t qfind_first_not_of(const Range<const unsigned char*>& haystack,
+                                 const Range<const unsigned char*>& needles)
+{
+  return detail::qfind_byteset(StringPiece(haystack),
+                               ByteSet(StringPiece(needles)), false);
+}
+
+template <>
+inline size_t qfind_last_of(const Range<const char*>& haystack,
+                            const Range<const char*>& needles)
+{
+  return needles.size() == 1
+      ? detail::rfind_byte(haystack, needles[0])
+      : detail::rfind_byteset(haystack, ByteSet(needles), true);
+}
+
+template <>
+inline size_t qfind_last_of(const Range<const unsigned char*>& haystack,
+                            const Range<const unsigned char*>& needles)
+{
+  return qfind_last_of(StringPiece(haystack), StringPiece(needles));
+}
+
+template <>
+inline size_t qfind_last_not_of(const Range<const char*>& haystack,
+                                const Range<const char*>& needles)
+{
+  return detail::rfind_byteset(haystack, ByteSet(needles), false);
+}
+
+template <>
+inline size_t qfind_last_not_of(const Range<const unsigned char*>& haystack,
+                                const Range<const unsigned char*>& needles)
+{
+  return detail::rfind_byteset(StringPiece(haystack),
+                               ByteSet(StringPiece(needles)), false);
+}
@@ -122,10 +122,36 @@ void internalSplit(DelimT delim, StringPiece sp, OutputIterator out,
 }
 
 
+/*
+ * internalSplit() on any byte of a set, each found by a SIMD search of the
+ * rest of the string rather than by testing a byte at a time.
+ */
+template<class OutStringT, class OutputIterator>
+void internalSplit(const ByteSet& delim, StringPiece sp, OutputIterator out,
+    bool ignoreEmpty) {
+  assert(sp.empty() || sp.start() != nullptr);
+
+  OutputConverter<OutStringT> conv;
+
+  for (;;) {
+    const size_t i = qfind_first_of(sp, delim);
+    const StringPiece token = i == StringPiece::npos ? sp : sp.subpiece(0, i);
+    if (!ignoreEmpty || !token.empty()) {
+      *out++ = conv(token);
+    }
+    if (i == StringPiece::npos) {
+      return;
+    }
+    sp.advance(i + 1);
+  }
+}
+
+
 template<class String> StringPiece prepareDelim(const String& s) {
   return StringPiece(s);
 }
 inline char prepareDelim(char c) { return c; }
+inline const ByteSet& prepareDelim(const ByteSet& set) { return set; }
 
 template <class Dst>
 struct convertTo {
@@ -16,6 +16,7 @@
 
 #include "Strings.h"
 #include <stdarg.h>
+#include <string.h>
 #include <ctype.h>
 #include <array>
 #include <memory>
@@ -23,6 +24,10 @@
 #include <iterator>
 #include <algorithm>
 #include "ScopeGuard.h"
+#if FOLLY_HAVE_EMMINTRIN_H
+#include <immintrin.h>
+#include "CpuId.h"
+#endif
 
 namespace {
 
@@ -215,41 +220,125 @@ const unsigned char uriEscapeTable[] =
 
 }  // namespace detail
 
+namespace {
+
+// Returns the first position in [p, e) holding a character that cEscape
+// doesn't copy as is.
+inline const char* skipPrintable_scalar(const char* p, const char* e)
+{
+    while (p != e && detail::cEscapeTable[static_cast<unsigned char>(*p)] == 'P') {
+        ++p;
+    }
+    return p;
+}
+
+#if FOLLY_HAVE_EMMINTRIN_H
+
+// Printable is [0x20, 0x7e], that is signed v > 0x1f and v != 0x7f, less
+// the characters with one-character escapes.
+const char* skipPrintable_sse2(const char* p, const char* e)
+    __attribute__((__target__("sse2"), noinline));
+
+const char* skipPrintable_sse2(const char* p, const char* e)
+{
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i question = _mm_set1_epi8('?');
+    for (; e - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi8(space, v), _mm_cmpeq_epi8(v, del)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                      _mm_cmpeq_epi8(v, backslash)),
+                         _mm_cmpeq_epi8(v, question)));
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skipPrintable_scalar(p, e);
+}
+
+const char* skipPrintable_avx2(const char* p, const char* e)
+    __attribute__((__target__("avx2"), noinline));
+
+const char* skipPrintable_avx2(const char* p, const char* e)
+{
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i question = _mm256_set1_epi8('?');
+    for (; e - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi8(space, v),
+                            _mm256_cmpeq_epi8(v, del)),
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                            _mm256_cmpeq_epi8(v, backslash)),
+                            _mm256_cmpeq_epi8(v, question)));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(special));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    // Leave no upper AVX state behind for the SSE2 tail; GCC doesn't when
+    // it turns the call into a jump
+    _mm256_zeroupper();
+    return skipPrintable_sse2(p, e);
+}
+
+inline const char* skipPrintable(const char* p, const char* e)
+{
+    static auto const skipPrintable_fn =
+        CpuId().avx2() && CpuId().osSupportsAvx()
+            ? skipPrintable_avx2 : skipPrintable_sse2;
+    return skipPrintable_fn(p, e);
+}
+
+#else
+
+inline const char* skipPrintable(const char* p, const char* e)
+{
+    return skipPrintable_scalar(p, e);
+}
+
+#endif // FOLLY_HAVE_EMMINTRIN_H
+
+}  // namespace
+
 void cEscape(StringPiece str, std::string& out) 
 {
     char esc[4];
     esc[0] = '\\';
     out.reserve(out.size() + str.size());
-    auto p = str.begin();
-    auto last = p;  // last regular character
-    // We advance over runs of regular characters (printable, not double-quote or
-    // backslash) and copy them in one go; this is faster than calling push_back
-    // repeatedly.
-    while (p != str.end()) {
-        char c = *p;
-        unsigned char v = static_cast<unsigned char>(c);
-        char e = detail::cEscapeTable[v];
-        if (e == 'P') {  // printable
-            ++p;
+    const char* p = str.begin();
+    const char* end = str.end();
+    // We find runs of regular characters (printable, not double-quote,
+    // backslash or question mark) 16 or 32 at a time and copy them in one go.
+    while (p != end) {
+        const char* run = p;
+        p = skipPrintable(p, end);
+        out.append(run, p - run);
+        if (p == end) {
+            break;
         }
-        else if (e == 'O') {  // octal
-            out.append(&*last, p - last);
+        unsigned char v = static_cast<unsigned char>(*p);
+        char e = detail::cEscapeTable[v];
+        if (e == 'O') {  // octal
             esc[1] = '0' + ((v >> 6) & 7);
             esc[2] = '0' + ((v >> 3) & 7);
             esc[3] = '0' + (v & 7);
             out.append(esc, 4);
-            ++p;
-            last = p;
         }
         else {  // special 1-character escape
-            out.append(&*last, p - last);
             esc[1] = e;
             out.append(esc, 2);
-            ++p;
-            last = p;
         }
+        ++p;
     }
-    out.append(&*last, p - last);
 }
 
 void cUnescape(StringPiece str, std::string& out, bool strict)
@@ -257,15 +346,16 @@ void cUnescape(StringPiece str, std::string& out, bool strict)
     out.reserve(out.size() + str.size());
     auto p = str.begin();
     auto last = p;  // last regular character (not part of an escape sequence)
-    // We advance over runs of regular characters (not backslash) and copy them
-    // in one go; this is faster than calling push_back repeatedly.
+    // We jump over runs of regular characters (not backslash) with memchr,
+    // which compares many bytes at a time, and copy them in one go.
     while (p != str.end()) {
-        char c = *p;
-        if (c != '\\') {  // normal case
-            ++p;
-            continue;
+        p = static_cast<const char*>(memchr(p, '\\', str.end() - p));
+        if (p == nullptr) {
+            p = str.end();
+            break;
         }
         out.append(&*last, p - last);
+        ++p;
         if (p == str.end()) {  // backslash at end of string
             if (strict) {
                 throw std::invalid_argument("incomplete escape sequence");
@@ -274,7 +364,6 @@ void cUnescape(StringPiece str, std::string& out, bool strict)
             last = p;
             continue;
         }
-        ++p;
         char e = detail::cUnescapeTable[static_cast<unsigned char>(*p)];
         if (e == 'O') {  // octal
             unsigned char val = 0;
@@ -323,84 +412,318 @@ void cUnescape(StringPiece str, std::string& out, bool strict)
     out.append(&*last, p - last);
 }
 
+namespace {
+
+// Returns the first position in [p, e) holding a character that uriEscape
+// encodes in a mode with the given minEncode.
+inline const char* skipUriSafe_scalar(const char* p, const char* e,
+                                      unsigned char minEncode)
+{
+    while (p != e && detail::uriEscapeTable[static_cast<unsigned char>(*p)] <= minEncode) {
+        ++p;
+    }
+    return p;
+}
+
+// Returns the first '%', or '+' if plus is set, in [p, e).
+inline const char* findUriSpecial_scalar(const char* p, const char* e,
+                                         bool plus)
+{
+    while (p != e && *p != '%' && !(plus && *p == '+')) {
+        ++p;
+    }
+    return p;
+}
+
+#if FOLLY_HAVE_EMMINTRIN_H
+
+// Bytes of v in [lo, hi], moved to the bottom of the signed range so that
+// a single signed compare does.
+inline __m128i inRange_sse2(__m128i v, char lo, char hi)
+{
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(0x80 - lo));
+    return _mm_cmpgt_epi8(_mm_set1_epi8(-128 + (hi - lo) + 1), shifted);
+}
+
+// Safe characters are "-.0123456789" (with '/' between them in PATH
+// mode), letters of either case, '_' and '~'.
+inline __m128i uriSafe_sse2(__m128i v, __m128i notPath)
+{
+    __m128i marksAndDigits = _mm_andnot_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('/')), notPath),
+        inRange_sse2(v, '-', '9'));
+    __m128i letters = inRange_sse2(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+                                   'a', 'z');
+    return _mm_or_si128(
+        _mm_or_si128(marksAndDigits, letters),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('~'))));
+}
+
+const char* skipUriSafe_sse2(const char* p, const char* e,
+                             unsigned char minEncode)
+    __attribute__((__target__("sse2"), noinline));
+
+const char* skipUriSafe_sse2(const char* p, const char* e,
+                             unsigned char minEncode)
+{
+    const __m128i notPath = _mm_set1_epi8(
+        minEncode == static_cast<unsigned char>(UriEscapeMode::PATH) ? 0 : -1);
+    for (; e - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = ~_mm_movemask_epi8(uriSafe_sse2(v, notPath)) & 0xFFFF;
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skipUriSafe_scalar(p, e, minEncode);
+}
+
+inline __m256i inRange_avx2(__m256i v, char lo, char hi)
+    __attribute__((__target__("avx2")));
+
+inline __m256i inRange_avx2(__m256i v, char lo, char hi)
+{
+    __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8(0x80 - lo));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + (hi - lo) + 1), shifted);
+}
+
+const char* skipUriSafe_avx2(const char* p, const char* e,
+                             unsigned char minEncode)
+    __attribute__((__target__("avx2"), noinline));
+
+const char* skipUriSafe_avx2(const char* p, const char* e,
+                             unsigned char minEncode)
+{
+    const __m256i notPath = _mm256_set1_epi8(
+        minEncode == static_cast<unsigned char>(UriEscapeMode::PATH) ? 0 : -1);
+    for (; e - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i marksAndDigits = _mm256_andnot_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')),
+                             notPath),
+            inRange_avx2(v, '-', '9'));
+        __m256i letters = inRange_avx2(
+            _mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i safe = _mm256_or_si256(
+            _mm256_or_si256(marksAndDigits, letters),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('~'))));
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(safe));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return skipUriSafe_sse2(p, e, minEncode);
+}
+
+inline const char* skipUriSafe(const char* p, const char* e,
+                               unsigned char minEncode)
+{
+    static auto const skipUriSafe_fn =
+        CpuId().avx2() && CpuId().osSupportsAvx()
+            ? skipUriSafe_avx2 : skipUriSafe_sse2;
+    return skipUriSafe_fn(p, e, minEncode);
+}
+
+const char* findUriSpecial_sse2(const char* p, const char* e, bool plus)
+    __attribute__((__target__("sse2"), noinline));
+
+const char* findUriSpecial_sse2(const char* p, const char* e, bool plus)
+{
+    const __m128i percent = _mm_set1_epi8('%');
+    const __m128i other = _mm_set1_epi8(plus ? '+' : '%');
+    for (; e - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, percent), _mm_cmpeq_epi8(v, other)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findUriSpecial_scalar(p, e, plus);
+}
+
+const char* findUriSpecial_avx2(const char* p, const char* e, bool plus)
+    __attribute__((__target__("avx2"), noinline));
+
+const char* findUriSpecial_avx2(const char* p, const char* e, bool plus)
+{
+    const __m256i percent = _mm256_set1_epi8('%');
+    const __m256i other = _mm256_set1_epi8(plus ? '+' : '%');
+    for (; e - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, percent),
+                            _mm256_cmpeq_epi8(v, other))));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return findUriSpecial_sse2(p, e, plus);
+}
+
+inline const char* findUriSpecial(const char* p, const char* e, bool plus)
+{
+    static auto const findUriSpecial_fn =
+        CpuId().avx2() && CpuId().osSupportsAvx()
+            ? findUriSpecial_avx2 : findUriSpecial_sse2;
+    return findUriSpecial_fn(p, e, plus);
+}
+
+// Decodes runs of five "%XX" at a time to *out, as long as they are well
+// formed, and returns where it stopped.  The hex digits are gathered with
+// one shuffle, converted to nibbles and paired up with one multiply-add.
+// 16 bytes are stored at a time, so *out must have room for as many
+// characters as [p, e) holds.
+const char* decodePercents_ssse3(const char* p, const char* e, char** out)
+    __attribute__((__target__("ssse3"), noinline));
+
+const char* decodePercents_ssse3(const char* p, const char* e, char** out)
+{
+    const __m128i percent = _mm_set1_epi8('%');
+    const __m128i gather = _mm_setr_epi8(
+        1, 2, 4, 5, 7, 8, 10, 11, 13, 14, -1, -1, -1, -1, -1, -1);
+    for (; e - p >= 16; p += 15) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        if ((_mm_movemask_epi8(_mm_cmpeq_epi8(v, percent)) & 0x1249) != 0x1249) {
+            break;
+        }
+        __m128i hex = _mm_shuffle_epi8(v, gather);
+        // Digits are unchanged by the case bit, but it must not turn
+        // control characters into digits
+        __m128i lower = _mm_or_si128(hex, _mm_set1_epi8(0x20));
+        __m128i letter = inRange_sse2(lower, 'a', 'f');
+        __m128i valid = _mm_or_si128(inRange_sse2(hex, '0', '9'), letter);
+        if ((_mm_movemask_epi8(valid) & 0x3FF) != 0x3FF) {
+            break;
+        }
+        __m128i nibbles = _mm_sub_epi8(
+            _mm_sub_epi8(lower, _mm_set1_epi8('0')),
+            _mm_and_si128(letter, _mm_set1_epi8('a' - '0' - 10)));
+        __m128i pairs = _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(*out),
+                         _mm_packus_epi16(pairs, pairs));
+        *out += 5;
+    }
+    return p;
+}
+
+const char* decodePercents_none(const char* p, const char* , char** )
+{
+    return p;
+}
+
+inline const char* decodePercents(const char* p, const char* e, char** out)
+{
+    static auto const decodePercents_fn =
+        CpuId().ssse3() ? decodePercents_ssse3 : decodePercents_none;
+    return decodePercents_fn(p, e, out);
+}
+
+#else
+
+inline const char* skipUriSafe(const char* p, const char* e,
+                               unsigned char minEncode)
+{
+    return skipUriSafe_scalar(p, e, minEncode);
+}
+
+inline const char* findUriSpecial(const char* p, const char* e, bool plus)
+{
+    return findUriSpecial_scalar(p, e, plus);
+}
+
+inline const char* decodePercents(const char* p, const char* , char** )
+{
+    return p;
+}
+
+#endif // FOLLY_HAVE_EMMINTRIN_H
+
+}  // namespace
+
 void uriEscape(StringPiece str, std::string& out, UriEscapeMode mode) 
 {
     static const char hexValues[] = "0123456789abcdef";
-    char esc[3];
-    esc[0] = '%';
-    // Preallocate assuming that 25% of the input string will be escaped
-    out.reserve(out.size() + str.size() + 3 * (str.size() / 4));
-    auto p = str.begin();
-    auto last = p;  // last regular character
-    // We advance over runs of passthrough characters and copy them in one go;
-    // this is faster than calling push_back repeatedly.
+    // Room for the worst case, every character escaped; the output is
+    // written in place and the string cut back to it at the end
+    const size_t oldSize = out.size();
+    out.resize(oldSize + 3 * str.size());
+    char* o = &out[oldSize];
+    const char* p = str.begin();
+    const char* end = str.end();
+    // We find runs of passthrough characters 16 or 32 at a time and copy
+    // them in one go.
     unsigned char minEncode = static_cast<unsigned char>(mode);
-    while (p != str.end()) {
-        char c = *p;
-        unsigned char v = static_cast<unsigned char>(c);
-        unsigned char discriminator = detail::uriEscapeTable[v];
-        if (LIKELY(discriminator <= minEncode)) {
-            ++p;
+    while (p != end) {
+        const char* run = p;
+        p = skipUriSafe(p, end, minEncode);
+        memcpy(o, run, p - run);
+        o += p - run;
+        if (p == end) {
+            break;
         }
-        else if (mode == UriEscapeMode::QUERY && discriminator == 3) {
-            out.append(&*last, p - last);
-            out.push_back('+');
-            ++p;
-            last = p;
+        unsigned char v = static_cast<unsigned char>(*p);
+        if (mode == UriEscapeMode::QUERY && detail::uriEscapeTable[v] == 3) {
+            *o++ = '+';
         }
         else {
-            out.append(&*last, p - last);
-            esc[1] = hexValues[v >> 4];
-            esc[2] = hexValues[v & 0x0f];
-            out.append(esc, 3);
-            ++p;
-            last = p;
+            o[0] = '%';
+            o[1] = hexValues[v >> 4];
+            o[2] = hexValues[v & 0x0f];
+            o += 3;
         }
+        ++p;
     }
-    out.append(&*last, p - last);
+    out.resize(o - &out[0]);
 }
 
 void uriUnescape(StringPiece str, std::string& out, UriEscapeMode mode) 
 {
-    out.reserve(out.size() + str.size());
-    auto p = str.begin();
-    auto last = p;
-    // We advance over runs of passthrough characters and copy them in one go;
-    // this is faster than calling push_back repeatedly.
-    while (p != str.end()) {
-        char c = *p;
-        switch (c) {
-        case '%':
-            {
-                if (UNLIKELY(std::distance(p, str.end()) < 3)) {
-                    throw std::invalid_argument("incomplete percent encode sequence");
-                }
-                auto h1 = detail::hexTable[static_cast<unsigned char>(p[1])];
-                auto h2 = detail::hexTable[static_cast<unsigned char>(p[2])];
-                if (UNLIKELY(h1 == 16 || h2 == 16)) {
-                    throw std::invalid_argument("invalid percent encode sequence");
-                }
-                out.append(&*last, p - last);
-                out.push_back((h1 << 4) | h2);
-                p += 3;
-                last = p;
-                break;
-            }
-        case '+':
-            if (mode == UriEscapeMode::QUERY) {
-                out.append(&*last, p - last);
-                out.push_back(' ');
-                ++p;
-                last = p;
-                break;
-            }
-            // else fallthrough
-        default:
-            ++p;
+    // The output is never longer than the input; it is written in place and
+    // the string cut back to it at the end, or before throwing
+    const size_t oldSize = out.size();
+    out.resize(oldSize + str.size());
+    char* o = &out[oldSize];
+    const char* p = str.begin();
+    const char* end = str.end();
+    const bool query = mode == UriEscapeMode::QUERY;
+    // We find the next '%' (or '+' in QUERY mode) 16 or 32 characters at a
+    // time and copy the passthrough characters before it in one go.
+    while (p != end) {
+        const char* run = p;
+        p = findUriSpecial(p, end, query);
+        memcpy(o, run, p - run);
+        o += p - run;
+        if (p == end) {
             break;
         }
+        if (*p == '+') {
+            *o++ = ' ';
+            ++p;
+            continue;
+        }
+        if (UNLIKELY(end - p < 3)) {
+            out.resize(o - &out[0]);
+            throw std::invalid_argument("incomplete percent encode sequence");
+        }
+        auto h1 = detail::hexTable[static_cast<unsigned char>(p[1])];
+        auto h2 = detail::hexTable[static_cast<unsigned char>(p[2])];
+        if (UNLIKELY(h1 == 16 || h2 == 16)) {
+            out.resize(o - &out[0]);
+            throw std::invalid_argument("invalid percent encode sequence");
+        }
+        *o++ = (h1 << 4) | h2;
+        p += 3;
+        // Encoded UTF-8 and binary data come in runs
+        if (end - p >= 16 && *p == '%') {
+            p = decodePercents(p, end, &o);
+        }
     }
-    out.append(&*last, p - last);
+    out.resize(o - &out[0]);
 }
 
 void backslashify(const std::string& input, std::string& output, bool hex_style)
@@ -487,47 +810,246 @@ void humanify(const std::string& input, std::string& output)
     }
 }
 
-bool hexlify(const std::string& input, std::string& output, bool append)
+namespace {
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// Writes 2 * (e - p) hex digits to out
+inline void hexlify_scalar(const char* p, const char* e, char* out)
+{
+    for (; p != e; ++p) {
+        unsigned char v = static_cast<unsigned char>(*p);
+        *out++ = kHexDigits[v >> 4];
+        *out++ = kHexDigits[v & 0xf];
+    }
+}
+
+// Writes (e - p) / 2 bytes to out; false if [p, e) has anything but hex
+// digits.  (e - p) is even.
+inline bool unhexlify_scalar(const char* p, const char* e, char* out)
+{
+    for (; p != e; p += 2) {
+        unsigned char high = detail::hexTable[static_cast<unsigned char>(p[0])];
+        unsigned char low = detail::hexTable[static_cast<unsigned char>(p[1])];
+        if ((high | low) >= 16) {
+            return false;
+        }
+        *out++ = (high << 4) | low;
+    }
+    return true;
+}
+
+#if FOLLY_HAVE_EMMINTRIN_H
+
+// The nibbles of each byte are looked up in kHexDigits with a shuffle and
+// interleaved, high nibble first.
+void hexlify_ssse3(const char* p, const char* e, char* out)
+    __attribute__((__target__("ssse3"), noinline));
+
+void hexlify_ssse3(const char* p, const char* e, char* out)
+{
+    const __m128i digits =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(kHexDigits));
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    for (; e - p >= 16; p += 16, out += 32) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i high = _mm_shuffle_epi8(
+            digits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(v, nibble));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                         _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16),
+                         _mm_unpackhi_epi8(high, low));
+    }
+    hexlify_scalar(p, e, out);
+}
+
+void hexlify_avx2(const char* p, const char* e, char* out)
+    __attribute__((__target__("avx2"), noinline));
+
+void hexlify_avx2(const char* p, const char* e, char* out)
+{
+    const __m256i digits = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(kHexDigits)));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    for (; e - p >= 32; p += 32, out += 64) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i high = _mm256_shuffle_epi8(
+            digits, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(v, nibble));
+        // Interleaving works within 128-bit lanes; put the lanes in order
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                            _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32),
+                            _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    // The tail is done without AVX; leave no upper state behind for it, as
+    // GCC doesn't when it turns the call into a jump
+    _mm256_zeroupper();
+    hexlify_ssse3(p, e, out);
+}
+
+// Each character is checked to be a digit, or a letter once the case bit
+// is set, turned into its nibble, and pairs of nibbles are combined with
+// one multiply-add.
+inline __m128i unhexNibbles_ssse3(__m128i v, int* invalid)
+    __attribute__((__target__("ssse3")));
+
+inline __m128i unhexNibbles_ssse3(__m128i v, int* invalid)
+{
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_cmpgt_epi8(_mm_set1_epi8(-128 + 10),
+        _mm_add_epi8(v, _mm_set1_epi8(0x80 - '0')));
+    __m128i letter = _mm_cmpgt_epi8(_mm_set1_epi8(-128 + 6),
+        _mm_add_epi8(lower, _mm_set1_epi8(0x80 - 'a')));
+    *invalid |= ~_mm_movemask_epi8(_mm_or_si128(digit, letter)) & 0xFFFF;
+    __m128i nibbles = _mm_sub_epi8(
+        _mm_sub_epi8(lower, _mm_set1_epi8('0')),
+        _mm_and_si128(letter, _mm_set1_epi8('a' - '0' - 10)));
+    return _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110));
+}
+
+bool unhexlify_ssse3(const char* p, const char* e, char* out)
+    __attribute__((__target__("ssse3"), noinline));
+
+bool unhexlify_ssse3(const char* p, const char* e, char* out)
+{
+    for (; e - p >= 32; p += 32, out += 16) {
+        int invalid = 0;
+        __m128i first = unhexNibbles_ssse3(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), &invalid);
+        __m128i second = unhexNibbles_ssse3(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)),
+            &invalid);
+        if (invalid != 0) {
+            return false;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                         _mm_packus_epi16(first, second));
+    }
+    return unhexlify_scalar(p, e, out);
+}
+
+inline __m256i unhexNibbles_avx2(__m256i v, uint32_t* invalid)
+    __attribute__((__target__("avx2")));
+
+inline __m256i unhexNibbles_avx2(__m256i v, uint32_t* invalid)
+{
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i digit = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 10),
+        _mm256_add_epi8(v, _mm256_set1_epi8(0x80 - '0')));
+    __m256i letter = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 6),
+        _mm256_add_epi8(lower, _mm256_set1_epi8(0x80 - 'a')));
+    *invalid |= ~static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_or_si256(digit, letter)));
+    __m256i nibbles = _mm256_sub_epi8(
+        _mm256_sub_epi8(lower, _mm256_set1_epi8('0')),
+        _mm256_and_si256(letter, _mm256_set1_epi8('a' - '0' - 10)));
+    return _mm256_maddubs_epi16(nibbles, _mm256_set1_epi16(0x0110));
+}
+
+bool unhexlify_avx2(const char* p, const char* e, char* out)
+    __attribute__((__target__("avx2"), noinline));
+
+bool unhexlify_avx2(const char* p, const char* e, char* out)
+{
+    for (; e - p >= 64; p += 64, out += 32) {
+        uint32_t invalid = 0;
+        __m256i first = unhexNibbles_avx2(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)),
+            &invalid);
+        __m256i second = unhexNibbles_avx2(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)),
+            &invalid);
+        if (invalid != 0) {
+            return false;
+        }
+        // Packing works within 128-bit lanes; put the quarters in order
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+            _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second),
+                                     0xD8));
+    }
+    _mm256_zeroupper();
+    return unhexlify_ssse3(p, e, out);
+}
+
+inline void hexlifyTo(const char* p, const char* e, char* out)
+{
+    static auto const hexlify_fn =
+        CpuId().avx2() && CpuId().osSupportsAvx() ? hexlify_avx2 :
+        CpuId().ssse3() ? hexlify_ssse3 :
+        hexlify_scalar;
+    hexlify_fn(p, e, out);
+}
+
+inline bool unhexlifyTo(const char* p, const char* e, char* out)
+{
+    static auto const unhexlify_fn =
+        CpuId().avx2() && CpuId().osSupportsAvx() ? unhexlify_avx2 :
+        CpuId().ssse3() ? unhexlify_ssse3 :
+        unhexlify_scalar;
+    return unhexlify_fn(p, e, out);
+}
+
+#else
+
+inline void hexlifyTo(const char* p, const char* e, char* out)
+{
+    hexlify_scalar(p, e, out);
+}
+
+inline bool unhexlifyTo(const char* p, const char* e, char* out)
+{
+    return unhexlify_scalar(p, e, out);
+}
+
+#endif // FOLLY_HAVE_EMMINTRIN_H
+
+}  // namespace
+
+bool hexlify(StringPiece input, std::string& output, bool append)
 {
     if (!append)
         output.clear();
-    static char hexValues[] = "0123456789abcdef";
     auto j = output.size();
     output.resize(2 * input.size() + output.size());
-    for (size_t i = 0; i < input.size(); ++i) {
-        int ch = input[i];
-        output[j++] = hexValues[(ch >> 4) & 0xf];
-        output[j++] = hexValues[ch & 0xf];
+    hexlifyTo(input.begin(), input.end(), &output[0] + j);
+    return true;
+}
+
+bool hexlify(StringPiece input, MutableStringPiece* output)
+{
+    if (output->size() / 2 < input.size()) {
+        return false;
     }
+    hexlifyTo(input.begin(), input.end(), output->begin());
+    output->advance(2 * input.size());
     return true;
 }
 
-bool unhexlify(const std::string& input, std::string& output)
+bool unhexlify(StringPiece input, std::string& output)
 {
     if (input.size() % 2 != 0) {
         return false;
     }
     output.resize(input.size() / 2);
-    int j = 0;
-    auto unhex = [](char c) -> int {
-        return c >= '0' && c <= '9' ? c - '0' :
-            c >= 'A' && c <= 'F' ? c - 'A' + 10 :
-            c >= 'a' && c <= 'f' ? c - 'a' + 10 :
-            -1;
-    };
+    return unhexlifyTo(input.begin(), input.end(), &output[0]);
+}
 
-    for (size_t i = 0; i < input.size(); i += 2) {
-        int highBits = unhex(input[i]);
-        int lowBits = unhex(input[i + 1]);
-        if (highBits < 0 || lowBits < 0) {
-            return false;
-        }
-        output[j++] = (highBits << 4) + lowBits;
+bool unhexlify(StringPiece input, MutableStringPiece* output)
+{
+    if (input.size() % 2 != 0 || output->size() < input.size() / 2) {
+        return false;
+    }
+    if (!unhexlifyTo(input.begin(), input.end(), output->begin())) {
+        return false;
     }
+    output->advance(input.size() / 2);
     return true;
 }
 
-
 namespace {
 
 struct PrettySuffix {
@@ -731,6 +1253,13 @@ loop:
     return sp;
 }
 
+StringPiece skipWhitespace(StringPiece sp, const ByteSet& whitespace)
+{
+    const size_t i = qfind_first_not_of(sp, whitespace);
+    return i == StringPiece::npos ? StringPiece(sp.end(), sp.end())
+                                  : sp.subpiece(i);
+}
+
 namespace {
 
 inline void toLowerAscii8(char& c) 
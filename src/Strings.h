@@ -77,6 +77,11 @@ std::string& stringVAppendf(std::string* out, const char* format, va_list ap);
  * Split also takes a flag (ignoreEmpty) that indicates whether adjacent
  * delimiters should be treated as one single separator (ignoring empty tokens)
  * or not (generating empty tokens).
+ *
+ * The delimiter may also be a ByteSet, to split on any one of its bytes:
+ *
+ *   static constexpr ByteSet kSeparators(",; ");
+ *   split(kSeparators, "a,b; c", v, true);    // "a", "b", "c"
  */
 
 template<class Delim, class String, class OutputType>
@@ -367,13 +372,29 @@ inline std::string humanify(const std::string& input)
  * If append_output is true, append data to the output rather than
  * replace it.
  */
-bool hexlify(const std::string& input, std::string& output, bool append=false);
+bool hexlify(StringPiece input, std::string& output, bool append=false);
+
+/**
+ * As above, but writes the 2 * input.size() digits at the start of a
+ * caller-provided buffer, such as a char array on the stack for a digest,
+ * and advances *output past them.  Returns false, writing nothing, if they
+ * don't fit.
+ */
+bool hexlify(StringPiece input, MutableStringPiece* output);
 
 /**
  * Same functionality as Python's binascii.unhexlify.  Returns true
  * on successful conversion.
  */
-bool unhexlify(const std::string& input, std::string& output);
+bool unhexlify(StringPiece input, std::string& output);
+
+/**
+ * As above, but writes the input.size() / 2 bytes at the start of a
+ * caller-provided buffer and advances *output past them.  Returns false if
+ * the input isn't valid or the bytes don't fit; *output is then left where
+ * it was, though the bytes it covers may have been written.
+ */
+bool unhexlify(StringPiece input, MutableStringPiece* output);
 
 /*
  * A pretty-printer for numbers that appends suffixes of units of the
@@ -446,6 +467,12 @@ double prettyToDouble(StringPiece prettyString, const PrettyType type);
  */
 StringPiece skipWhitespace(StringPiece sp);
 
+/**
+ * Returns a subpiece with all bytes of whitespace removed from the front
+ * of @sp, e.g. skipWhitespace(sp, ByteSet(" \t\v")).
+ */
+StringPiece skipWhitespace(StringPiece sp, const ByteSet& whitespace);
+
 /**
  * Fast, in-place lowercasing of ASCII alphabetic characters in strings.
  * Leaves all other characters unchanged, including those with the 0x80
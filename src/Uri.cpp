@@ -16,17 +16,11 @@
 
 #include "Uri.h"
 #include <ctype.h>
-#include <regex>
+#include <string.h>
 #include "Conv.h"
 
 namespace {
 
-std::string submatch(const std::cmatch& m, size_t idx) 
-{
-    auto& sub = m[idx];
-    return std::string(sub.first, sub.second);
-}
-
 void toLower(std::string& s) 
 {
     for (auto& c : s)
@@ -35,65 +29,436 @@ void toLower(std::string& s)
     }
 }
 
-}  // namespace
+// Character classes used by the URI scanner, one bit per class.
+enum UriCharClass : uint8_t
+{
+    kSchemeFirst    = 0x01,     // [a-zA-Z]
+    kSchemeRest     = 0x02,     // [a-zA-Z0-9+.-]
+    kHierEnd        = 0x04,     // '?' or '#', ends "authority and path"
+    kQueryEnd       = 0x08,     // '#', ends query
+    kLineBreak      = 0x10,     // '\r' or '\n', can't appear in fragment
+    kDigit          = 0x20,     // [0-9]
+    kPathBegin      = 0x40,     // '/', ends authority
+};
 
-Uri::Uri(StringPiece str) : port_(0) 
+// Map from character code to its UriCharClass bits.
+const uint8_t kUriCharTable[] =
 {
-    static const std::regex uriRegex(
-        "([a-zA-Z][a-zA-Z0-9+.-]*):"  // scheme:
-        "([^?#]*)"                    // authority and path
-        "(?:\\?([^#]*))?"             // ?query
-        "(?:#(.*))?");                // #fragment
-    static const std::regex authorityAndPathRegex("//([^/]*)(/.*)?");
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02, 0x02, 0x40, 
+  0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 
+  0x00, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+};
 
-    std::cmatch match;
-    if (UNLIKELY(!std::regex_match(str.begin(), str.end(), match, uriRegex))) {
-        throw std::invalid_argument(to<std::string>("invalid URI ", str));
+inline bool isUriChar(char c, uint8_t mask)
+{
+    return (kUriCharTable[static_cast<uint8_t>(c)] & mask) != 0;
+}
+
+// Returns the first position in [p, e) whose class intersects mask, or e.
+inline const char* scanUntil(const char* p, const char* e, uint8_t mask)
+{
+    while (p != e && !isUriChar(*p, mask))
+    {
+        ++p;
     }
+    return p;
+}
 
-    scheme_ = submatch(match, 1);
-    toLower(scheme_);
+// Returns the first position in [p, e) whose class does not intersect mask,
+// or e.
+inline const char* scanWhile(const char* p, const char* e, uint8_t mask)
+{
+    while (p != e && isUriChar(*p, mask))
+    {
+        ++p;
+    }
+    return p;
+}
+
+// host [ ':' port ], where host is either an IP-literal "[...]" or a run of
+// characters other than '[' and ':', and port is zero or more digits.
+bool parseHostAndPort(StringPiece s, StringPiece* host, StringPiece* port)
+{
+    const char* p = s.begin();
+    const char* e = s.end();
+    const char* hostEnd;
+    if (p != e && *p == '[')
+    {
+        hostEnd = static_cast<const char*>(memchr(p, ']', e - p));
+        if (hostEnd == nullptr)
+        {
+            return false;
+        }
+        ++hostEnd;
+    }
+    else
+    {
+        hostEnd = p;
+        while (hostEnd != e && *hostEnd != '[' && *hostEnd != ':')
+        {
+            ++hostEnd;
+        }
+    }
+    if (hostEnd != e)
+    {
+        if (*hostEnd != ':' || scanWhile(hostEnd + 1, e, kDigit) != e)
+        {
+            return false;
+        }
+        port->assign(hostEnd + 1, e);
+    }
+    else
+    {
+        port->clear();
+    }
+    host->assign(p, hostEnd);
+    return true;
+}
+
+// [ username [ ':' password ] '@' ] host [ ':' port ]
+//
+// The userinfo part ends at the first '@'. If what follows is not a valid
+// host and port, the whole authority is tried as host and port instead, so
+// an IP-literal such as "[a@b:c]" is still accepted.
+bool parseAuthority(StringPiece authority,
+                    StringPiece* username,
+                    StringPiece* password,
+                    StringPiece* host,
+                    StringPiece* port)
+{
+    const char* p = authority.begin();
+    const char* e = authority.end();
+    auto at = static_cast<const char*>(memchr(p, '@', e - p));
+    if (at != nullptr && parseHostAndPort(StringPiece(at + 1, e), host, port))
+    {
+        auto colon = static_cast<const char*>(memchr(p, ':', at - p));
+        if (colon != nullptr)
+        {
+            username->assign(p, colon);
+            password->assign(colon + 1, at);
+        }
+        else
+        {
+            username->assign(p, at);
+            password->clear();
+        }
+        return true;
+    }
+    username->clear();
+    password->clear();
+    return parseHostAndPort(authority, host, port);
+}
+
+// The delimiters findDelimiter() looks for, each the bytes of a class mask
+FOLLY_CONSTEXPR ByteSet kAuthorityDelimiters("/?#");   // kHierEnd | kPathBegin
+FOLLY_CONSTEXPR ByteSet kPathDelimiters("?#");         // kHierEnd
+FOLLY_CONSTEXPR ByteSet kLineBreaks("\r\n");           // kLineBreak
+
+// Returns the first position in [p, e) holding one of needles (whose classes
+// are given by mask), or e. Long spans go through the SIMD search of the
+// precompiled set.
+inline const char* findDelimiter(const char* p, const char* e,
+                                 const ByteSet& needles, uint8_t mask)
+{
+    if (e - p < 16)
+    {
+        return scanUntil(p, e, mask);
+    }
+    size_t i = qfind_first_of(StringPiece(p, e), needles);
+    return i == StringPiece::npos ? e : p + i;
+}
+
+enum UriParseResult
+{
+    kUriOk,
+    kUriInvalid,            // no scheme, or line break in fragment
+    kUriInvalidAuthority,
+};
+
+struct UriParts
+{
+    StringPiece scheme;
+    StringPiece authority;
+    StringPiece username;
+    StringPiece password;
+    StringPiece host;
+    StringPiece port;       // digits only, not range-checked
+    StringPiece path;
+    StringPiece query;
+    StringPiece fragment;
+};
+
+// Single left-to-right pass, equivalent to matching
+//
+//   ([a-zA-Z][a-zA-Z0-9+.-]*):([^?#]*)(?:\?([^#]*))?(?:#(.*))?
+//
+// and then splitting the second group with //([^/]*)(/.*)?
+UriParseResult parseUriParts(StringPiece str, UriParts* parts)
+{
+    const char* p = str.begin();
+    const char* e = str.end();
 
-    StringPiece authorityAndPath(match[2].first, match[2].second);
-    std::cmatch authorityAndPathMatch;
-    if (!std::regex_match(authorityAndPath.begin(),
-        authorityAndPath.end(),
-        authorityAndPathMatch,
-        authorityAndPathRegex)) {
+    // scheme ':'
+    if (UNLIKELY(p == e || !isUriChar(*p, kSchemeFirst)))
+    {
+        return kUriInvalid;
+    }
+    const char* schemeEnd = scanWhile(p + 1, e, kSchemeRest);
+    if (UNLIKELY(schemeEnd == e || *schemeEnd != ':'))
+    {
+        return kUriInvalid;
+    }
+    parts->scheme.reset(p, schemeEnd - p);
+
+    // authority and path, then '?' query, then '#' fragment
+    const char* hierBegin = schemeEnd + 1;
+    const char* authorityEnd = nullptr;
+    const char* hierEnd;
+    if (e - hierBegin >= 2 && hierBegin[0] == '/' && hierBegin[1] == '/')
+    {
+        authorityEnd = findDelimiter(hierBegin + 2, e, kAuthorityDelimiters,
+                                     kHierEnd | kPathBegin);
+        hierEnd = authorityEnd;
+        if (authorityEnd != e && *authorityEnd == '/')
+        {
+            hierEnd = findDelimiter(authorityEnd, e, kPathDelimiters, kHierEnd);
+            if (findDelimiter(authorityEnd, hierEnd, kLineBreaks, kLineBreak)
+                != hierEnd)
+            {
+                // Path can't hold a line break, so this is all path
+                authorityEnd = nullptr;
+            }
+        }
+    }
+    else
+    {
+        hierEnd = findDelimiter(hierBegin, e, kPathDelimiters, kHierEnd);
+    }
+
+    const char* queryBegin = hierEnd;
+    const char* queryEnd = hierEnd;
+    if (hierEnd != e && *hierEnd == '?')
+    {
+        ++queryBegin;
+        queryEnd = static_cast<const char*>(
+            memchr(queryBegin, '#', e - queryBegin));
+        if (queryEnd == nullptr)
+        {
+            queryEnd = e;
+        }
+    }
+    const char* fragmentBegin = queryEnd;
+    if (queryEnd != e)
+    {
+        ++fragmentBegin;
+        if (UNLIKELY(findDelimiter(fragmentBegin, e, kLineBreaks, kLineBreak) != e))
+        {
+            return kUriInvalid;
+        }
+    }
+
+    if (authorityEnd == nullptr)
+    {
         // Does not start with //, doesn't have authority
-        path_ = authorityAndPath.str();
+        parts->authority.clear();
+        parts->username.clear();
+        parts->password.clear();
+        parts->host.clear();
+        parts->port.clear();
+        parts->path.reset(hierBegin, hierEnd - hierBegin);
     }
-    else {
-        static const std::regex authorityRegex(
-            "(?:([^@:]*)(?::([^@]*))?@)?"  // username, password
-            "(\\[[^\\]]*\\]|[^\\[:]*)"     // host (IP-literal (e.g. '['+IPv6+']',
-            // dotted-IPv4, or named host)
-            "(?::(\\d*))?");               // port
+    else
+    {
+        parts->authority.reset(hierBegin + 2, authorityEnd - (hierBegin + 2));
+        if (!parseAuthority(parts->authority, &parts->username,
+            &parts->password, &parts->host, &parts->port))
+        {
+            return kUriInvalidAuthority;
+        }
+        parts->path.reset(authorityEnd, hierEnd - authorityEnd);
+    }
+
+    parts->query.reset(queryBegin, queryEnd - queryBegin);
+    parts->fragment.reset(fragmentBegin, e - fragmentBegin);
+    return kUriOk;
+}
 
-        auto authority = authorityAndPathMatch[1];
-        std::cmatch authorityMatch;
-        if (!std::regex_match(authority.first,
-            authority.second,
-            authorityMatch,
-            authorityRegex)) {
-            throw std::invalid_argument(
-                to<std::string>("invalid URI authority ",
-                StringPiece(authority.first, authority.second)));
+// Same result as to<uint16_t>(digits), without throwing.
+bool parsePort(StringPiece digits, uint16_t* port)
+{
+    uint32_t value = 0;
+    for (char c : digits)
+    {
+        value = value * 10 + (c - '0');
+        if (value > std::numeric_limits<uint16_t>::max())
+        {
+            return false;
         }
+    }
+    *port = static_cast<uint16_t>(value);
+    return true;
+}
+
+}  // namespace
+
+UriView::UriView(StringPiece str) : port_(0)
+{
+    UriParts parts;
+    switch (parseUriParts(str, &parts))
+    {
+    case kUriOk:
+        break;
+    case kUriInvalidAuthority:
+        throw std::invalid_argument(
+            to<std::string>("invalid URI authority ", parts.authority));
+    default:
+        throw std::invalid_argument(to<std::string>("invalid URI ", str));
+    }
+
+    if (!parts.port.empty())
+    {
+        port_ = to<uint16_t>(parts.port);
+    }
+    scheme_ = parts.scheme;
+    username_ = parts.username;
+    password_ = parts.password;
+    authority_ = parts.authority;
+    host_ = parts.host;
+    path_ = parts.path;
+    query_ = parts.query;
+    fragment_ = parts.fragment;
+}
 
-        StringPiece port(authorityMatch[4].first, authorityMatch[4].second);
-        if (!port.empty()) {
-            port_ = to<uint16_t>(port);
+void UriBatch::clear()
+{
+    valid.clear();
+    scheme.clear();
+    username.clear();
+    password.clear();
+    host.clear();
+    port.clear();
+    path.clear();
+    query.clear();
+    fragment.clear();
+}
+
+void parseUris(Range<const StringPiece*> uris, UriBatch* batch)
+{
+    const size_t n = uris.size();
+    batch->valid.resize(n);
+    batch->scheme.resize(n);
+    batch->username.resize(n);
+    batch->password.resize(n);
+    batch->host.resize(n);
+    batch->port.resize(n);
+    batch->path.resize(n);
+    batch->query.resize(n);
+    batch->fragment.resize(n);
+
+    UriParts parts;
+    for (size_t i = 0; i < n; ++i)
+    {
+        StringPiece uri = uris[i];
+        uint16_t port = 0;
+        bool ok = uri.size() <= std::numeric_limits<uint32_t>::max() &&
+            parseUriParts(uri, &parts) == kUriOk &&
+            parsePort(parts.port, &port);
+        if (UNLIKELY(!ok))
+        {
+            parts = UriParts();
         }
 
-        username_ = submatch(authorityMatch, 1);
-        password_ = submatch(authorityMatch, 2);
-        host_ = submatch(authorityMatch, 3);
-        path_ = submatch(authorityAndPathMatch, 2);
+        // Empty components may not point into uri at all
+        const char* base = uri.data();
+        auto span = [base](StringPiece s) {
+            UriBatch::Span r = { 0, 0 };
+            if (!s.empty()) {
+                r.begin = static_cast<uint32_t>(s.begin() - base);
+                r.end = static_cast<uint32_t>(s.end() - base);
+            }
+            return r;
+        };
+        batch->valid[i] = ok;
+        batch->scheme[i] = span(parts.scheme);
+        batch->username[i] = span(parts.username);
+        batch->password[i] = span(parts.password);
+        batch->host[i] = span(parts.host);
+        batch->port[i] = port;
+        batch->path[i] = span(parts.path);
+        batch->query[i] = span(parts.query);
+        batch->fragment[i] = span(parts.fragment);
     }
+}
 
-    query_ = submatch(match, 3);
-    fragment_ = submatch(match, 4);
+StringPiece UriView::hostname() const
+{
+    if (!host_.empty() && host_.front() == '[') {
+        // If it starts with '[', then it should end with ']', this is ensured by
+        // the parser
+        return host_.subpiece(1, host_.size() - 2);
+    }
+    return host_;
+}
+
+void UriView::QueryParamIterator::advance()
+{
+    while (!rest_.empty()) {
+        StringPiece param = rest_;
+        size_t amp = rest_.find('&');
+        if (amp == StringPiece::npos) {
+            rest_.advance(rest_.size());
+        }
+        else {
+            param.subtract(param.size() - amp);
+            rest_.advance(amp + 1);
+        }
+
+        size_t eq = param.find('=');
+        if (eq == StringPiece::npos) {
+            if (param.empty()) {
+                continue;
+            }
+            param_.first = param;
+            param_.second.reset(param.end(), 0);
+            return;
+        }
+        // Skip parameters without a name, and those with more than one '=' as
+        // we can't tell which one separates name and value.
+        if (eq == 0 || param.find('=', eq + 1) != StringPiece::npos) {
+            continue;
+        }
+        param_.first = param.subpiece(0, eq);
+        param_.second = param.subpiece(eq + 1);
+        return;
+    }
+    atEnd_ = true;
+}
+
+Uri::Uri(StringPiece str)
+{
+    UriView view(str);
+    scheme_ = view.scheme().str();
+    toLower(scheme_);
+    username_ = view.username().str();
+    password_ = view.password().str();
+    host_ = view.host().str();
+    port_ = view.port();
+    path_ = view.path().str();
+    query_ = view.query().str();
+    fragment_ = view.fragment().str();
 }
 
 std::string Uri::authority() const
@@ -152,7 +517,7 @@ std::string Uri::hostname() const
 {
     if (host_.size() > 0 && host_[0] == '[') {
         // If it starts with '[', then it should end with ']', this is ensured by
-        // regex
+        // the parser
         return host_.substr(1, host_.size() - 2);
     }
     return host_;
@@ -161,25 +526,8 @@ std::string Uri::hostname() const
 const std::vector<std::pair<std::string, std::string>>& Uri::getQueryParams() 
 {
     if (!query_.empty() && queryParams_.empty()) {
-        // Parse query string
-        static const std::regex queryParamRegex(
-            "(^|&)" /*start of query or start of parameter "&"*/
-            "([^=&]*)=?" /*parameter name and "=" if value is expected*/
-            "([^=&]*)" /*parameter value*/
-            "(?=(&|$))" /*forward reference, next should be end of query or
-                          start of next parameter*/);
-        std::cregex_iterator paramBeginItr(
-            query_.data(), query_.data() + query_.size(), queryParamRegex);
-        std::cregex_iterator paramEndItr;
-        for (auto itr = paramBeginItr; itr != paramEndItr; itr++) {
-            if (itr->length(2) == 0) {
-                // key is empty, ignore it
-                continue;
-            }
-            queryParams_.emplace_back(
-                std::string((*itr)[2].first, (*itr)[2].second), // parameter name
-                std::string((*itr)[3].first, (*itr)[3].second) // parameter value
-                );
+        for (auto& param : UriView::QueryParams(query_)) {
+            queryParams_.emplace_back(param.first.str(), param.second.str());
         }
     }
     return queryParams_;
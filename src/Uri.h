@@ -16,10 +16,165 @@
 
 #pragma once
 
+#include <iterator>
 #include <string>
 #include <vector>
 #include "Range.h"
 
+/**
+ * Non-owning, allocation-free view of a URI.
+ *
+ * UriView accepts exactly the same inputs as Uri (and throws the same
+ * exceptions), but every component is a StringPiece pointing back into the
+ * parsed buffer, which must outlive the view.  Because nothing is copied, the
+ * scheme is returned as written rather than lower-cased.
+ *
+ * Query parameters are produced lazily by queryParams(); no container is
+ * built:
+ *
+ *   UriView u("http://example.com/?a=1&b=2");
+ *   for (auto& kv : u.queryParams()) {
+ *     // kv.first == "a", kv.second == "1", ...
+ *   }
+ */
+class UriView {
+ public:
+  /**
+   * Parse a URI from a string.  Throws std::invalid_argument on parse error,
+   * and std::range_error if the port does not fit in 16 bits.
+   */
+  explicit UriView(StringPiece str);
+
+  StringPiece scheme() const { return scheme_; }
+  StringPiece username() const { return username_; }
+  StringPiece password() const { return password_; }
+
+  /**
+   * Raw authority ("user:pass@host:port"), empty if the URI has none.
+   */
+  StringPiece authority() const { return authority_; }
+
+  /**
+   * Host part of the URI; IPv6 addresses keep their square brackets.
+   */
+  StringPiece host() const { return host_; }
+
+  /**
+   * Host part of the URI without the square brackets of an IPv6 address.
+   */
+  StringPiece hostname() const;
+  uint16_t port() const { return port_; }
+  StringPiece path() const { return path_; }
+  StringPiece query() const { return query_; }
+  StringPiece fragment() const { return fragment_; }
+
+  /**
+   * Forward iterator over the parameters of a query string.  Follows the
+   * same rules as Uri::getQueryParams(): parameters without a name or with
+   * more than one '=' are skipped, and a missing '=' yields an empty value.
+   */
+  class QueryParamIterator
+    : public std::iterator<std::forward_iterator_tag,
+                           const std::pair<StringPiece, StringPiece>> {
+   public:
+    QueryParamIterator() : rest_(), atEnd_(true) {}
+    explicit QueryParamIterator(StringPiece query)
+      : rest_(query), atEnd_(query.empty()) {
+      advance();
+    }
+
+    reference operator*() const { return param_; }
+    pointer operator->() const { return &param_; }
+
+    QueryParamIterator& operator++() {
+      advance();
+      return *this;
+    }
+    QueryParamIterator operator++(int) {
+      QueryParamIterator tmp(*this);
+      advance();
+      return tmp;
+    }
+
+    bool operator==(const QueryParamIterator& other) const {
+      return atEnd_ == other.atEnd_ &&
+        (atEnd_ || rest_.begin() == other.rest_.begin());
+    }
+    bool operator!=(const QueryParamIterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    void advance();
+
+    StringPiece rest_;   // unparsed remainder of the query string
+    bool atEnd_;
+    std::pair<StringPiece, StringPiece> param_;
+  };
+
+  class QueryParams {
+   public:
+    explicit QueryParams(StringPiece query) : query_(query) {}
+    QueryParamIterator begin() const { return QueryParamIterator(query_); }
+    QueryParamIterator end() const { return QueryParamIterator(); }
+   private:
+    StringPiece query_;
+  };
+
+  QueryParams queryParams() const { return QueryParams(query_); }
+
+ private:
+  StringPiece scheme_;
+  StringPiece username_;
+  StringPiece password_;
+  StringPiece authority_;
+  StringPiece host_;
+  uint16_t port_;
+  StringPiece path_;
+  StringPiece query_;
+  StringPiece fragment_;
+};
+
+/**
+ * Struct-of-arrays result of parsing many URIs at once with parseUris().
+ *
+ * Entry i describes the i-th input.  Each component is stored as a byte
+ * offset range into that input, so a whole batch costs a few vectors no
+ * matter how many URIs it holds.
+ */
+struct UriBatch {
+  // [begin, end) byte offsets of a component within its input
+  struct Span {
+    uint32_t begin;
+    uint32_t end;
+
+    StringPiece in(StringPiece input) const {
+      return input.subpiece(begin, end - begin);
+    }
+  };
+
+  size_t size() const { return valid.size(); }
+  void clear();
+
+  std::vector<uint8_t> valid;   // 0 where Uri would throw
+  std::vector<Span> scheme;     // not lower-cased
+  std::vector<Span> username;
+  std::vector<Span> password;
+  std::vector<Span> host;
+  std::vector<uint16_t> port;
+  std::vector<Span> path;
+  std::vector<Span> query;
+  std::vector<Span> fragment;
+};
+
+/**
+ * Parse every URI in uris into batch, replacing its previous contents.
+ *
+ * Never throws on malformed input: an entry that Uri would reject has
+ * valid[i] == 0 and empty spans.  Inputs longer than 4GB are rejected.
+ */
+void parseUris(Range<const StringPiece*> uris, UriBatch* batch);
+
 /**
  * Class representing a URI.
  *
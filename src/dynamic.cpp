@@ -3,7 +3,11 @@
 // See accompanying files LICENSE.
 
 #include "dynamic.h"
+#include <string.h>
 #include <functional>
+#include <new>
+#include "json.h"
+#include "Arena.h"
 
 
 dynamic::TypeError::TypeError(const std::string& expected, dynamic::Type t)
@@ -12,6 +16,8 @@ dynamic::TypeError::TypeError(const std::string& expected, dynamic::Type t)
 {
 }
 
+static_assert(sizeof(dynamic) <= 24, "dynamic nodes should stay small");
+
 struct dynamic::ObjectMaker
 {
     friend struct dynamic;
@@ -20,50 +26,70 @@ struct dynamic::ObjectMaker
 //////////////////////////////////////////////////////////////////////////
 
 dynamic::dynamic(std::nullptr_t)
-    : type_(NULLT)
+    : type_(NULLT), storage_(kOwned), inlineSize_(0), arenaElement_(false)
 {
     u_.nul = nullptr;
 }
 
 dynamic::dynamic(bool value)
-    : type_(BOOL)
+    : type_(BOOL), storage_(kOwned), inlineSize_(0), arenaElement_(false)
 {
     u_.boolean = value;
 }
 
 dynamic::dynamic(int64_t value)
-    : type_(INT64)
+    : type_(INT64), storage_(kOwned), inlineSize_(0), arenaElement_(false)
 {
     u_.integer = value;
 }
 
 dynamic::dynamic(double value)
-    : type_(DOUBLE)
+    : type_(DOUBLE), storage_(kOwned), inlineSize_(0), arenaElement_(false)
 {
     u_.number = value;
 }
 
 dynamic::dynamic(const char* s, size_t count)
-    : type_(STRING)
+    : type_(STRING), storage_(kOwned), inlineSize_(0), arenaElement_(false)
 {
-    assert(s && count > 0);
-    u_.string = new std::string(s, count);
+    assert(s || count == 0);
+    if (count <= kMaxInlineSize)
+    {
+        setInline(s, count);
+    }
+    else
+    {
+        u_.string = new std::string(s, count);
+    }
 }
 
 dynamic::dynamic(std::string&& s)
-    : type_(STRING)
+    : type_(STRING), storage_(kOwned), inlineSize_(0), arenaElement_(false)
 {
-    u_.string = new std::string(std::move(s));
+    if (s.size() <= kMaxInlineSize)
+    {
+        setInline(s.data(), s.size());
+    }
+    else
+    {
+        u_.string = new std::string(std::move(s));
+    }
 }
 
 dynamic::dynamic(std::initializer_list<dynamic> il)
-    : type_(ARRAY)
+    : type_(ARRAY), storage_(kOwned), inlineSize_(0), arenaElement_(false)
 {
     u_.array = new Array(il.begin(), il.end());
 }
 
+dynamic::dynamic(Array&& array)
+    : type_(ARRAY), storage_(kOwned), inlineSize_(0), arenaElement_(false)
+{
+    u_.array = new Array(std::move(array));
+}
+
 dynamic::dynamic(ObjectMaker(*)())
-    : type_(OBJECT)
+    : type_(OBJECT), storage_(kOwned), inlineSize_(0), arenaElement_(false)
 {
     u_.object = new Object;
 }
@@ -73,33 +99,75 @@ dynamic::ObjectMaker dynamic::object()
     return ObjectMaker();
 }
 
+namespace {
+
+FOLLY_NORETURN void throwReadOnly()
+{
+    throw std::logic_error("dynamic: values in an Arena are read-only");
+}
+
+} // anonymous namespace
+
+bool dynamic::needsHeap(const dynamic& o, bool copying)
+{
+    switch (o.type())
+    {
+    case STRING:
+        return o.storage_ == kOwned || (copying && o.storage_ == kArena);
+    case ARRAY:
+    case OBJECT:
+        return o.storage_ == kOwned || copying;
+    default:
+        return false;
+    }
+}
+
 dynamic& dynamic::operator=(const dynamic& o)
 {
     if (&o != this)
     {
+        if (arenaElement_ && needsHeap(o, true))
+        {
+            throwReadOnly();
+        }
         assign(o);
     }
     return *this;
 }
 
-dynamic& dynamic::operator=(dynamic&& o) noexcept
+dynamic& dynamic::operator=(dynamic&& o)
 {
     if (&o != this)
     {
+        if (arenaElement_ && needsHeap(o, false))
+        {
+            throwReadOnly();
+        }
         destroy();
         u_ = o.u_;
         type_ = o.type_;
+        storage_ = o.storage_;
+        inlineSize_ = o.inlineSize_;
         o.type_ = NULLT;
+        o.storage_ = kOwned;
         o.u_.nul = nullptr;
     }
     return *this;
 }
 
-const std::string&  dynamic::getString() const
+StringPiece dynamic::getString() const
 {
     if (isString())
     {
-        return *u_.string;
+        switch (storage_)
+        {
+        case kInline:
+            return StringPiece(u_.chars, inlineSize_);
+        case kArena:
+            return *u_.arenaString;
+        default:
+            return StringPiece(*u_.string);
+        }
     }
     throw TypeError("string", type());
 }
@@ -136,9 +204,9 @@ std::size_t dynamic::size() const
     switch (type())
     {
     case STRING:
-        return u_.string->size();
+        return getString().size();
     case ARRAY:
-        return u_.array->size();
+        return storage_ == kArena ? u_.arenaArray->size : u_.array->size();
     case OBJECT:
         return u_.object->size();
     }
@@ -167,6 +235,10 @@ void dynamic::push_back(const dynamic& o)
 {
     if (isArray())
     {
+        if (storage_ == kArena)
+        {
+            throwReadOnly();
+        }
         u_.array->push_back(o);
     }
     else
@@ -179,6 +251,10 @@ void dynamic::push_back(dynamic&& o)
 {
     if (isArray())
     {
+        if (storage_ == kArena)
+        {
+            throwReadOnly();
+        }
         u_.array->push_back(std::move(o));
     }
     else
@@ -187,11 +263,32 @@ void dynamic::push_back(dynamic&& o)
     }
 }
 
+void dynamic::insert(dynamic key, dynamic value)
+{
+    if (isObject())
+    {
+        if (storage_ == kArena)
+        {
+            throwReadOnly();
+        }
+        (*u_.object)[std::move(key)] = std::move(value);
+    }
+    else
+    {
+        throw TypeError("object", type());
+    }
+}
+
 const dynamic& dynamic::at(size_t index) const
 {
     if (isArray())
     {
-        return u_.array->at(index);
+        if (index >= size())
+        {
+            throw std::out_of_range(to<std::string>(
+                "array index ", index, " out of range"));
+        }
+        return arrayBegin()[index];
     }
     throw TypeError("array", type());
 }
@@ -201,47 +298,61 @@ dynamic& dynamic::at(size_t index)
     return const_cast<dynamic&>(const_cast<dynamic const*>(this)->at(index));
 }
 
-bool dynamic::contains(const std::string& key) const
+bool dynamic::contains(StringPiece key) const
 {
     switch (type())
     {
     case OBJECT:
-        {
-            dynamic d(key);
-            return u_.object->count(d) > 0;
-        }
-        case ARRAY:
-            return false; // cuz Lua encode empty table as array
-        default:
-            throw TypeError("object", type());
+        return u_.object->find(key) != u_.object->end();
+    case ARRAY:
+        return false; // cuz Lua encode empty table as array
+    default:
+        throw TypeError("object", type());
     }
 }
 
-dynamic& dynamic::operator[](const std::string& key)
+const dynamic* dynamic::get_ptr(StringPiece key) const
 {
     if (isObject())
     {
-        dynamic d(key);
-        return u_.object->operator[](d);
+        auto iter = u_.object->find(key);
+        return iter != u_.object->end() ? &iter->second : nullptr;
     }
     throw TypeError("object", type());
 }
 
-const dynamic& dynamic::operator[](const std::string& key) const
+dynamic* dynamic::get_ptr(StringPiece key)
+{
+    return const_cast<dynamic*>(const_cast<dynamic const*>(this)->get_ptr(key));
+}
+
+dynamic& dynamic::operator[](StringPiece key)
 {
     if (isObject())
     {
-        dynamic d(key);
-        auto iter = u_.object->find(d);
-        if (iter != u_.object->end())
+        if (storage_ == kArena)
         {
-            return iter->second;
+            auto iter = u_.object->find(key);
+            if (iter == u_.object->end())
+            {
+                throwReadOnly();
+            }
+            return const_cast<dynamic&>(iter->second);
         }
-        throw std::out_of_range(to<std::string>("couldn't find key ", key));
+        return (*u_.object)[key];
     }
     throw TypeError("object", type());
 }
 
+const dynamic& dynamic::operator[](StringPiece key) const
+{
+    if (auto value = get_ptr(key))
+    {
+        return *value;
+    }
+    throw std::out_of_range(to<std::string>("couldn't find key ", key));
+}
+
 void dynamic::assign(const dynamic& o)
 {
     destroy();
@@ -258,10 +369,20 @@ void dynamic::assign(const dynamic& o)
         u_.number = o.u_.number;
         break;
     case STRING:
-        u_.string = new std::string(*o.u_.string);
+        if (o.storage_ == kInline)
+        {
+            u_ = o.u_;
+            storage_ = kInline;
+            inlineSize_ = o.inlineSize_;
+        }
+        else
+        {
+            StringPiece s = o.getString();
+            u_.string = new std::string(s.data(), s.size());
+        }
         break;
     case ARRAY:
-        u_.array = new Array(*o.u_.array);
+        u_.array = new Array(o.arrayBegin(), o.arrayEnd());
         break;
     case OBJECT:
         u_.object = new Object(*o.u_.object);
@@ -271,6 +392,12 @@ void dynamic::assign(const dynamic& o)
 
 void dynamic::destroy()
 {
+    if (storage_ != kOwned)
+    {
+        storage_ = kOwned;
+        u_.nul = nullptr;
+        return;
+    }
     switch (type())
     {
     case STRING:
@@ -288,9 +415,12 @@ void dynamic::destroy()
 
 std::string dynamic::dump() const
 {
-    std::ostringstream stream;
-    stream << *this;
-    return stream.str();
+    JsonSerializationOpts opts;
+    opts.allowNonStringKeys = true;
+    opts.allowNanInf = true;
+    std::string result;
+    serializeJson(*this, &result, opts);
+    return result;
 }
 
 bool dynamic::operator<(const dynamic& o) const
@@ -312,7 +442,8 @@ bool dynamic::operator<(const dynamic& o) const
     case STRING:
         return getString() < o.getString();
     case ARRAY:
-        return *u_.array < *o.u_.array;
+        return std::lexicographical_compare(arrayBegin(), arrayEnd(),
+            o.arrayBegin(), o.arrayEnd());
     case OBJECT:
         return *u_.object < *o.u_.object;
     }
@@ -332,15 +463,37 @@ const void* dynamic::getAddress() const
     case DOUBLE:
         return &u_.number;
     case STRING:
-        return &u_.string;
+        return storage_ == kInline ? static_cast<const void*>(u_.chars)
+            : &u_.string;
     case ARRAY:
-        return u_.array;
+        return storage_ == kArena ? static_cast<const void*>(u_.arenaArray) : u_.array;
     case OBJECT:
         return u_.object;
     }
     throw TypeError("any", type());
 }
 
+void dynamic::setInline(const char* s, size_t count)
+{
+    storage_ = kInline;
+    inlineSize_ = static_cast<uint8_t>(count);
+    if (count != 0)
+    {
+        memcpy(u_.chars, s, count);
+    }
+}
+
+const dynamic* dynamic::arrayBegin() const
+{
+    return storage_ == kArena ? u_.arenaArray->elements : u_.array->data();
+}
+
+const dynamic* dynamic::arrayEnd() const
+{
+    return storage_ == kArena ? u_.arenaArray->elements + u_.arenaArray->size
+        : u_.array->data() + u_.array->size();
+}
+
 const char* dynamic::typeName(Type t)
 {
     switch (t)
@@ -356,6 +509,560 @@ const char* dynamic::typeName(Type t)
     }
 }
 
+//////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+inline uint64_t mixHash(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline bool keyEquals(const dynamic& key, StringPiece s)
+{
+    return key.isString() && StringPiece(key.getString()) == s;
+}
+
+inline bool keyEquals(const dynamic& key, const dynamic& other)
+{
+    if (key.type() != other.type())
+    {
+        return false;
+    }
+    if (key.isString())
+    {
+        return key.getString() == other.getString();
+    }
+    return !(key < other) && !(other < key);
+}
+
+} // anonymous namespace
+
+uint32_t dynamic::Object::hashKey(StringPiece key)
+{
+    // Eight bytes at a time, then the zero-padded tail
+    const char* p = key.data();
+    size_t n = key.size();
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+    for (; n >= 8; p += 8, n -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ word) * 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, n);
+    return static_cast<uint32_t>(mixHash(h ^ tail));
+}
+
+uint32_t dynamic::Object::hashKey(const dynamic& key)
+{
+    switch (key.type())
+    {
+    case STRING:
+        return hashKey(StringPiece(key.getString()));
+    case INT64:
+        return static_cast<uint32_t>(mixHash(key.getInt() ^ INT64));
+    case DOUBLE:
+        {
+            // 0.0 and -0.0 are the same key to keyEquals()
+            double number = key.getDouble();
+            if (number == 0)
+            {
+                number = 0.0;
+            }
+            uint64_t bits;
+            memcpy(&bits, &number, sizeof(bits));
+            return static_cast<uint32_t>(mixHash(bits ^ DOUBLE));
+        }
+    case BOOL:
+        return static_cast<uint32_t>(mixHash(key.getBool() ^ (BOOL << 1)));
+    default:
+        // Arrays and objects as keys are rare enough to all collide
+        return static_cast<uint32_t>(mixHash(key.type()));
+    }
+}
+
+dynamic::Object::Object()
+    : entries_(nullptr),
+      size_(0),
+      capacity_(0),
+      slots_(nullptr),
+      slotCount_(0),
+      arena_(nullptr)
+{
+}
+
+dynamic::Object::Object(Arena* arena)
+    : entries_(nullptr),
+      size_(0),
+      capacity_(0),
+      slots_(nullptr),
+      slotCount_(0),
+      arena_(arena)
+{
+}
+
+dynamic::Object::Object(const Object& o)
+    : entries_(nullptr),
+      size_(0),
+      capacity_(0),
+      slots_(nullptr),
+      slotCount_(0),
+      arena_(nullptr)
+{
+    reserve(o.size_);
+    for (size_t i = 0; i < o.size_; ++i)
+    {
+        new (&entries_[i]) value_type(o.entries_[i]);
+        ++size_;
+    }
+    if (slotCount_ != 0 && slotCount_ == o.slotCount_)
+    {
+        memcpy(slots_, o.slots_, slotCount_ * sizeof(Slot));
+    }
+    else if (slotCount_ != 0)
+    {
+        rehash(slotCount_);
+    }
+}
+
+dynamic::Object::~Object()
+{
+    if (arena_ == nullptr)
+    {
+        for (size_t i = 0; i < size_; ++i)
+        {
+            entries_[i].~value_type();
+        }
+        deallocate(entries_);
+        deallocate(slots_);
+    }
+}
+
+bool dynamic::Object::operator<(const Object& o) const
+{
+    return std::lexicographical_compare(begin(), end(), o.begin(), o.end());
+}
+
+void* dynamic::Object::allocate(size_t bytes)
+{
+    return arena_ != nullptr ? arena_->allocate(bytes) : operator new(bytes);
+}
+
+void dynamic::Object::deallocate(void* p)
+{
+    if (arena_ == nullptr)
+    {
+        operator delete(p);
+    }
+}
+
+void dynamic::Object::reserve(size_t n)
+{
+    if (n > capacity_)
+    {
+        reallocate(n);
+    }
+    if (n > kMaxLinearSize && n * 2 > slotCount_)
+    {
+        size_t slotCount = kMaxLinearSize * 4;
+        while (slotCount < n * 2)
+        {
+            slotCount *= 2;
+        }
+        rehash(slotCount);
+    }
+}
+
+void dynamic::Object::reallocate(size_t capacity)
+{
+    value_type* entries = static_cast<value_type*>(
+        allocate(capacity * sizeof(value_type)));
+    for (size_t i = 0; i < size_; ++i)
+    {
+        new (&entries[i]) value_type(std::move(entries_[i]));
+        entries_[i].~value_type();
+    }
+    deallocate(entries_);
+    entries_ = entries;
+    capacity_ = capacity;
+}
+
+template <class Key>
+size_t dynamic::Object::findPos(const Key& key, uint32_t* hash) const
+{
+    if (slotCount_ == 0)
+    {
+        return findLinear(key);
+    }
+    *hash = hashKey(key);
+    return probe(key, *hash);
+}
+
+template <class Key>
+size_t dynamic::Object::findLinear(const Key& key) const
+{
+    for (size_t i = 0; i < size_; ++i)
+    {
+        if (keyEquals(entries_[i].first, key))
+        {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+template <class Key>
+size_t dynamic::Object::probe(const Key& key, uint32_t hash) const
+{
+    const size_t mask = slotCount_ - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        const Slot& slot = slots_[i];
+        if (slot.pos == 0)
+        {
+            return std::string::npos;
+        }
+        if (slot.hash == hash && keyEquals(entries_[slot.pos - 1].first, key))
+        {
+            return slot.pos - 1;
+        }
+    }
+}
+
+dynamic::Object::const_iterator dynamic::Object::find(StringPiece key) const
+{
+    uint32_t hash;
+    size_t pos = findPos(key, &hash);
+    return pos != std::string::npos ? begin() + pos : end();
+}
+
+dynamic::Object::const_iterator dynamic::Object::find(const dynamic& key) const
+{
+    uint32_t hash;
+    size_t pos = findPos(key, &hash);
+    return pos != std::string::npos ? begin() + pos : end();
+}
+
+dynamic& dynamic::Object::operator[](StringPiece key)
+{
+    uint32_t hash = 0;
+    size_t pos = findPos(key, &hash);
+    if (pos != std::string::npos)
+    {
+        return entries_[pos].second;
+    }
+    pos = append(dynamic(key.data(), key.size()), hash);
+    return entries_[pos].second;
+}
+
+dynamic& dynamic::Object::operator[](dynamic&& key)
+{
+    uint32_t hash = 0;
+    size_t pos = findPos(key, &hash);
+    if (pos != std::string::npos)
+    {
+        return entries_[pos].second;
+    }
+    pos = append(std::move(key), hash);
+    return entries_[pos].second;
+}
+
+// hash is only meaningful if the index exists
+size_t dynamic::Object::append(dynamic&& key, uint32_t hash)
+{
+    if (size_ == capacity_)
+    {
+        reallocate(capacity_ != 0 ? capacity_ * 2 : 4);
+    }
+    new (&entries_[size_]) value_type(std::move(key), dynamic());
+    const size_t size = ++size_;
+    if (slotCount_ != 0)
+    {
+        // Keep the load factor at most 1/2
+        if (size * 2 > slotCount_)
+        {
+            rehash(slotCount_ * 2);
+        }
+        else
+        {
+            insertSlot(hash, static_cast<uint32_t>(size));
+        }
+    }
+    else if (size > kMaxLinearSize)
+    {
+        rehash(kMaxLinearSize * 4);
+    }
+    return size - 1;
+}
+
+void dynamic::Object::insertSlot(uint32_t hash, uint32_t pos)
+{
+    const size_t mask = slotCount_ - 1;
+    size_t i = hash & mask;
+    while (slots_[i].pos != 0)
+    {
+        i = (i + 1) & mask;
+    }
+    slots_[i].hash = hash;
+    slots_[i].pos = pos;
+}
+
+void dynamic::Object::rehash(size_t slotCount)
+{
+    deallocate(slots_);
+    slots_ = static_cast<Slot*>(allocate(slotCount * sizeof(Slot)));
+    memset(slots_, 0, slotCount * sizeof(Slot));
+    slotCount_ = slotCount;
+    for (size_t i = 0; i < size_; ++i)
+    {
+        insertSlot(hashKey(entries_[i].first), static_cast<uint32_t>(i + 1));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+dynamic::Path::Path(StringPiece pointer)
+{
+    if (pointer.empty())
+    {
+        return;
+    }
+    if (pointer[0] != '/')
+    {
+        throw std::invalid_argument(to<std::string>(
+            "JSON pointer must start with '/': ", pointer));
+    }
+    const char* p = pointer.begin() + 1;
+    const char* const e = pointer.end();
+    for (;;)
+    {
+        Token token;
+        for (; p != e && *p != '/'; ++p)
+        {
+            if (*p != '~')
+            {
+                token.key.push_back(*p);
+            }
+            else if (p + 1 != e && (p[1] == '0' || p[1] == '1'))
+            {
+                token.key.push_back(*++p == '0' ? '~' : '/');
+            }
+            else
+            {
+                throw std::invalid_argument(to<std::string>(
+                    "invalid escape in JSON pointer: ", pointer));
+            }
+        }
+
+        token.hash = Object::hashKey(StringPiece(token.key));
+        token.index = std::string::npos;
+        const std::string& k = token.key;
+        // "0" or no leading zero, and short enough not to overflow
+        if (!k.empty() && k.size() <= 18 && (k[0] != '0' || k.size() == 1) &&
+            std::all_of(k.begin(), k.end(), [](char c) {
+                return c >= '0' && c <= '9';
+            }))
+        {
+            token.index = detail::digits_to<size_t>(k.data(), k.data() + k.size());
+        }
+        tokens_.push_back(std::move(token));
+
+        if (p == e)
+        {
+            break;
+        }
+        ++p;    // '/'
+    }
+}
+
+const dynamic* dynamic::Path::resolve(const dynamic& value, size_t first) const
+{
+    const dynamic* current = &value;
+    for (size_t i = first; i < tokens_.size(); ++i)
+    {
+        const Token& token = tokens_[i];
+        if (current->isObject())
+        {
+            const Object& object = *current->u_.object;
+            size_t pos = object.slotCount_ == 0
+                ? object.findLinear(StringPiece(token.key))
+                : object.probe(StringPiece(token.key), token.hash);
+            if (pos == std::string::npos)
+            {
+                return nullptr;
+            }
+            current = &object.entries_[pos].second;
+        }
+        else if (current->isArray())
+        {
+            if (token.index >= current->size())
+            {
+                return nullptr;
+            }
+            current = current->arrayBegin() + token.index;
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+    return current;
+}
+
+const dynamic* dynamic::get_ptr(const Path& path) const
+{
+    return path.resolve(*this);
+}
+
+dynamic* dynamic::get_ptr(const Path& path)
+{
+    return const_cast<dynamic*>(path.resolve(*this));
+}
+
+const dynamic& dynamic::at(const Path& path) const
+{
+    if (auto value = path.resolve(*this))
+    {
+        return *value;
+    }
+    throw std::out_of_range("couldn't resolve JSON pointer");
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+dynamic dynamic::arenaString(StringPiece s, Arena* arena)
+{
+    if (s.size() <= kMaxInlineSize)
+    {
+        return dynamic(s.data(), s.size());
+    }
+
+    // The characters follow the StringPiece in the same allocation
+    void* p = arena->allocate(sizeof(StringPiece) + s.size());
+    char* chars = static_cast<char*>(p) + sizeof(StringPiece);
+    if (!s.empty())
+    {
+        memcpy(chars, s.data(), s.size());
+    }
+    dynamic result;
+    result.type_ = STRING;
+    result.storage_ = kArena;
+    result.u_.arenaString = new (p) StringPiece(chars, s.size());
+    return result;
+}
+
+// Once the members are in, since the object moves them as it grows
+void dynamic::markArenaElements(Object* object)
+{
+    for (auto& member : *object)
+    {
+        const_cast<dynamic&>(member.second).arenaElement_ = true;
+    }
+}
+
+dynamic dynamic::arenaArray(dynamic* elements, size_t count, Arena* arena)
+{
+    ArenaArray* array = arena->allocateArray<ArenaArray>(1);
+    array->elements = arena->allocateArray<dynamic>(count);
+    array->size = count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        new (&array->elements[i]) dynamic(toArena(std::move(elements[i]), arena));
+        array->elements[i].arenaElement_ = true;
+    }
+    dynamic result;
+    result.type_ = ARRAY;
+    result.storage_ = kArena;
+    result.u_.arenaArray = array;
+    return result;
+}
+
+dynamic dynamic::arenaObject(std::pair<dynamic, dynamic>* members,
+                             size_t count, Arena* arena)
+{
+    Object* object = new (arena->allocateArray<Object>(1)) Object(arena);
+    object->reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        (*object)[toArena(std::move(members[i].first), arena)] =
+            toArena(std::move(members[i].second), arena);
+    }
+    markArenaElements(object);
+    dynamic result;
+    result.type_ = OBJECT;
+    result.storage_ = kArena;
+    result.u_.object = object;
+    return result;
+}
+
+dynamic dynamic::copyToArena(const dynamic& value, Arena* arena)
+{
+    switch (value.type())
+    {
+    case STRING:
+        return arenaString(value.getString(), arena);
+    case ARRAY:
+        {
+            const size_t count = value.size();
+            ArenaArray* array = arena->allocateArray<ArenaArray>(1);
+            array->elements = arena->allocateArray<dynamic>(count);
+            array->size = count;
+            const dynamic* source = value.arrayBegin();
+            for (size_t i = 0; i < count; ++i)
+            {
+                new (&array->elements[i]) dynamic(copyToArena(source[i], arena));
+                array->elements[i].arenaElement_ = true;
+            }
+            dynamic result;
+            result.type_ = ARRAY;
+            result.storage_ = kArena;
+            result.u_.arenaArray = array;
+            return result;
+        }
+    case OBJECT:
+        {
+            Object* object = new (arena->allocateArray<Object>(1)) Object(arena);
+            object->reserve(value.size());
+            for (const auto& member : value)
+            {
+                (*object)[copyToArena(member.first, arena)] =
+                    copyToArena(member.second, arena);
+            }
+            markArenaElements(object);
+            dynamic result;
+            result.type_ = OBJECT;
+            result.storage_ = kArena;
+            result.u_.object = object;
+            return result;
+        }
+    default:
+        return value;
+    }
+}
+
+dynamic dynamic::toArena(dynamic&& value, Arena* arena)
+{
+    switch (value.type())
+    {
+    case STRING:
+    case ARRAY:
+    case OBJECT:
+        if (value.storage_ == kOwned)
+        {
+            return copyToArena(value, arena);
+        }
+        // fall through
+    default:
+        return std::move(value);
+    }
+}
+
 std::ostream& operator<<(std::ostream& strm, const dynamic& d)
 {
     switch (d.type())
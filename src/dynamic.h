@@ -5,7 +5,7 @@
 #pragma once
 
 #include <stdint.h>
-#include <map>
+#include <utility>
 #include <vector>
 #include <string>
 #include <ostream>
@@ -14,6 +14,8 @@
 #include <initializer_list>
 #include "Conv.h"
 
+class Arena;
+
 
 /**
  * This is a runtime dynamically typed value.  It holds types from a
@@ -57,11 +59,20 @@ public:
     };
 
     typedef std::vector<dynamic> Array;
-    typedef std::map<dynamic, dynamic>  Object;
+    class Object;   // insertion-ordered hash map, defined below
+    class Path;     // compiled JSON Pointer, defined below
 
 public:
-    dynamic(const dynamic& o) : type_(NULLT) { *this = o; }
-    dynamic(dynamic&& o) noexcept : type_(NULLT) { *this = std::move(o); }
+    dynamic(const dynamic& o)
+        : type_(NULLT), storage_(kOwned), inlineSize_(0), arenaElement_(false)
+    {
+        *this = o;
+    }
+    dynamic(dynamic&& o) noexcept
+        : type_(NULLT), storage_(kOwned), inlineSize_(0), arenaElement_(false)
+    {
+        *this = std::move(o);
+    }
     ~dynamic() noexcept { destroy(); }
 
     /*
@@ -102,6 +113,11 @@ public:
      */
     /* implicit */ dynamic(std::initializer_list<dynamic> il);
 
+    /*
+     * Create a new array by taking over the elements of a vector.
+     */
+    explicit dynamic(Array&& array);
+
     /*
      * For making dynamic objects.
      */
@@ -140,8 +156,12 @@ public:
      * Note you can only use this to access integral types or strings,
      * since arrays and objects are generally best dealt with as a
      * dynamic.
+     *
+     * Short strings are stored inside the dynamic itself, so the piece
+     * returned by getString() is only valid while the dynamic is neither
+     * modified nor moved.
      */
-    const std::string&  getString() const;
+    StringPiece getString() const;
     double getDouble() const;
     int64_t getInt() const;
     bool getBool() const;
@@ -193,11 +213,11 @@ public:
         switch (type())
         {
         case STRING:
-            return getString();
+            return getString().str();
         case INT64:
             return to<std::string>(getInt());
         case DOUBLE:
-            return to<std::string>(getDouble());
+            return dump();  // shortest form that round-trips
         case BOOL:
             return (getBool() ? "true" : "false");
         case NULLT:
@@ -226,7 +246,7 @@ public:
      * You can iterate over the values of the object.  Calling these on
      * non-object will throw a TypeError.
      */
-    typedef Object::const_iterator const_iterator;
+    typedef const std::pair<dynamic, dynamic>* const_iterator;
     const_iterator begin()  const;
     const_iterator end()    const;
 
@@ -234,7 +254,14 @@ public:
      * If this is an object, returns whether it contains a field with
      * the given name.  Otherwise throws TypeError.
      */
-    bool contains(const std::string& key) const;
+    bool contains(StringPiece key) const;
+
+    /*
+     * If this is an object, returns a pointer to the field with the given
+     * name, or nullptr if there is none.  Otherwise throws TypeError.
+     */
+    const dynamic*  get_ptr(StringPiece key) const;
+    dynamic*        get_ptr(StringPiece key);
 
     /*
      * Assignment from other dynamics.  Because of the implicit conversion
@@ -244,7 +271,7 @@ public:
      * Basic guarantee only.
      */
     dynamic& operator=(dynamic const&);
-    dynamic& operator=(dynamic&&)noexcept;
+    dynamic& operator=(dynamic&&);
 
     //bool operator==(const dynamic& o) const;
     //bool operator!=(const dynamic& o) const { return !(*this == o); }
@@ -260,15 +287,24 @@ public:
     void push_back(dynamic const&);
     void push_back(dynamic&&);
 
+    /*
+     * Set a field of an object, replacing any previous value.  Both key
+     * and value are moved in.  If this is not an object, throws TypeError.
+     * Keys of any type are allowed, although only string keys make
+     * valid JSON.
+     */
+    void insert(dynamic key, dynamic value);
+
     /*
      * For an object, the non-const overload inserts a null value
      * if the key isn't present.  The const overload will throw
      * std::out_of_range if the key is not present.
      *
-     * These functions do not invalidate iterators.
+     * Inserting a new field may invalidate iterators and references into
+     * the object, as push_back does for a vector.
      */
-    dynamic&        operator[](const std::string&);
-    const dynamic&  operator[](const std::string&)const;
+    dynamic&        operator[](StringPiece);
+    const dynamic&  operator[](StringPiece)const;
 
     /*
      * For arrays, provides access to sub-fields by index.
@@ -280,6 +316,15 @@ public:
     dynamic const& at(size_t index) const;
     dynamic&       at(size_t index);
 
+    /*
+     * Look up a nested value by a compiled JSON Pointer, see Path below.
+     * get_ptr() returns nullptr and at() throws std::out_of_range if
+     * there is no such value.
+     */
+    const dynamic*  get_ptr(const Path& path) const;
+    dynamic*        get_ptr(const Path& path);
+    const dynamic&  at(const Path& path) const;
+
     /*
      * For simple dynamics (not arrays or objects), this prints the
      * value to an std::ostream in the expected way.  Respects the
@@ -293,11 +338,61 @@ public:
      */
     friend std::ostream& operator<<(std::ostream&, const dynamic&);
 
+    /*
+     * Serialize to compact JSON text, see serializeJson() in json.h.
+     * Non-string keys and NaN/infinities are written rather than
+     * rejected, so this never throws for those.
+     */
     std::string dump() const;
 
     static const char* typeName(Type t);
 
+    /*
+     * Arena-allocated documents.
+     *
+     * These build values whose payload (characters, elements, members)
+     * lives in an Arena rather than in separately heap-allocated blocks,
+     * so a whole document is released at once when the arena is cleared
+     * or destroyed, without visiting any node.  parseJson() can build its
+     * result this way directly.
+     *
+     * Such values are read with the normal interface.  They are
+     * read-only: push_back(), insert() and operator[] with a new key
+     * throw std::logic_error, and so does assigning an element or member
+     * a value that would own heap memory, since they are never destroyed.
+     * Copying one with the copy constructor or assignment makes an
+     * ordinary heap-allocated deep copy; moving one keeps pointing into
+     * the arena, which must outlive it.
+     *
+     * arenaArray() and arenaObject() move the given elements in;
+     * those that are not in an arena already are copied into it.  Later
+     * members of arenaObject() replace earlier ones with the same key.
+     */
+    static dynamic arenaString(StringPiece s, Arena* arena);
+    static dynamic arenaArray(dynamic* elements, size_t count, Arena* arena);
+    static dynamic arenaObject(std::pair<dynamic, dynamic>* members,
+                               size_t count, Arena* arena);
+    static dynamic copyToArena(const dynamic& value, Arena* arena);
+
+    /*
+     * Returns true if this string, array or object is stored in an Arena.
+     * Short strings are always stored inline and never are.
+     */
+    bool isInArena() const { return storage_ == kArena; }
+
 private:
+    struct ArenaArray
+    {
+        dynamic*    elements;
+        size_t      size;
+    };
+
+    static dynamic toArena(dynamic&& value, Arena* arena);
+    const dynamic* arrayBegin() const;
+    const dynamic* arrayEnd() const;
+
+    static bool needsHeap(const dynamic& o, bool copying);
+    static void markArenaElements(Object* object);
     void assign(const dynamic& o);
     void destroy();
     const void* getAddress() const;
@@ -307,9 +402,22 @@ private:
     }
 
 private:
-    Type type_;
+    // Where the payload of a STRING, ARRAY or OBJECT lives
+    enum Storage
+    {
+        kOwned,         // heap-allocated, freed by destroy()
+        kArena,         // in an Arena, never freed
+        kInline,        // STRING only, in u_.chars
+    };
+
+    // Strings up to this size are stored in the node itself
+    enum { kMaxInlineSize = 16 };
+
+    void setInline(const char* s, size_t count);
+
     union Data
     {
+        char            chars[kMaxInlineSize];
         void*           nul;
         bool            boolean;
         int64_t         integer;
@@ -317,5 +425,161 @@ private:
         std::string*    string;
         Array*          array;
         Object*         object;
+        StringPiece*    arenaString;
+        ArenaArray*     arenaArray;
     }u_;
+    Type type_;
+    uint8_t storage_;
+    uint8_t inlineSize_;    // length of an inline string
+    bool arenaElement_;     // an element or member value of an arena
+                            // array or object; never destroyed
+};
+
+/*
+ * Storage of an OBJECT dynamic: a hash map that iterates in insertion order.
+ *
+ * Members are kept in an array, in the order they were first inserted, and
+ * located through an open-addressing (linear probing) table of 32-bit hash
+ * and position pairs.  Objects with few members skip the table and are
+ * scanned linearly, which is faster at that size.
+ *
+ * Lookup by StringPiece hashes and compares the bytes directly, without
+ * building a temporary dynamic.
+ *
+ * An Object constructed with an Arena takes all its storage from it and
+ * frees nothing; it must itself be placed in the arena.
+ */
+class dynamic::Object
+{
+public:
+    typedef std::pair<dynamic, dynamic> value_type;
+    typedef const value_type* const_iterator;
+
+    Object();
+    explicit Object(Arena* arena);
+    Object(const Object& o);    // always on the heap
+    ~Object();
+
+    Object& operator=(const Object&) = delete;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const_iterator begin() const { return entries_; }
+    const_iterator end() const { return entries_ + size_; }
+
+    /*
+     * Make room for n members without further reallocation.
+     */
+    void reserve(size_t n);
+
+    /*
+     * Returns the member with the given key, or end().
+     */
+    const_iterator find(StringPiece key) const;
+    const_iterator find(const dynamic& key) const;
+
+    /*
+     * Returns the value for the given key, inserting a null value at the
+     * end if the key isn't present.  May invalidate iterators.
+     */
+    dynamic& operator[](StringPiece key);
+    dynamic& operator[](dynamic&& key);
+    dynamic& operator[](const dynamic& key) { return (*this)[dynamic(key)]; }
+
+    /*
+     * Lexicographical comparison of the members in iteration order.
+     */
+    bool operator<(const Object& o) const;
+
+private:
+    friend class dynamic::Path;
+    struct Slot
+    {
+        uint32_t hash;
+        uint32_t pos;       // index in entries_ plus one, 0 if empty
+    };
+
+    // Objects up to this size have no index
+    enum { kMaxLinearSize = 8 };
+
+    static uint32_t hashKey(StringPiece key);
+    static uint32_t hashKey(const dynamic& key);
+
+    template <class Key>
+    size_t findPos(const Key& key, uint32_t* hash) const;  // sets *hash when indexed
+    template <class Key>
+    size_t findLinear(const Key& key) const;
+    template <class Key>
+    size_t probe(const Key& key, uint32_t hash) const;
+    size_t append(dynamic&& key, uint32_t hash);
+    void insertSlot(uint32_t hash, uint32_t pos);
+    void rehash(size_t slotCount);
+    void reallocate(size_t capacity);
+    void* allocate(size_t bytes);
+    void deallocate(void* p);
+
+    value_type*     entries_;
+    size_t          size_;
+    size_t          capacity_;
+    Slot*           slots_;
+    size_t          slotCount_;     // 0, or a power of two
+    Arena*          arena_;         // nullptr for the heap
+};
+
+/*
+ * A JSON Pointer (RFC 6901) compiled for repeated lookups.
+ *
+ *   static const dynamic::Path kCity("/address/city");
+ *   const dynamic* city = doc.get_ptr(kCity);
+ *
+ * The pointer is split and unescaped ("~1" is '/', "~0" is '~') once, and
+ * each key is hashed up front, so resolving it is a single walk down the
+ * document without building or hashing any strings.  A token addresses
+ * a member of an object by key, or an element of an array when it is a
+ * decimal index without leading zeros.  The empty pointer addresses the
+ * whole document.
+ */
+class dynamic::Path
+{
+public:
+    /*
+     * Throws std::invalid_argument if pointer is neither empty nor starts
+     * with '/', or has a '~' not followed by '0' or '1'.
+     */
+    explicit Path(StringPiece pointer);
+
+    /*
+     * Number of reference tokens, and each one unescaped.
+     */
+    size_t size() const { return tokens_.size(); }
+    StringPiece token(size_t i) const { return tokens_[i].key; }
+
+    /*
+     * Whether token i selects the given object member or array element.
+     */
+    bool matchesKey(size_t i, StringPiece key) const
+    {
+        return StringPiece(tokens_[i].key) == key;
+    }
+    bool matchesIndex(size_t i, size_t index) const
+    {
+        return tokens_[i].index == index;
+    }
+
+    /*
+     * Apply the tokens from first onwards to value.  Returns nullptr if
+     * one of them names a missing member or element, or is applied to
+     * something other than an object or array.
+     */
+    const dynamic* resolve(const dynamic& value, size_t first = 0) const;
+
+private:
+    struct Token
+    {
+        std::string key;
+        uint32_t    hash;       // for Object lookups
+        size_t      index;      // or npos if not an array index
+    };
+
+    std::vector<Token> tokens_;
 };
@@ -0,0 +1,1386 @@
+// Copyright (C) 2015 chenqiang@outlook.com. All rights reserved.
+// Distributed under the terms and conditions of the Apache License.
+// See accompanying files LICENSE.
+
+#include "json.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Conv.h"
+#include "Unicode.h"
+#include "Arena.h"
+#if FOLLY_HAVE_EMMINTRIN_H
+#include <immintrin.h>
+#include "CpuId.h"
+#endif
+
+namespace {
+
+const int kMaxNestingDepth = 1024;
+
+// Returns the first position in [p, e) holding '"', '\\' or a control
+// character, i.e. the first byte of a string body that is not copied as is.
+inline const char* skipStringChars_scalar(const char* p, const char* e)
+{
+    for (; p != e; ++p)
+    {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\' || c < 0x20)
+        {
+            break;
+        }
+    }
+    return p;
+}
+
+#if FOLLY_HAVE_EMMINTRIN_H
+
+const char* skipStringChars_sse2(const char* p, const char* e)
+    __attribute__((__target__("sse2"), noinline));
+
+const char* skipStringChars_sse2(const char* p, const char* e)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; e - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // unsigned v <= 0x1f  <=>  max(v, 0x1f) == 0x1f
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                         _mm_cmpeq_epi8(v, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skipStringChars_scalar(p, e);
+}
+
+const char* skipStringChars_avx2(const char* p, const char* e)
+    __attribute__((__target__("avx2"), noinline));
+
+const char* skipStringChars_avx2(const char* p, const char* e)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    for (; e - p >= 32; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                            _mm256_cmpeq_epi8(v, backslash)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(special));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    // Leave no upper AVX state behind for the SSE2 tail
+    _mm256_zeroupper();
+    return skipStringChars_sse2(p, e);
+}
+
+inline const char* skipStringChars(const char* p, const char* e)
+{
+    static auto const skipStringChars_fn =
+        CpuId().avx2() && CpuId().osSupportsAvx()
+            ? skipStringChars_avx2 : skipStringChars_sse2;
+    return skipStringChars_fn(p, e);
+}
+
+#else
+
+inline const char* skipStringChars(const char* p, const char* e)
+{
+    return skipStringChars_scalar(p, e);
+}
+
+#endif // FOLLY_HAVE_EMMINTRIN_H
+
+inline bool isJsonSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+FOLLY_NORETURN void throwParseError(size_t line, StringPiece context,
+                                    const char* what)
+{
+    if (context.size() > 20)
+    {
+        context.reset(context.data(), 20);
+    }
+    throw JsonParseError(to<std::string>("json parse error on line ", line,
+        !context.empty() ? " near `" : "", context,
+        !context.empty() ? "'" : "", ": ", what));
+}
+
+inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Recursive descent over the input, building the dynamic tree bottom-up so
+// that every array and object is moved, never copied, into its parent.
+//
+// With an arena, elements and members are collected on stacks shared by
+// all nesting levels, and each container is copied into the arena in one
+// piece once its size is known.
+class JsonParser
+{
+public:
+    // line is that of the start of json, for error messages
+    JsonParser(StringPiece json, Arena* arena, size_t line = 1)
+        : b_(json.begin()), p_(json.begin()), e_(json.end()), depth_(0),
+          line_(line), arena_(arena)
+    {
+    }
+
+    dynamic parse()
+    {
+        skipWhitespace();
+        dynamic result = parseValue();
+        skipWhitespace();
+        if (p_ != e_)
+        {
+            error("parsing didn't consume all input");
+        }
+        return result;
+    }
+
+private:
+    FOLLY_NORETURN void error(const char* what) const;
+
+    void skipWhitespace()
+    {
+        while (p_ != e_ && isJsonSpace(*p_))
+        {
+            ++p_;
+        }
+    }
+
+    // Current character; throws if the input is exhausted
+    char peek() const
+    {
+        if (UNLIKELY(p_ == e_))
+        {
+            error("unexpected end of input");
+        }
+        return *p_;
+    }
+
+    void expect(char c, const char* what)
+    {
+        if (peek() != c)
+        {
+            error(what);
+        }
+        ++p_;
+    }
+
+    dynamic parseValue();
+    dynamic parseObject();
+    dynamic parseArray();
+    dynamic parseString();
+    dynamic parseNumber();
+    dynamic parseLiteral(const char* word, size_t len, dynamic value);
+    void parseEscape(std::string* out);
+    char32_t parseHex4();
+
+    dynamic makeString(StringPiece s)
+    {
+        return arena_ ? dynamic::arenaString(s, arena_)
+            : dynamic(s.data(), s.size());
+    }
+
+    const char* const b_;
+    const char* p_;
+    const char* const e_;
+    int depth_;
+    const size_t line_;
+    Arena* const arena_;
+    dynamic::Array elements_;
+    std::vector<std::pair<dynamic, dynamic>> members_;
+};
+
+void JsonParser::error(const char* what) const
+{
+    throwParseError(line_ + std::count(b_, p_, '\n'), StringPiece(p_, e_), what);
+}
+
+dynamic JsonParser::parseValue()
+{
+    switch (peek())
+    {
+    case '{':
+        return parseObject();
+    case '[':
+        return parseArray();
+    case '"':
+        return parseString();
+    case 't':
+        return parseLiteral("true", 4, true);
+    case 'f':
+        return parseLiteral("false", 5, false);
+    case 'n':
+        return parseLiteral("null", 4, nullptr);
+    default:
+        if (*p_ == '-' || isDigit(*p_))
+        {
+            return parseNumber();
+        }
+        error("expected json value");
+    }
+}
+
+dynamic JsonParser::parseObject()
+{
+    if (++depth_ > kMaxNestingDepth)
+    {
+        error("nesting too deep");
+    }
+    ++p_;  // '{'
+    dynamic object = arena_ ? dynamic() : dynamic(dynamic::object);
+    const size_t mark = members_.size();
+    skipWhitespace();
+    if (peek() == '}')
+    {
+        ++p_;
+        --depth_;
+        return arena_ ? dynamic::arenaObject(nullptr, 0, arena_) : object;
+    }
+    for (;;)
+    {
+        skipWhitespace();
+        if (peek() != '"')
+        {
+            error("expected string as object key");
+        }
+        dynamic key = parseString();
+        skipWhitespace();
+        expect(':', "expected ':' in object");
+        skipWhitespace();
+        if (arena_)
+        {
+            members_.emplace_back(std::move(key), parseValue());
+        }
+        else
+        {
+            object.insert(std::move(key), parseValue());
+        }
+        skipWhitespace();
+        char c = peek();
+        ++p_;
+        if (c == '}')
+        {
+            break;
+        }
+        if (c != ',')
+        {
+            --p_;
+            error("expected ',' or '}' in object");
+        }
+    }
+    --depth_;
+    if (arena_)
+    {
+        object = dynamic::arenaObject(members_.data() + mark,
+            members_.size() - mark, arena_);
+        members_.erase(members_.begin() + mark, members_.end());
+    }
+    return object;
+}
+
+dynamic JsonParser::parseArray()
+{
+    if (++depth_ > kMaxNestingDepth)
+    {
+        error("nesting too deep");
+    }
+    ++p_;  // '['
+    dynamic::Array heapElements;
+    dynamic::Array& elements = arena_ ? elements_ : heapElements;
+    const size_t mark = elements.size();
+    skipWhitespace();
+    if (peek() == ']')
+    {
+        ++p_;
+        --depth_;
+        return arena_ ? dynamic::arenaArray(nullptr, 0, arena_)
+            : dynamic(std::move(elements));
+    }
+    for (;;)
+    {
+        skipWhitespace();
+        elements.push_back(parseValue());
+        skipWhitespace();
+        char c = peek();
+        ++p_;
+        if (c == ']')
+        {
+            break;
+        }
+        if (c != ',')
+        {
+            --p_;
+            error("expected ',' or ']' in array");
+        }
+    }
+    --depth_;
+    if (arena_)
+    {
+        dynamic array = dynamic::arenaArray(elements.data() + mark,
+            elements.size() - mark, arena_);
+        elements.erase(elements.begin() + mark, elements.end());
+        return array;
+    }
+    return dynamic(std::move(elements));
+}
+
+dynamic JsonParser::parseString()
+{
+    ++p_;  // '"'
+    const char* begin = p_;
+    p_ = skipStringChars(p_, e_);
+    if (LIKELY(p_ != e_ && *p_ == '"'))
+    {
+        // No escapes: construct straight from the input
+        ++p_;
+        return makeString(StringPiece(begin, p_ - 1));
+    }
+
+    std::string s(begin, p_);
+    for (;;)
+    {
+        char c = peek();
+        if (c == '"')
+        {
+            ++p_;
+            return arena_ ? dynamic::arenaString(s, arena_)
+                : dynamic(std::move(s));
+        }
+        if (c != '\\')
+        {
+            error("control character in string");
+        }
+        parseEscape(&s);
+        const char* run = p_;
+        p_ = skipStringChars(p_, e_);
+        s.append(run, p_);
+    }
+}
+
+void JsonParser::parseEscape(std::string* out)
+{
+    ++p_;  // '\\'
+    char c = peek();
+    ++p_;
+    switch (c)
+    {
+    case '"':  out->push_back('"'); break;
+    case '\\': out->push_back('\\'); break;
+    case '/':  out->push_back('/'); break;
+    case 'b':  out->push_back('\b'); break;
+    case 'f':  out->push_back('\f'); break;
+    case 'n':  out->push_back('\n'); break;
+    case 'r':  out->push_back('\r'); break;
+    case 't':  out->push_back('\t'); break;
+    case 'u':
+        {
+            char32_t cp = parseHex4();
+            if (cp >= 0xd800 && cp <= 0xdbff)
+            {
+                // High surrogate, must be followed by a low one
+                if (e_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u')
+                {
+                    error("expected low surrogate after high surrogate");
+                }
+                p_ += 2;
+                char32_t low = parseHex4();
+                if (low < 0xdc00 || low > 0xdfff)
+                {
+                    error("invalid low surrogate");
+                }
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            }
+            else if (cp >= 0xdc00 && cp <= 0xdfff)
+            {
+                error("unpaired low surrogate");
+            }
+            out->append(codePointToUtf8(cp));
+        }
+        break;
+    default:
+        --p_;
+        error("invalid escape sequence");
+    }
+}
+
+char32_t JsonParser::parseHex4()
+{
+    if (e_ - p_ < 4)
+    {
+        error("expected 4 hex digits");
+    }
+    char32_t cp = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        int h = hexValue(p_[i]);
+        if (h < 0)
+        {
+            error("expected 4 hex digits");
+        }
+        cp = (cp << 4) | h;
+    }
+    p_ += 4;
+    return cp;
+}
+
+dynamic JsonParser::parseNumber()
+{
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    const char* begin = p_;
+    bool negative = (*p_ == '-');
+    if (negative)
+    {
+        ++p_;
+    }
+    const char* digits = p_;
+    if (peek() == '0')
+    {
+        ++p_;
+    }
+    else if (isDigit(*p_))
+    {
+        while (p_ != e_ && isDigit(*p_)) ++p_;
+    }
+    else
+    {
+        error("expected digit");
+    }
+    const char* digitsEnd = p_;
+
+    bool integral = true;
+    if (p_ != e_ && *p_ == '.')
+    {
+        ++p_;
+        if (!isDigit(peek()))
+        {
+            error("expected digit after '.'");
+        }
+        while (p_ != e_ && isDigit(*p_)) ++p_;
+        integral = false;
+    }
+    if (p_ != e_ && (*p_ == 'e' || *p_ == 'E'))
+    {
+        ++p_;
+        if (peek() == '+' || *p_ == '-')
+        {
+            ++p_;
+        }
+        if (!isDigit(peek()))
+        {
+            error("expected digit in exponent");
+        }
+        while (p_ != e_ && isDigit(*p_)) ++p_;
+        integral = false;
+    }
+
+    // Up to 19 digits always fit in uint64_t, so digits_to can't throw
+    if (integral && digitsEnd - digits <= 19)
+    {
+        uint64_t value = detail::digits_to<uint64_t>(digits, digitsEnd);
+        const uint64_t kMax = std::numeric_limits<int64_t>::max();
+        if (!negative && value <= kMax)
+        {
+            return static_cast<int64_t>(value);
+        }
+        if (negative && value <= kMax + 1)
+        {
+            return value == kMax + 1 ? std::numeric_limits<int64_t>::min()
+                : -static_cast<int64_t>(value);
+        }
+    }
+
+    // Everything else is a double
+    return to<double>(StringPiece(begin, p_));
+}
+
+dynamic JsonParser::parseLiteral(const char* word, size_t len, dynamic value)
+{
+    if (static_cast<size_t>(e_ - p_) < len || memcmp(p_, word, len) != 0)
+    {
+        error("expected json value");
+    }
+    p_ += len;
+    return value;
+}
+
+// Map from character code to the letter of its JSON escape sequence ('u' for
+// \u00XX), or 0 if the character is written as is.
+const char kJsonEscapeTable[] =
+{
+  'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+  'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0,   0, '"',   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, '\\',   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+};
+
+// Writes dynamic values as JSON text straight into a std::string.
+class JsonSerializer
+{
+public:
+    JsonSerializer(std::string* out, const JsonSerializationOpts& opts)
+        : out_(out), opts_(opts), indent_(0)
+    {
+    }
+
+    void serialize(const dynamic& value);
+
+private:
+    void serializeArray(const dynamic& array);
+    void serializeObject(const dynamic& object);
+    void serializeKey(const dynamic& key);
+    void appendInt(int64_t value);
+    void appendDouble(double value);
+    void appendString(StringPiece s);
+
+    void newline()
+    {
+        if (opts_.prettyFormatting)
+        {
+            out_->push_back('\n');
+            out_->append(indent_ * 2, ' ');
+        }
+    }
+
+    std::string* out_;
+    const JsonSerializationOpts& opts_;
+    int indent_;
+};
+
+void JsonSerializer::serialize(const dynamic& value)
+{
+    switch (value.type())
+    {
+    case dynamic::NULLT:
+        out_->append("null", 4);
+        break;
+    case dynamic::BOOL:
+        if (value.getBool())
+        {
+            out_->append("true", 4);
+        }
+        else
+        {
+            out_->append("false", 5);
+        }
+        break;
+    case dynamic::INT64:
+        appendInt(value.getInt());
+        break;
+    case dynamic::DOUBLE:
+        appendDouble(value.getDouble());
+        break;
+    case dynamic::STRING:
+        appendString(value.getString());
+        break;
+    case dynamic::ARRAY:
+        serializeArray(value);
+        break;
+    case dynamic::OBJECT:
+        serializeObject(value);
+        break;
+    }
+}
+
+void JsonSerializer::serializeArray(const dynamic& array)
+{
+    const size_t size = array.size();
+    out_->push_back('[');
+    if (size > 0)
+    {
+        ++indent_;
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (i > 0)
+            {
+                out_->push_back(',');
+            }
+            newline();
+            serialize(array.at(i));
+        }
+        --indent_;
+        newline();
+    }
+    out_->push_back(']');
+}
+
+void JsonSerializer::serializeObject(const dynamic& object)
+{
+    typedef dynamic::Object::value_type Member;
+
+    out_->push_back('{');
+    if (object.empty())
+    {
+        out_->push_back('}');
+        return;
+    }
+
+    auto writeMember = [this](const Member& member, bool first) {
+        if (!first)
+        {
+            out_->push_back(',');
+        }
+        newline();
+        serializeKey(member.first);
+        out_->push_back(':');
+        if (opts_.prettyFormatting)
+        {
+            out_->push_back(' ');
+        }
+        serialize(member.second);
+    };
+
+    ++indent_;
+    if (opts_.sortKeys)
+    {
+        std::vector<const Member*> members;
+        members.reserve(object.size());
+        for (const auto& member : object)
+        {
+            members.push_back(&member);
+        }
+        std::sort(members.begin(), members.end(),
+            [](const Member* a, const Member* b) { return a->first < b->first; });
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            writeMember(*members[i], i == 0);
+        }
+    }
+    else
+    {
+        bool first = true;
+        for (const auto& member : object)
+        {
+            writeMember(member, first);
+            first = false;
+        }
+    }
+    --indent_;
+    newline();
+    out_->push_back('}');
+}
+
+void JsonSerializer::serializeKey(const dynamic& key)
+{
+    if (key.isString())
+    {
+        appendString(key.getString());
+    }
+    else if (opts_.allowNonStringKeys)
+    {
+        serialize(key);
+    }
+    else
+    {
+        throw dynamic::TypeError("string", key.type());
+    }
+}
+
+void JsonSerializer::appendInt(int64_t value)
+{
+    char buffer[20];
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (value < 0)
+    {
+        out_->push_back('-');
+        magnitude = 0 - magnitude;
+    }
+    out_->append(buffer, uint64ToBufferUnsafe(magnitude, buffer));
+}
+
+void JsonSerializer::appendDouble(double value)
+{
+    if (UNLIKELY(std::isnan(value) || std::isinf(value)))
+    {
+        if (!opts_.allowNanInf)
+        {
+            throw std::invalid_argument(
+                "NaN and infinity can't be written as JSON");
+        }
+        out_->append(std::isnan(value) ? "NaN"
+            : value > 0 ? "Infinity" : "-Infinity");
+        return;
+    }
+
+    // The shortest digits that read back exactly, always with a '.' or an
+    // exponent so they stay a double when parsed again
+    toAppend(out_, value);
+}
+
+void JsonSerializer::appendString(StringPiece s)
+{
+    out_->push_back('"');
+    const char* p = s.begin();
+    const char* e = s.end();
+    for (;;)
+    {
+        // Copy the run of characters that need no escaping in one go
+        const char* run = p;
+        p = skipStringChars(p, e);
+        out_->append(run, p);
+        if (p == e)
+        {
+            break;
+        }
+
+        const unsigned char c = static_cast<unsigned char>(*p++);
+        const char escape = kJsonEscapeTable[c];
+        char buffer[6] = { '\\', escape };
+        if (escape == 'u')
+        {
+            static const char kHexDigits[] = "0123456789abcdef";
+            buffer[2] = '0';
+            buffer[3] = '0';
+            buffer[4] = kHexDigits[c >> 4];
+            buffer[5] = kHexDigits[c & 0xf];
+            out_->append(buffer, 6);
+        }
+        else
+        {
+            out_->append(buffer, 2);
+        }
+    }
+    out_->push_back('"');
+}
+
+// Returns the position in [p, e) of the quote that ends a string body, or
+// of the first control character in it, or e if there is neither.  p is
+// just after a backslash if *escaped, which is updated for the next chunk.
+const char* findStringEnd(const char* p, const char* e, bool* escaped)
+{
+    if (*escaped)
+    {
+        if (p == e)
+        {
+            return e;
+        }
+        ++p;
+        *escaped = false;
+    }
+    for (;;)
+    {
+        p = skipStringChars(p, e);
+        if (p == e || *p != '\\')
+        {
+            return p;
+        }
+        if (++p == e)
+        {
+            *escaped = true;
+            return e;
+        }
+        ++p;
+    }
+}
+
+// Characters that may continue a number or literal token
+inline bool isNumberChar(char c)
+{
+    return isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' ||
+        c == 'E';
+}
+
+inline bool isLiteralChar(char c)
+{
+    return c >= 'a' && c <= 'z';
+}
+
+}  // namespace
+
+dynamic parseJson(StringPiece json)
+{
+    return JsonParser(json, nullptr).parse();
+}
+
+dynamic parseJson(StringPiece json, Arena* arena)
+{
+    return JsonParser(json, arena).parse();
+}
+
+void serializeJson(const dynamic& value, std::string* out,
+                   const JsonSerializationOpts& opts)
+{
+    JsonSerializer(out, opts).serialize(value);
+}
+
+std::string toJson(const dynamic& value)
+{
+    std::string result;
+    serializeJson(value, &result);
+    return result;
+}
+
+std::string toPrettyJson(const dynamic& value)
+{
+    JsonSerializationOpts opts;
+    opts.prettyFormatting = true;
+    std::string result;
+    serializeJson(value, &result, opts);
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+JsonReader::JsonReader(JsonHandler* handler)
+    : handler_(handler),
+      state_(kValue),
+      pending_(kNoToken),
+      escaped_(false),
+      line_(1)
+{
+}
+
+void JsonReader::reset()
+{
+    state_ = kValue;
+    pending_ = kNoToken;
+    escaped_ = false;
+    line_ = 1;
+    carry_.clear();
+    containers_.clear();
+}
+
+void JsonReader::feed(StringPiece chunk)
+{
+    const char* p = chunk.begin();
+    const char* const e = chunk.end();
+    if (pending_ != kNoToken)
+    {
+        p = resumeToken(p, e);
+    }
+    while (p != e)
+    {
+        const char c = *p;
+        if (isJsonSpace(c))
+        {
+            if (c == '\n')
+            {
+                ++line_;
+            }
+            if (state_ == kAfterTopLevel)
+            {
+                state_ = kValue;
+            }
+            ++p;
+            continue;
+        }
+        switch (state_)
+        {
+        case kAfterTopLevel:
+            error(p, e, "expected whitespace after top-level value");
+        case kArrayFirst:
+            if (c == ']')
+            {
+                ++p;
+                endContainer();
+                break;
+            }
+            // fall through
+        case kValue:
+            p = startValue(p, e);
+            break;
+        case kObjectFirst:
+            if (c == '}')
+            {
+                ++p;
+                endContainer();
+                break;
+            }
+            // fall through
+        case kKey:
+            if (c != '"')
+            {
+                error(p, e, "expected string as object key");
+            }
+            p = startString(p, e, kKeyToken);
+            break;
+        case kColon:
+            if (c != ':')
+            {
+                error(p, e, "expected ':' in object");
+            }
+            ++p;
+            state_ = kValue;
+            break;
+        case kAfterValue:
+            {
+                const bool inObject = (containers_.back() == '{');
+                if (c == ',')
+                {
+                    ++p;
+                    state_ = inObject ? kKey : kValue;
+                }
+                else if (c == (inObject ? '}' : ']'))
+                {
+                    ++p;
+                    endContainer();
+                }
+                else
+                {
+                    error(p, e, inObject ? "expected ',' or '}' in object"
+                        : "expected ',' or ']' in array");
+                }
+            }
+            break;
+        }
+    }
+}
+
+void JsonReader::finish()
+{
+    if (pending_ == kNumberToken || pending_ == kLiteralToken)
+    {
+        Token kind = pending_;
+        pending_ = kNoToken;
+        endToken(carry_, kind);
+        carry_.clear();
+    }
+    if (pending_ != kNoToken || !containers_.empty() ||
+        (state_ != kValue && state_ != kAfterTopLevel))
+    {
+        error(nullptr, nullptr, "unexpected end of input");
+    }
+    reset();
+}
+
+const char* JsonReader::startValue(const char* p, const char* e)
+{
+    switch (*p)
+    {
+    case '{':
+    case '[':
+        if (containers_.size() >= static_cast<size_t>(kMaxNestingDepth))
+        {
+            error(p, e, "nesting too deep");
+        }
+        containers_.push_back(*p);
+        if (*p == '{')
+        {
+            state_ = kObjectFirst;
+            handler_->onStartObject();
+        }
+        else
+        {
+            state_ = kArrayFirst;
+            handler_->onStartArray();
+        }
+        return p + 1;
+    case '"':
+        return startString(p, e, kStringToken);
+    case 't':
+    case 'f':
+    case 'n':
+        return startScalar(p, e, kLiteralToken);
+    default:
+        if (*p == '-' || isDigit(*p))
+        {
+            return startScalar(p, e, kNumberToken);
+        }
+        error(p, e, "expected json value");
+    }
+}
+
+const char* JsonReader::startString(const char* p, const char* e, Token kind)
+{
+    const char* body = p + 1;
+    const char* q = skipStringChars(body, e);
+    if (LIKELY(q != e && *q == '"'))
+    {
+        // No escapes: hand out the input itself
+        endToken(StringPiece(p, q + 1), kind);
+        return q + 1;
+    }
+    bool escaped = false;
+    q = findStringEnd(q, e, &escaped);
+    if (q == e)
+    {
+        pending_ = kind;
+        escaped_ = escaped;
+        carry_.assign(p, e);
+        return e;
+    }
+    if (*q != '"')
+    {
+        error(q, e, "control character in string");
+    }
+    endToken(StringPiece(p, q + 1), kind);
+    return q + 1;
+}
+
+const char* JsonReader::startScalar(const char* p, const char* e, Token kind)
+{
+    const char* q = p;
+    if (kind == kNumberToken)
+    {
+        while (q != e && isNumberChar(*q)) ++q;
+    }
+    else
+    {
+        while (q != e && isLiteralChar(*q)) ++q;
+    }
+    if (q == e)
+    {
+        pending_ = kind;
+        carry_.assign(p, e);
+        return e;
+    }
+    endToken(StringPiece(p, q), kind);
+    return q;
+}
+
+// Completes the token in carry_ from the start of a new chunk
+const char* JsonReader::resumeToken(const char* p, const char* e)
+{
+    const char* q = p;
+    bool complete;
+    if (pending_ == kStringToken || pending_ == kKeyToken)
+    {
+        q = findStringEnd(p, e, &escaped_);
+        complete = (q != e);
+        if (complete)
+        {
+            if (*q != '"')
+            {
+                error(q, e, "control character in string");
+            }
+            ++q;
+        }
+    }
+    else
+    {
+        const bool number = (pending_ == kNumberToken);
+        while (q != e && (number ? isNumberChar(*q) : isLiteralChar(*q))) ++q;
+        complete = (q != e);
+    }
+    carry_.append(p, q);
+    if (!complete)
+    {
+        return e;
+    }
+    Token kind = pending_;
+    pending_ = kNoToken;
+    endToken(carry_, kind);
+    carry_.clear();
+    return q;
+}
+
+// token is a complete string (with its quotes), number or literal
+void JsonReader::endToken(StringPiece token, Token kind)
+{
+    if (kind == kStringToken || kind == kKeyToken)
+    {
+        StringPiece body(token.begin() + 1, token.end() - 1);
+        dynamic unescaped;
+        if (memchr(body.data(), '\\', body.size()) != nullptr)
+        {
+            unescaped = JsonParser(token, nullptr, line_).parse();
+            body = unescaped.getString();
+        }
+        if (kind == kKeyToken)
+        {
+            state_ = kColon;
+            handler_->onKey(body);
+        }
+        else
+        {
+            handler_->onString(body);
+            endValue();
+        }
+        return;
+    }
+
+    // Numbers and literals are converted exactly as parseJson() does
+    dynamic value = JsonParser(token, nullptr, line_).parse();
+    switch (value.type())
+    {
+    case dynamic::NULLT:
+        handler_->onNull();
+        break;
+    case dynamic::BOOL:
+        handler_->onBool(value.getBool());
+        break;
+    case dynamic::INT64:
+        handler_->onInt(value.getInt());
+        break;
+    default:
+        handler_->onDouble(value.getDouble());
+        break;
+    }
+    endValue();
+}
+
+void JsonReader::endContainer()
+{
+    const char open = containers_.back();
+    containers_.pop_back();
+    if (open == '{')
+    {
+        handler_->onEndObject();
+    }
+    else
+    {
+        handler_->onEndArray();
+    }
+    endValue();
+}
+
+void JsonReader::endValue()
+{
+    if (containers_.empty())
+    {
+        state_ = kAfterTopLevel;
+        handler_->onEndValue();
+    }
+    else
+    {
+        state_ = kAfterValue;
+    }
+}
+
+void JsonReader::error(const char* p, const char* e, const char* what) const
+{
+    throwParseError(line_, StringPiece(p, e), what);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+JsonPathExtractor::JsonPathExtractor(std::vector<dynamic::Path> paths)
+    : paths_(std::move(paths)),
+      values_(paths_.size()),
+      found_(paths_.size()),
+      matched_(paths_.size()),
+      captureDepth_(std::string::npos)
+{
+}
+
+void JsonPathExtractor::onNull()
+{
+    scalar(nullptr);
+}
+
+void JsonPathExtractor::onBool(bool value)
+{
+    scalar(value);
+}
+
+void JsonPathExtractor::onInt(int64_t value)
+{
+    scalar(value);
+}
+
+void JsonPathExtractor::onDouble(double value)
+{
+    scalar(value);
+}
+
+void JsonPathExtractor::onString(StringPiece value)
+{
+    // Skip the copy unless the string is kept
+    beginValue();
+    if (captureDepth_ != std::string::npos)
+    {
+        addToCapture(dynamic(value.data(), value.size()));
+    }
+    endValue();
+}
+
+void JsonPathExtractor::onStartObject()
+{
+    startContainer(dynamic::object);
+}
+
+void JsonPathExtractor::onStartArray()
+{
+    startContainer(dynamic(dynamic::Array()));
+}
+
+void JsonPathExtractor::onEndObject()
+{
+    endContainer();
+}
+
+void JsonPathExtractor::onEndArray()
+{
+    endContainer();
+}
+
+void JsonPathExtractor::onKey(StringPiece key)
+{
+    if (captureDepth_ != std::string::npos)
+    {
+        captureKeys_.push_back(dynamic(key.data(), key.size()));
+        return;
+    }
+    // Select the paths whose next token is this member
+    const size_t depth = frames_.size();
+    for (size_t i = 0; i < paths_.size(); ++i)
+    {
+        if (matched_[i] == depth - 1 && paths_[i].size() >= depth &&
+            paths_[i].matchesKey(depth - 1, key))
+        {
+            matched_[i] = depth;
+        }
+    }
+}
+
+// Called as each value starts, when the location of the value is frames_
+// and, for object members, the key given to onKey()
+void JsonPathExtractor::beginValue()
+{
+    const size_t depth = frames_.size();
+    if (depth == 0)
+    {
+        // A new top-level value
+        values_.assign(paths_.size(), dynamic());
+        found_.assign(paths_.size(), 0);
+        matched_.assign(paths_.size(), 0);
+    }
+    if (captureDepth_ != std::string::npos)
+    {
+        return;
+    }
+    if (depth > 0 && !frames_.back().object)
+    {
+        const size_t index = frames_.back().nextIndex++;
+        for (size_t i = 0; i < paths_.size(); ++i)
+        {
+            if (matched_[i] == depth - 1 && paths_[i].size() >= depth &&
+                paths_[i].matchesIndex(depth - 1, index))
+            {
+                matched_[i] = depth;
+            }
+        }
+    }
+    for (size_t i = 0; i < paths_.size(); ++i)
+    {
+        if (matched_[i] == depth && paths_[i].size() == depth)
+        {
+            captureDepth_ = depth;
+            break;
+        }
+    }
+}
+
+void JsonPathExtractor::endValue()
+{
+    const size_t depth = frames_.size();
+    if (depth == 0)
+    {
+        return;
+    }
+    for (size_t i = 0; i < paths_.size(); ++i)
+    {
+        if (matched_[i] == depth)
+        {
+            matched_[i] = depth - 1;
+        }
+    }
+}
+
+void JsonPathExtractor::scalar(dynamic&& value)
+{
+    beginValue();
+    if (captureDepth_ != std::string::npos)
+    {
+        addToCapture(std::move(value));
+    }
+    endValue();
+}
+
+void JsonPathExtractor::startContainer(dynamic&& container)
+{
+    Frame frame = { container.isObject(), 0 };
+    beginValue();
+    if (captureDepth_ != std::string::npos)
+    {
+        captureStack_.push_back(std::move(container));
+    }
+    frames_.push_back(frame);
+}
+
+void JsonPathExtractor::endContainer()
+{
+    frames_.pop_back();
+    if (captureDepth_ != std::string::npos)
+    {
+        dynamic container = std::move(captureStack_.back());
+        captureStack_.pop_back();
+        addToCapture(std::move(container));
+    }
+    endValue();
+}
+
+void JsonPathExtractor::addToCapture(dynamic&& value)
+{
+    if (!captureStack_.empty())
+    {
+        dynamic& parent = captureStack_.back();
+        if (parent.isObject())
+        {
+            parent.insert(std::move(captureKeys_.back()), std::move(value));
+            captureKeys_.pop_back();
+        }
+        else
+        {
+            parent.push_back(std::move(value));
+        }
+        return;
+    }
+
+    // The captured value is complete: answer every path that led to it,
+    // including those that go further into it
+    const size_t depth = captureDepth_;
+    captureDepth_ = std::string::npos;
+    for (size_t i = 0; i < paths_.size(); ++i)
+    {
+        if (matched_[i] == depth)
+        {
+            if (const dynamic* found = paths_[i].resolve(value, depth))
+            {
+                values_[i] = *found;
+                found_[i] = 1;
+            }
+        }
+    }
+}
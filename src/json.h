@@ -0,0 +1,274 @@
+// Copyright (C) 2015 chenqiang@outlook.com. All rights reserved.
+// Distributed under the terms and conditions of the Apache License.
+// See accompanying files LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Range.h"
+#include "dynamic.h"
+
+
+/**
+ * Thrown by parseJson() on malformed input.  The message gives the line
+ * number and a snippet of the input where parsing stopped.
+ */
+struct JsonParseError : std::runtime_error
+{
+    explicit JsonParseError(const std::string& msg)
+        : std::runtime_error(msg)
+    {
+    }
+};
+
+/**
+ * Parse a complete JSON text (RFC 7159) into a dynamic.
+ *
+ * Any value is accepted at the top level, surrounded by optional
+ * whitespace.  Integers that fit in int64_t become INT64, all other
+ * numbers become DOUBLE.  Strings are unescaped to UTF-8; unpaired
+ * surrogates in \u escapes are rejected.  When an object has duplicate
+ * keys the last one wins.  Nesting deeper than 1024 levels is rejected.
+ *
+ * Throws JsonParseError on malformed input.
+ */
+dynamic parseJson(StringPiece json);
+
+/**
+ * Same as above, but the strings, arrays and objects of the result are
+ * allocated from the given arena instead of the heap; see the arena
+ * section of dynamic.h.  The arena must outlive the result, which is
+ * read-only.  Parsing into an arena makes many small documents or one
+ * large document much cheaper to build and to release.
+ */
+dynamic parseJson(StringPiece json, Arena* arena);
+
+/**
+ * Options for serializeJson().  The defaults produce compact, strict JSON.
+ */
+struct JsonSerializationOpts
+{
+    JsonSerializationOpts()
+        : prettyFormatting(false),
+          sortKeys(false),
+          allowNonStringKeys(false),
+          allowNanInf(false)
+    {
+    }
+
+    // Put each member and element on its own line, indented by two spaces
+    // per level, with a space after ':'
+    bool prettyFormatting;
+
+    // Emit object members sorted by key instead of in container order
+    bool sortKeys;
+
+    // Write non-string object keys as their JSON value instead of throwing
+    // dynamic::TypeError.  The output is then not valid JSON.
+    bool allowNonStringKeys;
+
+    // Write NaN and infinities as NaN, Infinity and -Infinity instead of
+    // throwing std::invalid_argument.  The output is then not valid JSON.
+    bool allowNanInf;
+};
+
+/**
+ * Append the JSON text of a dynamic to *out.
+ *
+ * Strings are escaped as required by RFC 7159 ('"', '\\' and control
+ * characters); other bytes, including UTF-8 sequences, are copied as is.
+ * Doubles are written in the shortest form that parses back to the same
+ * value, and always with a '.' or exponent so they stay doubles.
+ */
+void serializeJson(const dynamic& value, std::string* out,
+                   const JsonSerializationOpts& opts = JsonSerializationOpts());
+
+/**
+ * Shorthands for serializeJson() with the default options, and with
+ * prettyFormatting set.
+ */
+std::string toJson(const dynamic& value);
+std::string toPrettyJson(const dynamic& value);
+
+/**
+ * Receives the events of a JsonReader.  Override the ones of interest;
+ * the others do nothing.
+ *
+ * The StringPiece given to onKey() and onString() is only valid during
+ * the call.  When the string has no escapes and lies within one chunk, it
+ * points directly into the input.
+ */
+class JsonHandler
+{
+public:
+    virtual ~JsonHandler() {}
+
+    virtual void onNull() {}
+    virtual void onBool(bool /* value */) {}
+    virtual void onInt(int64_t /* value */) {}
+    virtual void onDouble(double /* value */) {}
+    virtual void onString(StringPiece /* value */) {}
+
+    virtual void onStartObject() {}
+    virtual void onKey(StringPiece /* key */) {}
+    virtual void onEndObject() {}
+    virtual void onStartArray() {}
+    virtual void onEndArray() {}
+
+    // After each complete top-level value
+    virtual void onEndValue() {}
+};
+
+/**
+ * Incremental, event-driven JSON reader.
+ *
+ * Input is given in chunks of any size, as they come from a read() loop;
+ * a token cut by the end of a chunk is completed from the next one.  The
+ * input may hold any number of top-level values separated by whitespace,
+ * such as newline-delimited JSON, and no tree is ever built.  Values are
+ * accepted and converted exactly as by parseJson().
+ *
+ *   JsonReader reader(&handler);
+ *   while ((n = read(fd, buf, sizeof(buf))) > 0)
+ *   {
+ *       reader.feed(StringPiece(buf, n));
+ *   }
+ *   reader.finish();
+ *
+ * feed() and finish() throw JsonParseError on malformed input, after which
+ * the reader must be reset() before it is used again.  Exceptions thrown
+ * by the handler propagate the same way.
+ */
+class JsonReader
+{
+public:
+    explicit JsonReader(JsonHandler* handler);
+
+    /*
+     * Process the next chunk of input, calling the handler for every
+     * event it completes.  The chunk need not outlive the call.
+     */
+    void feed(StringPiece chunk);
+
+    /*
+     * Signal the end of input.  Completes a trailing number, and throws
+     * if the input stops inside a value.  The reader is then ready for a
+     * new stream.
+     */
+    void finish();
+
+    /*
+     * Forget any partial input.
+     */
+    void reset();
+
+    /*
+     * Number of objects and arrays currently open.
+     */
+    size_t depth() const { return containers_.size(); }
+
+private:
+    enum State
+    {
+        kValue,
+        kArrayFirst,        // a value or ']' after '['
+        kObjectFirst,       // a key or '}' after '{'
+        kKey,               // a key after ','
+        kColon,
+        kAfterValue,        // ',' or the end of the enclosing container
+        kAfterTopLevel,     // whitespace before the next top-level value
+    };
+
+    enum Token
+    {
+        kNoToken,
+        kStringToken,
+        kKeyToken,
+        kNumberToken,
+        kLiteralToken,
+    };
+
+    const char* startValue(const char* p, const char* e);
+    const char* startString(const char* p, const char* e, Token kind);
+    const char* startScalar(const char* p, const char* e, Token kind);
+    const char* resumeToken(const char* p, const char* e);
+    void endToken(StringPiece token, Token kind);
+    void endContainer();
+    void endValue();
+    FOLLY_NORETURN void error(const char* p, const char* e,
+                              const char* what) const;
+
+    JsonHandler*        handler_;
+    State               state_;
+    Token               pending_;       // token cut by the end of a chunk
+    bool                escaped_;       // pending string ends inside an escape
+    size_t              line_;
+    std::string         carry_;         // start of the pending token
+    std::vector<char>   containers_;    // '{' or '[' for each open one
+};
+
+/**
+ * A JsonHandler that picks out the values at a set of JSON Pointers from
+ * the events of a JsonReader, building a dynamic only for those subtrees.
+ *
+ *   struct Handler : JsonPathExtractor
+ *   {
+ *       Handler() : JsonPathExtractor({ dynamic::Path("/user/id") }) {}
+ *       void onEndValue() override { use(values()[0]); }
+ *   };
+ *
+ * values() and found() describe the last complete top-level value; with a
+ * stream of values, override onEndValue() to consume them for each one.
+ * Paths may overlap, and a path into an array or object that is being
+ * extracted anyway is answered from the extracted value.
+ */
+class JsonPathExtractor : public JsonHandler
+{
+public:
+    explicit JsonPathExtractor(std::vector<dynamic::Path> paths);
+
+    /*
+     * One value per path, null where found() is false.
+     */
+    const std::vector<dynamic>& values() const { return values_; }
+    bool found(size_t i) const { return found_[i] != 0; }
+
+    void onNull() override;
+    void onBool(bool value) override;
+    void onInt(int64_t value) override;
+    void onDouble(double value) override;
+    void onString(StringPiece value) override;
+    void onStartObject() override;
+    void onKey(StringPiece key) override;
+    void onEndObject() override;
+    void onStartArray() override;
+    void onEndArray() override;
+
+private:
+    struct Frame
+    {
+        bool    object;
+        size_t  nextIndex;      // of the next array element
+    };
+
+    void beginValue();
+    void endValue();
+    void scalar(dynamic&& value);
+    void startContainer(dynamic&& container);
+    void endContainer();
+    void addToCapture(dynamic&& value);
+
+    std::vector<dynamic::Path>  paths_;
+    std::vector<dynamic>        values_;
+    std::vector<char>           found_;
+    std::vector<size_t>         matched_;   // leading tokens of each path
+                                            // matching the current location
+    std::vector<Frame>          frames_;    // open containers
+    size_t                      captureDepth_;  // or npos if not capturing
+    std::vector<dynamic>        captureStack_;  // open containers in capture
+    std::vector<dynamic>        captureKeys_;
+};
+
@@ -16,8 +16,12 @@
 
 #include "Conv.h"
 #include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
 #include <limits>
 #include <stdexcept>
+#include <vector>
+#include "Benchmark.h"
 
 using namespace std;
 
@@ -368,6 +372,55 @@ TEST(Conv, StringPieceAppend)
   }
 }
 
+TEST(Conv, LongDigitStrings)
+{
+    // Every length, so each mix of eight, four and single digit steps runs
+    string digits;
+    uint64_t expected = 0;
+    for (int i = 1; i <= 20; ++i)
+    {
+        char digit = static_cast<char>('0' + (i * 7) % 10);
+        if (i == 20)
+        {
+            digit = '1';
+            digits = "1844674407370955161";
+            expected = 1844674407370955161ULL;
+        }
+        digits += digit;
+        expected = expected * 10 + (digit - '0');
+        EXPECT_EQ(expected, to<uint64_t>(digits)) << digits;
+        string followed = digits + "x123456789";
+        StringPiece pc(followed);
+        EXPECT_EQ(expected, to<uint64_t>(&pc)) << digits;
+        EXPECT_EQ("x123456789", pc);
+    }
+
+    EXPECT_EQ(18446744073709551615ULL, to<uint64_t>("18446744073709551615"));
+    EXPECT_EQ(4294967295U, to<uint32_t>("00000000004294967295"));
+    EXPECT_EQ(12345678U, to<uint32_t>("12345678"));
+    EXPECT_EQ(-1234567890123456789LL, to<int64_t>("-1234567890123456789"));
+
+    // Overflow is reported as before
+    const char* const overflows[] = {
+        "18446744073709551616", "99999999999999999999", "123456789012345678901",
+    };
+    for (auto overflow : overflows)
+    {
+        try
+        {
+            to<uint64_t>(overflow);
+            ADD_FAILURE() << overflow;
+        }
+        catch (const std::range_error& e)
+        {
+            EXPECT_NE(nullptr, strstr(e.what(), "Numeric overflow upon conversion"));
+        }
+    }
+    EXPECT_THROW(to<uint32_t>("4294967296"), std::range_error);
+    EXPECT_THROW(to<uint64_t>("12345678x9"), std::range_error);
+    EXPECT_THROW(to<uint64_t>("1234567\x80" "9"), std::range_error);
+}
+
 TEST(Conv, BadStringToIntegral) 
 {
     // Note that leading spaces (e.g.  " 1") are valid.
@@ -397,6 +450,51 @@ void testVariadicTo()
     EXPECT_EQ(s, "Lorem ipsum 1234 dolor amet 567.89.");
 }
 
+TEST(Conv, AppendDelimited)
+{
+    const int64_t values[] = {
+        0, -1, 9, 10, -99, 100, 12345678, -1234567890123456789LL,
+        numeric_limits<int64_t>::max(), numeric_limits<int64_t>::min(),
+    };
+    string expected;
+    for (auto value : values)
+    {
+        toAppend(&expected, expected.empty() ? "" : ", ", value);
+    }
+    string s = "row: ";
+    toAppendDelimited(&s, ", ", begin(values), end(values));
+    EXPECT_EQ("row: " + expected, s);
+
+    const uint64_t big[] = { 18446744073709551615ULL, 10000000000000000000ULL };
+    s.clear();
+    toAppendDelimited(&s, "\t", begin(big), end(big));
+    EXPECT_EQ("18446744073709551615\t10000000000000000000", s);
+
+    const int8_t small[] = { -128, 127, 0 };
+    s.clear();
+    toAppendDelimited(&s, "", begin(small), end(small));
+    EXPECT_EQ("-1281270", s);
+
+    s = "unchanged";
+    toAppendDelimited(&s, ",", small, small);
+    EXPECT_EQ("unchanged", s);
+
+    // Every power of ten and its neighbours
+    std::vector<uint64_t> edges;
+    expected.clear();
+    for (uint64_t p = 1; p <= 1000000000000000000ULL; p *= 10)
+    {
+        for (uint64_t v : { p - 1, p, p + 1, p * 9 })
+        {
+            edges.push_back(v);
+            toAppend(&expected, expected.empty() ? "" : ";", v);
+        }
+    }
+    s.clear();
+    toAppendDelimited(&s, ";", edges.data(), edges.data() + edges.size());
+    EXPECT_EQ(expected, s);
+}
+
 TEST(Conv, NullString) 
 {
     string s1 = to<string>((char *) nullptr);
@@ -409,12 +507,193 @@ TEST(Conv, VariadicTo)
     testVariadicTo<string>();
 }
 
+TEST(Conv, EstimateSpaceNeeded)
+{
+    // Exact for integers and strings
+    const int64_t ints[] = {
+        0, 7, -7, 10, -10, 99999, -100000, numeric_limits<int64_t>::max(),
+        numeric_limits<int64_t>::min(),
+    };
+    for (auto value : ints)
+    {
+        EXPECT_EQ(to<string>(value).size(), estimateSpaceNeeded(value));
+    }
+    EXPECT_EQ(20, estimateSpaceNeeded(numeric_limits<uint64_t>::max()));
+    EXPECT_EQ(4, estimateSpaceNeeded(static_cast<int8_t>(-128)));
+    EXPECT_EQ(3, estimateSpaceNeeded("abc"));
+    EXPECT_EQ(0, estimateSpaceNeeded(static_cast<const char*>(nullptr)));
+    EXPECT_EQ(5, estimateSpaceNeeded(string("hello")));
+    EXPECT_EQ(1, estimateSpaceNeeded('x'));
+
+    // A bound for floating point
+    const double doubles[] = {
+        -1.2345678901234567e-300, -0.0000012345678901234567, -1e21,
+        -123456789012345678901.0, 5e-324, -numeric_limits<double>::infinity(),
+    };
+    for (auto value : doubles)
+    {
+        EXPECT_LE(to<string>(value).size(), estimateSpaceNeeded(value));
+    }
+
+    // Everything is reserved up front
+    string s = to<string>("key:", 1234567, ':', string(40, 'x'), ':', -2.5);
+    EXPECT_EQ("key:1234567:" + string(40, 'x') + ":-2.5", s);
+    EXPECT_LE(4 + 7 + 1 + 40 + 1 + 25, s.capacity());
+}
+
+namespace {
+
+// The minimal sink: only append()
+struct VectorSink
+{
+    void append(const char* data, size_t size)
+    {
+        chars.insert(chars.end(), data, data + size);
+    }
+
+    vector<char> chars;
+};
+
+} // anonymous namespace
+
+TEST(Conv, AppendToBuffer)
+{
+    char buffer[32];
+    BufferAppender out(buffer);
+    EXPECT_EQ(32, out.capacity());
+    toAppend(&out, "id=", -1234567, ' ', 2.5f, ',', u8, ',', string("abc"));
+    EXPECT_FALSE(out.overflowed());
+    EXPECT_EQ("id=-1234567 2.5,0,abc", out.str());
+    EXPECT_EQ(buffer, out.data());
+
+    // Cut off at the end, as by snprintf
+    out.clear();
+    toAppend(&out, string(30, 'x'), 12345);
+    EXPECT_TRUE(out.overflowed());
+    EXPECT_EQ(string(30, 'x') + "12", out.str());
+    toAppend(&out, 'y');
+    EXPECT_EQ(32, out.size());
+
+    out.clear();
+    toAppend(&out, numeric_limits<int64_t>::min(), -1e300);
+    EXPECT_FALSE(out.overflowed());
+    EXPECT_EQ("-9223372036854775808-1e+300", out.str());
+
+    // Into a MutableStringPiece, which advances past what was written
+    char storage[15];
+    MutableStringPiece space(storage, sizeof(storage));
+    EXPECT_TRUE(toAppend(&space, "a=", 1, ';'));
+    EXPECT_TRUE(toAppend(&space, "bc=", -2.5, ';'));
+    EXPECT_EQ(storage + 12, space.begin());
+    EXPECT_FALSE(toAppend(&space, "d=", 12345));
+    EXPECT_EQ(storage + 12, space.begin());
+    EXPECT_TRUE(toAppend(&space, "d=", 1));
+    EXPECT_TRUE(space.empty());
+    EXPECT_TRUE(toAppend(&space));
+    EXPECT_FALSE(toAppend(&space, 'x'));
+    EXPECT_EQ("a=1;bc=-2.5;d=1", string(storage, 15));
+
+    // Any type with append(const char*, size_t)
+    VectorSink sink;
+    toAppend(&sink, 'k', static_cast<const char*>(nullptr), StringPiece("=v"),
+             static_cast<int16_t>(-7), 0.1, true);
+    EXPECT_EQ("k=v-70.11", string(sink.chars.begin(), sink.chars.end()));
+}
+
 TEST(Conv, DoubleToString) 
 {
     EXPECT_EQ(to<string>(0.0), "0.0");
     EXPECT_EQ(to<string>(0.5), "0.5");
     EXPECT_EQ(to<string>(10.25), "10.25");
     EXPECT_EQ(to<string>(1.123e10), "11230000000.0");
+
+    // Shortest digits that read back, plain notation for exponents in
+    // [-6, 21)
+    EXPECT_EQ(to<string>(0.1), "0.1");
+    EXPECT_EQ(to<string>(0.1 + 0.2), "0.30000000000000004");
+    EXPECT_EQ(to<string>(-0.0), "-0.0");
+    EXPECT_EQ(to<string>(123456.789), "123456.789");
+    EXPECT_EQ(to<string>(1e20), "100000000000000000000.0");
+    EXPECT_EQ(to<string>(1e21), "1e+21");
+    EXPECT_EQ(to<string>(1e-6), "0.000001");
+    EXPECT_EQ(to<string>(1.5e-7), "1.5e-7");
+    EXPECT_EQ(to<string>(-1.7976931348623157e308), "-1.7976931348623157e+308");
+    EXPECT_EQ(to<string>(5e-324), "5e-324");
+    EXPECT_EQ(to<string>(numeric_limits<double>::infinity()), "inf");
+    EXPECT_EQ(to<string>(-numeric_limits<double>::infinity()), "-inf");
+    EXPECT_EQ(to<string>(numeric_limits<double>::quiet_NaN()), "nan");
+
+    // Floats get the shortest digits of the float
+    EXPECT_EQ(to<string>(4.2f), "4.2");
+    EXPECT_EQ(to<string>(-0.168f), "-0.168");
+    EXPECT_EQ(to<string>(numeric_limits<float>::max()), "3.4028235e+38");
+
+    // Every value reads back
+    uint64_t bits = 0x123456789ABCDEFULL;
+    for (int i = 0; i < 100000; ++i)
+    {
+        bits = bits * 6364136223846793005ULL + 1442695040888963407ULL;
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (std::isfinite(value))
+        {
+            EXPECT_EQ(value, strtod(to<string>(value).c_str(), nullptr));
+        }
+    }
+}
+
+TEST(Conv, DoubleToStringModes)
+{
+    auto fixed = [](double value, unsigned numDigits) {
+        string s;
+        toAppend(value, &s, DtoaMode::FIXED, numDigits);
+        return s;
+    };
+    auto exponent = [](double value, unsigned numDigits) {
+        string s;
+        toAppend(value, &s, DtoaMode::EXPONENT, numDigits);
+        return s;
+    };
+
+    EXPECT_EQ("3", fixed(3.14159, 0));
+    EXPECT_EQ("3.14", fixed(3.14159, 2));
+    EXPECT_EQ("3.14159000", fixed(3.14159, 8));
+    EXPECT_EQ("-0.00", fixed(-0.001, 2));
+    EXPECT_EQ("0.00", fixed(0.004, 2));
+    EXPECT_EQ("1.00", fixed(0.999, 2));
+    EXPECT_EQ("100.0", fixed(99.96, 1));
+    EXPECT_EQ("1000000000000000000000000", fixed(1e24, 0));
+    EXPECT_EQ("0.10000000000000000000", fixed(0.1, 20));
+
+    // Ties in the shortest digits are rounded as the exact value is
+    EXPECT_EQ("2.67", fixed(2.675, 2));     // 2.67499999999999982236431605997495353221893310546875
+    EXPECT_EQ("0.01", fixed(0.005, 2));     // 0.005000000000000000104083408558608425664715468883514404296875
+    EXPECT_EQ("0", fixed(0.5, 0));
+    EXPECT_EQ("2", fixed(1.5, 0));
+
+    EXPECT_EQ("3e+00", exponent(3.14159, 0));
+    EXPECT_EQ("3.142e+00", exponent(3.14159, 3));
+    EXPECT_EQ("1.00e+03", exponent(999.9, 2));
+    EXPECT_EQ("1.5e-07", exponent(1.5e-7, 1));
+    EXPECT_EQ("1.2e+22", exponent(1.2e22, 1));
+    EXPECT_EQ("-2.50000e-300", exponent(-2.5e-300, 5));
+    EXPECT_EQ("0.0e+00", exponent(0.0, 1));
+    EXPECT_EQ("inf", exponent(numeric_limits<double>::infinity(), 3));
+
+    // Against printf, for values short enough that their shortest digits
+    // are exact
+    char buffer[64];
+    uint64_t bits = 0xFEDCBA9876543210ULL;
+    for (int i = 0; i < 10000; ++i)
+    {
+        bits = bits * 6364136223846793005ULL + 1442695040888963407ULL;
+        double value = static_cast<double>(bits >> 44) / (1 << (bits % 9));
+        unsigned numDigits = (bits >> 8) % 10;
+        snprintf(buffer, sizeof(buffer), "%.*f", numDigits, value);
+        EXPECT_EQ(buffer, fixed(value, numDigits));
+        snprintf(buffer, sizeof(buffer), "%.*e", numDigits, value);
+        EXPECT_EQ(buffer, exponent(value, numDigits));
+    }
 }
 
 TEST(Conv, StringPieceToDouble) 
@@ -446,6 +725,65 @@ TEST(Conv, StringPieceToDouble)
     EXPECT_THROW(to<double>("-infinitX"), std::range_error);
 }
 
+TEST(Conv, StringToDoubleExact)
+{
+    // Only the given range is read
+    string s = "1.5e3";
+    EXPECT_EQ(1.5, to<double>(StringPiece(s.data(), 3)));
+    StringPiece pc(s.data(), 4);
+    EXPECT_EQ(1.5, to<double>(&pc));
+    EXPECT_EQ("e", pc);
+
+    EXPECT_EQ(0.1, to<double>("0.1"));
+    EXPECT_EQ(-250.0, to<double>("-2.5e+2"));
+    EXPECT_EQ(0.5, to<double>(".5"));
+    EXPECT_EQ(7.0, to<double>("+7."));
+    EXPECT_EQ(0.0, to<double>("0e99999999999999999999"));
+    EXPECT_TRUE(std::signbit(to<double>("-0.0")));
+    EXPECT_EQ(1.7976931348623157e308, to<double>("1.7976931348623157e308"));
+    EXPECT_EQ(numeric_limits<double>::infinity(), to<double>("1.8e308"));
+    EXPECT_EQ(numeric_limits<double>::denorm_min(),
+              to<double>("4.9406564584124654e-324"));
+    EXPECT_EQ(0.0, to<double>("2.4703282292062327e-324"));
+    EXPECT_EQ(numeric_limits<double>::denorm_min(),
+              to<double>("2.4703282292062328e-324"));
+    EXPECT_EQ(2.225073858507201e-308, to<double>("2.2250738585072011e-308"));
+
+    // Halfway between two doubles rounds to even; any digit past it, even
+    // beyond the 19th, decides
+    EXPECT_EQ(9007199254740992.0, to<double>("9007199254740993"));
+    EXPECT_EQ(9007199254740994.0, to<double>("9007199254740993.0000000001"));
+    EXPECT_EQ(1.0, to<double>(
+        "1.00000000000000011102230246251565404236316680908203125"));
+    EXPECT_EQ(1.0000000000000002, to<double>(
+        "1.000000000000000111022302462515654042363166809082031250001"));
+    EXPECT_EQ(1.2345678901234568e29,
+              to<double>("123456789012345678901234567890"));
+    EXPECT_EQ(1.5, to<double>(
+        "0000000000000000000000000000000000000000000000000000000001.5"));
+
+    // An exponent without digits isn't one
+    pc = "1e+x";
+    EXPECT_EQ(1.0, to<double>(&pc));
+    EXPECT_EQ("e+x", pc);
+
+    // Against strtod
+    char buffer[64];
+    uint64_t bits = 0x0123456789ABCDEFULL;
+    for (int i = 0; i < 100000; ++i)
+    {
+        bits = bits * 6364136223846793005ULL + 1442695040888963407ULL;
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!std::isfinite(value))
+        {
+            continue;
+        }
+        snprintf(buffer, sizeof(buffer), "%.*e", int(bits % 20), value);
+        EXPECT_EQ(strtod(buffer, nullptr), to<double>(buffer)) << buffer;
+    }
+}
+
 TEST(Conv, EmptyStringToInt) 
 {
     string s = "";
@@ -723,3 +1061,182 @@ TEST(Conv, NewUint64ToString) {
 
 #undef THE_GREAT_EXPECTATIONS
 }
+
+BENCHMARK(to_string_double, iters)
+{
+    double value = 0.25;
+    for (size_t i = 0; i < iters; ++i)
+    {
+        string s;
+        toAppend(&s, value);
+        doNotOptimizeAway(s.size());
+        value += 1.0 / 3;
+    }
+}
+
+BENCHMARK(snprintf_double, iters)
+{
+    double value = 0.25;
+    for (size_t i = 0; i < iters; ++i)
+    {
+        char buffer[32];
+        doNotOptimizeAway(snprintf(buffer, sizeof(buffer), "%.17g", value));
+        value += 1.0 / 3;
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+namespace {
+
+const char* const kDoubleStrings[] = {
+    "0.25", "3.14159", "-1234.5678", "6.02214076e23", "1.0000000000000002",
+    "0.000123", "42", "2.2250738585072014e-308",
+};
+
+} // anonymous namespace
+
+BENCHMARK(to_double, iters)
+{
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(to<double>(kDoubleStrings[i % 8]));
+    }
+}
+
+BENCHMARK(strtod_double, iters)
+{
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(strtod(kDoubleStrings[i % 8], nullptr));
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+namespace {
+
+// Converts a StringPiece of the given length, as IDs are
+void benchmarkDigits(size_t iters, StringPiece digits)
+{
+    for (size_t i = 0; i < iters; ++i)
+    {
+        StringPiece pc(digits);
+        doNotOptimizeAway(to<uint64_t>(&pc));
+    }
+}
+
+} // anonymous namespace
+
+BENCHMARK(to_uint64_1_digit, iters)
+{
+    benchmarkDigits(iters, "7");
+}
+
+BENCHMARK(to_uint64_5_digits, iters)
+{
+    benchmarkDigits(iters, "73095");
+}
+
+BENCHMARK(to_uint64_10_digits, iters)
+{
+    benchmarkDigits(iters, "7309521846");
+}
+
+BENCHMARK(to_uint64_16_digits, iters)
+{
+    benchmarkDigits(iters, "7309521846613028");
+}
+
+BENCHMARK(to_uint64_19_digits, iters)
+{
+    benchmarkDigits(iters, "7309521846613028475");
+}
+
+BENCHMARK(to_uint64_20_digits, iters)
+{
+    benchmarkDigits(iters, "17309521846613028475");
+}
+
+BENCHMARK_DRAW_LINE();
+
+namespace {
+
+std::vector<int64_t> makeColumn()
+{
+    std::vector<int64_t> column;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < 1000; ++i)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        // Mixed magnitudes, as in real data
+        column.push_back(static_cast<int64_t>(seed >> (seed % 60)) - 1000);
+    }
+    return column;
+}
+
+} // anonymous namespace
+
+BENCHMARK(to_append_1000_integers, iters)
+{
+    std::vector<int64_t> column;
+    BENCHMARK_SUSPEND
+    {
+        column = makeColumn();
+    }
+    for (size_t i = 0; i < iters; ++i)
+    {
+        string s;
+        for (size_t j = 0; j < column.size(); ++j)
+        {
+            if (j != 0)
+            {
+                s.push_back(',');
+            }
+            toAppend(&s, column[j]);
+        }
+        doNotOptimizeAway(s.size());
+    }
+}
+
+BENCHMARK(to_append_delimited_1000_integers, iters)
+{
+    std::vector<int64_t> column;
+    BENCHMARK_SUSPEND
+    {
+        column = makeColumn();
+    }
+    for (size_t i = 0; i < iters; ++i)
+    {
+        string s;
+        toAppendDelimited(&s, ",", column.data(), column.data() + column.size());
+        doNotOptimizeAway(s.size());
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(to_string_variadic, iters)
+{
+    const string name = "request_handler.latency_histogram";
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(to<string>(
+            "metric=", name, " host=", "web-0042.example.com", " shard=",
+            i, " value=", 0.25, " time=", 1420070400123456ULL).size());
+    }
+}
+
+BENCHMARK(to_buffer_variadic, iters)
+{
+    const string name = "request_handler.latency_histogram";
+    char buffer[256];
+    for (size_t i = 0; i < iters; ++i)
+    {
+        BufferAppender out(buffer);
+        toAppend(&out,
+            "metric=", name, " host=", "web-0042.example.com", " shard=",
+            i, " value=", 0.25, " time=", 1420070400123456ULL);
+        doNotOptimizeAway(out.size());
+    }
+}
@@ -26,6 +26,19 @@ TEST(CpuId, Simple)
     EXPECT_TRUE(id.mmx());
 }
 
+TEST(CpuId, OsSupport)
+{
+    // The OS saving ZMM state implies it saves YMM state, and neither is
+    // known without OSXSAVE
+    CpuId id;
+    if (id.osSupportsAvx512()) {
+        EXPECT_TRUE(id.osSupportsAvx());
+    }
+    if (!id.osxsave()) {
+        EXPECT_FALSE(id.osSupportsAvx());
+    }
+}
+
 TEST(CpuId, Output)
 {
     CpuId id;
@@ -118,6 +131,8 @@ TEST(CpuId, Output)
     OUTPUT(avx512vl);
     OUTPUT(prefetchwt1);
     OUTPUT(avx512vbmi);
+    OUTPUT(osSupportsAvx);
+    OUTPUT(osSupportsAvx512);
 #undef OUTPUT
 #undef FN 
 }
\ No newline at end of file
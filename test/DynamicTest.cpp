@@ -1,7 +1,10 @@
 #include "dynamic.h"
+#include "Arena.h"
 #include <limits.h>
 #include <iostream>
+#include <map>
 #include <gtest/gtest.h>
+#include "Benchmark.h"
 
 using std::string;
 
@@ -70,6 +73,43 @@ TEST(dynamic, string)
     EXPECT_EQ(s2, text);
 }
 
+TEST(dynamic, InlineStrings)
+{
+    EXPECT_LE(sizeof(dynamic), 24);
+
+    // Around the inline size limit, with embedded NULs
+    string text("0123456789\0abcdefghijklmnop", 27);
+    for (size_t len = 0; len < text.size(); ++len)
+    {
+        string s = text.substr(0, len);
+        dynamic d(s);
+        EXPECT_EQ(len, d.size());
+        EXPECT_EQ(StringPiece(s), d.getString());
+
+        dynamic copy = d;
+        dynamic moved = std::move(d);
+        EXPECT_TRUE(d.isNull());
+        EXPECT_EQ(StringPiece(s), copy.getString());
+        EXPECT_EQ(StringPiece(s), moved.getString());
+
+        moved = 1;
+        copy = copy;
+        EXPECT_EQ(StringPiece(s), copy.getString());
+        copy = dynamic(string(s));
+        EXPECT_EQ(s, copy.as<string>());
+    }
+
+    dynamic array = { "a", "bb", "ccc" };
+    for (int i = 0; i < 100; ++i)
+    {
+        array.push_back(to<string>(i));
+    }
+    EXPECT_EQ("ccc", array.at(2).getString());
+    EXPECT_EQ("99", array.at(102).getString());
+    EXPECT_TRUE(dynamic("a") < dynamic("b"));
+    EXPECT_FALSE(dynamic("b") < dynamic("a"));
+}
+
 TEST(dynamic, array)
 {
     dynamic array1 = {10, 20, 30};
@@ -115,11 +155,352 @@ TEST(dynamic, object)
     EXPECT_TRUE(obj["key3"].isString());
 
     auto s = obj.dump();
-    EXPECT_EQ(s, "{\"key1\":1024,\"key2\":false,\"key3\":bonjour}");
+    EXPECT_EQ(s, "{\"key1\":1024,\"key2\":false,\"key3\":\"bonjour\"}");
 
     for (const auto& item : obj)
     {
         const string& key = item.first;
         EXPECT_EQ(key.substr(2), "key");
     }
-}
\ No newline at end of file
+}
+
+TEST(dynamic, ObjectOrderAndLookup)
+{
+    // Grow well past the unindexed size so the hash index gets rebuilt
+    // several times
+    dynamic obj = dynamic::object;
+    for (int i = 0; i < 5000; ++i)
+    {
+        obj[to<string>("k", 4999 - i)] = i;
+    }
+    EXPECT_EQ(5000, obj.size());
+
+    int expected = 0;
+    for (const auto& item : obj)
+    {
+        EXPECT_EQ(to<string>("k", 4999 - expected), item.first.getString());
+        EXPECT_EQ(expected, item.second.getInt());
+        ++expected;
+    }
+
+    for (int i = 0; i < 5000; ++i)
+    {
+        string key = to<string>("k", i);
+        StringPiece piece(key);
+        ASSERT_TRUE(obj.contains(piece));
+        EXPECT_EQ(4999 - i, obj[piece].getInt());
+        EXPECT_EQ(4999 - i, obj.get_ptr(piece)->getInt());
+    }
+    EXPECT_FALSE(obj.contains(StringPiece("k5000")));
+    EXPECT_EQ(nullptr, obj.get_ptr(StringPiece("k")));
+
+    // Assigning to an existing key keeps its position
+    obj["k4999"] = "first";
+    EXPECT_EQ("first", obj.begin()->second.getString());
+    EXPECT_EQ(5000, obj.size());
+
+    const dynamic copy = obj;
+    EXPECT_FALSE(obj < copy || copy < obj);
+    EXPECT_THROW(copy[StringPiece("missing")], std::out_of_range);
+}
+
+TEST(dynamic, ObjectKeyTypes)
+{
+    // Keys of different types never compare equal, even when they print
+    // the same
+    dynamic obj = dynamic::object;
+    obj.insert(1, "int");
+    obj.insert("1", "string");
+    obj.insert(1.0, "double");
+    obj.insert(true, "bool");
+    obj.insert(nullptr, "null");
+    for (int i = 0; i < 20; ++i)
+    {
+        obj.insert(i + 100, i);
+    }
+    EXPECT_EQ(25, obj.size());
+    EXPECT_EQ("string", obj[StringPiece("1")].getString());
+
+    obj.insert(1, "int again");
+    obj.insert(119, "last");
+    EXPECT_EQ(25, obj.size());
+    auto it = obj.begin();
+    EXPECT_EQ(1, it->first.getInt());
+    EXPECT_EQ("int again", it->second.getString());
+    EXPECT_EQ("1", (++it)->first.getString());
+    EXPECT_EQ(1.0, (++it)->first.getDouble());
+    EXPECT_EQ("last", (obj.end() - 1)->second.getString());
+
+    // 0.0 and -0.0 are one key, in small objects and in hashed ones
+    for (int extra : { 0, 64 })
+    {
+        dynamic doubles = dynamic::object;
+        for (int i = 0; i < extra; ++i)
+        {
+            doubles.insert(i + 0.5, i);
+        }
+        doubles.insert(0.0, "zero");
+        doubles.insert(-0.0, "negative zero");
+        EXPECT_EQ(extra + 1, doubles.size());
+        EXPECT_EQ("negative zero", (doubles.end() - 1)->second.getString());
+    }
+
+    // Only string keys are visible to StringPiece lookup
+    dynamic ints = dynamic::object;
+    ints.insert(1, "one");
+    EXPECT_FALSE(ints.contains(StringPiece("1")));
+}
+
+TEST(dynamic, Arena)
+{
+    dynamic source = dynamic::object;
+    source["name"] = "a string long enough not to fit in any inline buffer";
+    source["list"] = dynamic{ 1, 2.5, "three", nullptr, dynamic{ true } };
+    source["nested"] = dynamic::object;
+    source["nested"]["k"] = "v";
+
+    Arena arena(128);
+    dynamic d = dynamic::copyToArena(source, &arena);
+    EXPECT_TRUE(d.isInArena());
+    EXPECT_TRUE(d[StringPiece("name")].isInArena());
+    EXPECT_EQ(source.dump(), d.dump());
+    EXPECT_EQ(source[StringPiece("name")].getString(),
+        d[StringPiece("name")].getString());
+    EXPECT_EQ("three", d[StringPiece("list")].at(2).getString());
+    EXPECT_THROW(d[StringPiece("list")].at(5), std::out_of_range);
+    EXPECT_TRUE(d.contains(StringPiece("nested")));
+    EXPECT_FALSE(d < source || source < d);
+
+    // Read-only
+    EXPECT_THROW(d[StringPiece("list")].push_back(4), std::logic_error);
+    EXPECT_THROW(d.insert("x", 1), std::logic_error);
+    EXPECT_THROW(d[StringPiece("missing")], std::logic_error);
+
+    // Moving keeps the arena storage, copying leaves it
+    dynamic moved = std::move(d);
+    EXPECT_TRUE(moved.isInArena());
+    dynamic copy = moved;
+    EXPECT_FALSE(copy.isInArena());
+    copy[StringPiece("list")].push_back(4);
+    EXPECT_EQ(6, copy[StringPiece("list")].size());
+
+    // Heap values given to the builders are copied in
+    std::pair<dynamic, dynamic> members[] = {
+        std::make_pair(dynamic("k1"), source),
+        std::make_pair(dynamic("k2"), dynamic(2)),
+        std::make_pair(dynamic("k1"), dynamic("replaced")),
+    };
+    dynamic obj = dynamic::arenaObject(members, 3, &arena);
+    EXPECT_EQ(2, obj.size());
+    EXPECT_EQ("replaced", obj[StringPiece("k1")].getString());
+    EXPECT_FALSE(obj.begin()->first.isInArena());   // inline
+
+    // Elements and members are never destroyed, so they take scalars,
+    // inline strings and arena values, but nothing they would have to free
+    dynamic doc = dynamic::copyToArena(
+        dynamic{ 1, source[StringPiece("nested")] }, &arena);
+    EXPECT_THROW(doc.at(0) = string(200, 'x'), std::logic_error);
+    EXPECT_THROW(doc.at(1)[StringPiece("k")] = string(300, 'y'),
+                 std::logic_error);
+    EXPECT_THROW(doc.at(0) = source, std::logic_error);
+    EXPECT_THROW(doc.at(0) = doc.at(1), std::logic_error);  // a heap copy
+    EXPECT_EQ(1, doc.at(0).getInt());
+    doc.at(0) = 2.5;
+    doc.at(1)[StringPiece("k")] = "short";
+    EXPECT_EQ("[2.5,{\"k\":\"short\"}]", doc.dump());
+    doc.at(1)[StringPiece("k")] =
+        dynamic::arenaString(string(300, 'y'), &arena);
+    EXPECT_EQ(300, doc.at(1)[StringPiece("k")].size());
+    dynamic element = doc.at(1);    // copies are ordinary values
+    element[StringPiece("k")] = string(300, 'z');
+    doc = source;
+    EXPECT_FALSE(doc.isInArena());
+
+    EXPECT_GT(arena.totalSize(), 0);
+    arena.clear();
+    EXPECT_EQ(0, arena.totalSize());
+}
+
+TEST(dynamic, Path)
+{
+    // The example document of RFC 6901
+    dynamic doc = dynamic::object;
+    doc["foo"] = dynamic{ "bar", "baz" };
+    doc[""] = 0;
+    doc["a/b"] = 1;
+    doc["c%d"] = 2;
+    doc["e^f"] = 3;
+    doc["g|h"] = 4;
+    doc["i\\j"] = 5;
+    doc["k\"l"] = 6;
+    doc[" "] = 7;
+    doc["m~n"] = 8;
+
+    EXPECT_EQ(&doc, doc.get_ptr(dynamic::Path("")));
+    EXPECT_EQ(2, doc.at(dynamic::Path("/foo")).size());
+    EXPECT_EQ("bar", doc.at(dynamic::Path("/foo/0")).getString());
+    EXPECT_EQ(0, doc.at(dynamic::Path("/")).getInt());
+    EXPECT_EQ(1, doc.at(dynamic::Path("/a~1b")).getInt());
+    EXPECT_EQ(2, doc.at(dynamic::Path("/c%d")).getInt());
+    EXPECT_EQ(3, doc.at(dynamic::Path("/e^f")).getInt());
+    EXPECT_EQ(4, doc.at(dynamic::Path("/g|h")).getInt());
+    EXPECT_EQ(5, doc.at(dynamic::Path("/i\\j")).getInt());
+    EXPECT_EQ(6, doc.at(dynamic::Path("/k\"l")).getInt());
+    EXPECT_EQ(7, doc.at(dynamic::Path("/ ")).getInt());
+    EXPECT_EQ(8, doc.at(dynamic::Path("/m~0n")).getInt());
+
+    dynamic::Path path("/a~1b/~0~1/12");
+    ASSERT_EQ(3, path.size());
+    EXPECT_EQ("a/b", path.token(0));
+    EXPECT_EQ("~/", path.token(1));
+    EXPECT_TRUE(path.matchesIndex(2, 12));
+    EXPECT_TRUE(path.matchesKey(2, "12"));
+    EXPECT_FALSE(path.matchesIndex(1, 0));
+
+    // Not found
+    const char* const missing[] = {
+        "/bar", "/foo/2", "/foo/-", "/foo/01", "/foo/00", "/foo/+1",
+        "/foo/0/x", "/a~1b/x", "/foo/99999999999999999999", "//",
+    };
+    for (auto pointer : missing)
+    {
+        EXPECT_EQ(nullptr, doc.get_ptr(dynamic::Path(pointer))) << pointer;
+        EXPECT_THROW(doc.at(dynamic::Path(pointer)), std::out_of_range);
+    }
+
+    const char* const invalid[] = { "foo", "#/foo", "/~", "/~2", "/a~" };
+    for (auto pointer : invalid)
+    {
+        EXPECT_THROW(dynamic::Path{ pointer }, std::invalid_argument) << pointer;
+    }
+
+    // Deeper, through indexed objects and in an arena
+    dynamic wide = dynamic::object;
+    for (int i = 0; i < 100; ++i)
+    {
+        wide[to<string>("member", i)] = dynamic{ i, doc };
+    }
+    dynamic::Path deep("/member57/1/foo/1");
+    EXPECT_EQ("baz", wide.at(deep).getString());
+    Arena arena;
+    dynamic frozen = dynamic::copyToArena(wide, &arena);
+    EXPECT_EQ("baz", frozen.at(deep).getString());
+    EXPECT_EQ(57, frozen.at(dynamic::Path("/member57/0")).getInt());
+
+    // The non-const overload allows modification
+    *wide.get_ptr(deep) = "changed";
+    EXPECT_EQ("changed", wide.at(deep).getString());
+}
+
+BENCHMARK(dynamic_short_strings, iters)
+{
+    const char* words[] = { "id", "name", "host", "latency", "ok", "tags" };
+    for (size_t i = 0; i < iters; ++i)
+    {
+        dynamic array = dynamic(dynamic::Array());
+        for (auto word : words)
+        {
+            array.push_back(word);
+        }
+        doNotOptimizeAway(array.size());
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+namespace {
+
+const int kWideObjectSize = 1000;
+
+string wideObjectKey(int i)
+{
+    return to<string>("some_member_name_", i);
+}
+
+} // anonymous namespace
+
+BENCHMARK(dynamic_object_lookup_wide, iters)
+{
+    dynamic obj = dynamic::object;
+    std::vector<string> keys;
+    BENCHMARK_SUSPEND
+    {
+        for (int i = 0; i < kWideObjectSize; ++i)
+        {
+            keys.push_back(wideObjectKey(i));
+            obj[keys.back()] = i;
+        }
+    }
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(obj[StringPiece(keys[i % keys.size()])].getInt());
+    }
+}
+
+BENCHMARK(std_map_lookup_wide, iters)
+{
+    std::map<dynamic, dynamic> obj;
+    std::vector<dynamic> keys;
+    BENCHMARK_SUSPEND
+    {
+        for (int i = 0; i < kWideObjectSize; ++i)
+        {
+            keys.push_back(wideObjectKey(i));
+            obj[keys.back()] = i;
+        }
+    }
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(obj.find(keys[i % keys.size()])->second.getInt());
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+namespace {
+
+dynamic makeNestedDocument()
+{
+    dynamic doc = dynamic::object;
+    for (int i = 0; i < 20; ++i)
+    {
+        dynamic inner = dynamic::object;
+        for (int j = 0; j < 20; ++j)
+        {
+            inner[to<string>("field_", j)] = dynamic{ i, j, "value" };
+        }
+        doc[to<string>("section_", i)] = std::move(inner);
+    }
+    return doc;
+}
+
+} // anonymous namespace
+
+BENCHMARK(dynamic_nested_lookup_chained, iters)
+{
+    dynamic doc;
+    BENCHMARK_SUSPEND
+    {
+        doc = makeNestedDocument();
+    }
+    for (size_t i = 0; i < iters; ++i)
+    {
+        const dynamic& d = doc;
+        doNotOptimizeAway(
+            d[StringPiece("section_13")][StringPiece("field_17")].at(1).getInt());
+    }
+}
+
+BENCHMARK(dynamic_nested_lookup_path, iters)
+{
+    dynamic doc;
+    BENCHMARK_SUSPEND
+    {
+        doc = makeNestedDocument();
+    }
+    const dynamic::Path path("/section_13/field_17/1");
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(doc.at(path).getInt());
+    }
+}
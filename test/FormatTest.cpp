@@ -0,0 +1,132 @@
+#include "Format.h"
+#include <stdint.h>
+#include <limits>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "Strings.h"
+#include "Benchmark.h"
+
+using std::string;
+
+namespace {
+
+enum Color { kRed, kGreen };
+
+} // anonymous namespace
+
+TEST(Format, Fields)
+{
+    EXPECT_EQ("", FormatString("").format());
+    EXPECT_EQ("plain", FormatString("plain").format());
+    EXPECT_EQ("a1b-2c", FormatString("a{}b{}c").format(1, -2));
+    EXPECT_EQ("x y x", FormatString("{0} {1} {0}").format("x", 'y'));
+    EXPECT_EQ("{}", FormatString("{{}}").format());
+    EXPECT_EQ("{7}", FormatString("{{{}}}").format(7));
+    EXPECT_EQ(2, FormatString("{1}{0}").argumentCount());
+
+    // Each type as toAppend() writes it
+    const string s = "str";
+    EXPECT_EQ("str piece 0.1 2.5 1 18446744073709551615 1",
+              FormatString("{} {} {} {} {} {} {}").format(
+                  s, StringPiece("piece"), 0.1, 2.5f, true,
+                  std::numeric_limits<uint64_t>::max(), kGreen));
+    EXPECT_EQ("-9223372036854775808",
+              FormatString("{}").format(std::numeric_limits<int64_t>::min()));
+}
+
+TEST(Format, Specs)
+{
+    EXPECT_EQ("[   42]", FormatString("[{:5}]").format(42));
+    EXPECT_EQ("[ab   ]", FormatString("[{:5}]").format("ab"));
+    EXPECT_EQ("[42   ]", FormatString("[{:<5}]").format(42));
+    EXPECT_EQ("[   ab]", FormatString("[{:>5s}]").format("ab"));
+    EXPECT_EQ("[*ab**]", FormatString("[{:*^5}]").format("ab"));
+    EXPECT_EQ("[-0042]", FormatString("[{:05}]").format(-42));
+    EXPECT_EQ("[-  42]", FormatString("[{:=5d}]").format(-42));
+    EXPECT_EQ("[-4200]", FormatString("[{:<05}]").format(-42));
+    EXPECT_EQ("[toolong]", FormatString("[{:3}]").format("toolong"));
+    EXPECT_EQ("x" + string(100, ' '), FormatString("{:101}").format('x'));
+
+    EXPECT_EQ("ff FF -1a 000000ff", FormatString("{:x} {:X} {:x} {:08x}")
+              .format(255, 255u, static_cast<int8_t>(-26), 255));
+    EXPECT_EQ("ffffffffffffffff",
+              FormatString("{:x}").format(std::numeric_limits<uint64_t>::max()));
+
+    EXPECT_EQ("3.142 3.141593 3.14e+00 1.000000e+03",
+              FormatString("{:.3f} {:f} {:.2e} {:e}")
+              .format(3.14159265, 3.14159265, 3.14159265, 1000));
+    EXPECT_EQ("[  -1.50]", FormatString("[{:7.2f}]").format(-1.5));
+    EXPECT_EQ("[-001.50]", FormatString("[{:07.2f}]").format(-1.5));
+    EXPECT_EQ("[0.25  ]", FormatString("[{:<6}]").format(0.25f));
+    EXPECT_EQ("2", FormatString("{:.0f}").format(2.5));
+
+    // Into other sinks
+    char buffer[16];
+    BufferAppender out(buffer);
+    FormatString("{}={:.1f}").appendTo(&out, "pi", 3.14159);
+    EXPECT_EQ("pi=3.1", out.str());
+    string appended = "> ";
+    FormatString("{:>4}").appendTo(&appended, 7);
+    EXPECT_EQ(">    7", appended);
+}
+
+TEST(Format, Errors)
+{
+    const char* malformed[] = {
+        "{", "}", "a{b", "{0}{}", "{}{1}", "{:?}", "{:5.2}", "{:.f}",
+        "{:ss}", "{x}", "{:99999999}",
+    };
+    for (const char* format : malformed)
+    {
+        EXPECT_THROW(FormatString{ format }, std::invalid_argument) << format;
+    }
+
+    FormatString two("{} {}");
+    EXPECT_THROW(two.format(1), std::invalid_argument);
+    EXPECT_THROW(two.format(1, 2, 3), std::invalid_argument);
+    EXPECT_THROW(FormatString("{:x}").format(1.5), std::invalid_argument);
+    EXPECT_THROW(FormatString("{:f}").format("text"), std::invalid_argument);
+    EXPECT_THROW(FormatString("{:s}").format(1), std::invalid_argument);
+}
+
+BENCHMARK(format_string_log_line, iters)
+{
+    static const FormatString kLine("{}:{} {} took {:.3f}ms, {} bytes");
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(kLine.format(
+            "src/json.cpp", 742, "serializeJson", 0.125 * i, i).size());
+    }
+}
+
+BENCHMARK(stringPrintf_log_line, iters)
+{
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(stringPrintf("%s:%d %s took %.3fms, %zu bytes",
+            "src/json.cpp", 742, "serializeJson", 0.125 * i, i).size());
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(format_string_long, iters)
+{
+    static const FormatString kLine("metric={} host={} shard={:08x} value={}");
+    const string name(150, 'm');
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(kLine.format(
+            name, "web-0042.example.com", i, 0.25).size());
+    }
+}
+
+BENCHMARK(stringPrintf_long, iters)
+{
+    const string name(150, 'm');
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(stringPrintf("metric=%s host=%s shard=%08zx value=%g",
+            name.c_str(), "web-0042.example.com", i, 0.25).size());
+    }
+}
@@ -0,0 +1,674 @@
+#include "json.h"
+#include <limits.h>
+#include <sstream>
+#include <gtest/gtest.h>
+#include "Arena.h"
+#include "Benchmark.h"
+
+using std::string;
+
+TEST(json, ParseScalars)
+{
+    EXPECT_TRUE(parseJson("null").isNull());
+    EXPECT_TRUE(parseJson("true").getBool());
+    EXPECT_FALSE(parseJson("false").getBool());
+    EXPECT_EQ(0, parseJson("0").getInt());
+    EXPECT_EQ(0, parseJson("-0").getInt());
+    EXPECT_EQ(1024, parseJson(" 1024 ").getInt());
+    EXPECT_EQ(-42, parseJson("-42").getInt());
+    EXPECT_EQ(LLONG_MAX, parseJson("9223372036854775807").getInt());
+    EXPECT_EQ(LLONG_MIN, parseJson("-9223372036854775808").getInt());
+    EXPECT_EQ(1234567890123456789LL, parseJson("1234567890123456789").getInt());
+
+    // Integers that don't fit in int64_t become doubles
+    EXPECT_EQ(9223372036854775808.0,
+        parseJson("9223372036854775808").getDouble());
+    EXPECT_EQ(-9223372036854775809.0,
+        parseJson("-9223372036854775809").getDouble());
+    EXPECT_EQ(1e25, parseJson("10000000000000000000000000").getDouble());
+
+    EXPECT_EQ(3.14159, parseJson("3.14159").getDouble());
+    EXPECT_EQ(-0.5, parseJson("-0.5").getDouble());
+    EXPECT_EQ(1e10, parseJson("1e10").getDouble());
+    EXPECT_EQ(1.5e-7, parseJson("1.5E-7").getDouble());
+    EXPECT_EQ(250.0, parseJson("2.5e+2").getDouble());
+    EXPECT_EQ(0.1, parseJson("0.1000000000000000000000000000000000000000000"
+        "00000000000000000000000000000000000000000000000000").getDouble());
+
+    EXPECT_EQ("", parseJson("\"\"").getString());
+    EXPECT_EQ("bonjour", parseJson("\"bonjour\"").getString());
+}
+
+TEST(json, ParseStrings)
+{
+    EXPECT_EQ("a\"b\\c/d\be\ff\ng\rh\ti",
+        parseJson("\"a\\\"b\\\\c\\/d\\be\\ff\\ng\\rh\\ti\"").getString());
+    EXPECT_EQ("A", parseJson("\"\\u0041\"").getString());
+    EXPECT_EQ("\xc3\xa9", parseJson("\"\\u00e9\"").getString());
+    EXPECT_EQ("\xe2\x82\xac", parseJson("\"\\u20AC\"").getString());
+    EXPECT_EQ("\xf0\x9f\x98\x80", parseJson("\"\\ud83d\\ude00\"").getString());
+    EXPECT_EQ("\xe4\xbd\xa0\xe5\xa5\xbd", parseJson("\"\xe4\xbd\xa0\xe5\xa5\xbd\"")
+        .getString());
+
+    // Put the special characters at every offset of the SIMD blocks
+    for (size_t n = 0; n < 80; ++n)
+    {
+        string body(n, 'x');
+        EXPECT_EQ(body, parseJson("\"" + body + "\"").getString());
+        EXPECT_EQ(body + "\"" + body,
+            parseJson("\"" + body + "\\\"" + body + "\"").getString());
+        EXPECT_THROW(parseJson("\"" + body + "\n\""), JsonParseError);
+        EXPECT_THROW(parseJson("\"" + body), JsonParseError);
+        EXPECT_EQ(body + "\x7f\x80\xff",
+            parseJson("\"" + body + "\x7f\x80\xff\"").getString());
+    }
+}
+
+TEST(json, ParseContainers)
+{
+    auto d = parseJson(
+        "{\n"
+        "  \"name\": \"thirsty\",\n"
+        "  \"version\": 2,\n"
+        "  \"tags\": [\"json\", \"uri\", 1.5, null, true],\n"
+        "  \"nested\": {\"empty\": {}, \"list\": [[], [1, [2]]]}\n"
+        "}\n");
+    EXPECT_TRUE(d.isObject());
+    EXPECT_EQ(4, d.size());
+    EXPECT_EQ("thirsty", d["name"].getString());
+    EXPECT_EQ(2, d["version"].getInt());
+    const dynamic& tags = d["tags"];
+    ASSERT_TRUE(tags.isArray());
+    EXPECT_EQ(5, tags.size());
+    EXPECT_EQ("uri", tags.at(1).getString());
+    EXPECT_EQ(1.5, tags.at(2).getDouble());
+    EXPECT_TRUE(tags.at(3).isNull());
+    EXPECT_TRUE(tags.at(4).getBool());
+    const dynamic& nested = d["nested"];
+    EXPECT_TRUE(nested["empty"].isObject());
+    EXPECT_TRUE(nested["empty"].empty());
+    EXPECT_EQ(2, nested["list"].at(1).at(1).at(0).getInt());
+
+    // The last duplicate key wins
+    EXPECT_EQ(2, parseJson("{\"a\":1,\"a\":2}")["a"].getInt());
+    EXPECT_EQ(0, parseJson("[ ]").size());
+    EXPECT_EQ(0, parseJson(" { } ").size());
+}
+
+TEST(json, ParseErrors)
+{
+    const char* const bad[] = {
+        "", " ", "nul", "nulll", "True", "[", "]", "[1,]", "[,1]", "[1 2]",
+        "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "{a:1}", "{\"a\" 1}",
+        "{\"a\":1 \"b\":2}", "01", "-", "+1", "1.", ".5", "1e", "1e+",
+        "0x10", "-a", "\"\\x\"", "\"\\u12\"", "\"\\u12g4\"", "\"\\ud800\"",
+        "\"\\ud800\\u0041\"", "\"\\udc00\"", "\"a\tb\"", "1 2", "[1]]",
+        "'a'", "NaN", "Infinity",
+    };
+    for (auto s : bad)
+    {
+        EXPECT_THROW(parseJson(s), JsonParseError) << "input: " << s;
+    }
+
+    // Parsing never reads past the end of the piece
+    string s = "[123]";
+    EXPECT_THROW(parseJson(StringPiece(s.data(), 4)), JsonParseError);
+    EXPECT_EQ(12, parseJson(StringPiece(s.data() + 1, 2)).getInt());
+    EXPECT_EQ(1.5, parseJson(StringPiece("1.5e3", 3)).getDouble());
+
+    try
+    {
+        parseJson("{\n\"a\": [1,\n2,,3]}");
+        ADD_FAILURE();
+    }
+    catch (const JsonParseError& ex)
+    {
+        EXPECT_STREQ("json parse error on line 3 near `,3]}': "
+            "expected json value", ex.what());
+    }
+
+    string deep(1024, '[');
+    deep += string(1024, ']');
+    EXPECT_EQ(1, parseJson(deep).size());
+    EXPECT_THROW(parseJson("[" + deep + "]"), JsonParseError);
+}
+
+TEST(json, SerializeScalars)
+{
+    EXPECT_EQ("null", toJson(nullptr));
+    EXPECT_EQ("true", toJson(true));
+    EXPECT_EQ("false", toJson(false));
+    EXPECT_EQ("0", toJson(0));
+    EXPECT_EQ("-42", toJson(-42));
+    EXPECT_EQ("9223372036854775807", toJson(int64_t(LLONG_MAX)));
+    EXPECT_EQ("-9223372036854775808", toJson(int64_t(LLONG_MIN)));
+
+    EXPECT_EQ("0.1", toJson(0.1));
+    EXPECT_EQ("2.0", toJson(2.0));
+    EXPECT_EQ("-0.0", toJson(-0.0));
+    EXPECT_EQ("3.14159", toJson(3.14159));
+    EXPECT_EQ("0.30000000000000004", toJson(0.1 + 0.2));
+    EXPECT_EQ("1e+300", toJson(1e300));
+    EXPECT_EQ(4.9406564584124654e-324,
+        parseJson(toJson(4.9406564584124654e-324)).getDouble());
+    EXPECT_EQ("-0.1679999977350235", toJson(-0.168f));
+    EXPECT_THROW(toJson(std::numeric_limits<double>::quiet_NaN()),
+        std::invalid_argument);
+    EXPECT_THROW(toJson(std::numeric_limits<double>::infinity()),
+        std::invalid_argument);
+
+    EXPECT_EQ("\"\"", toJson(""));
+    EXPECT_EQ("\"bonjour\"", toJson("bonjour"));
+    EXPECT_EQ("\"a\\\"b\\\\c/d\\be\\ff\\ng\\rh\\ti\\u0000j\\u001fk\x7f\"",
+        toJson(string("a\"b\\c/d\be\ff\ng\rh\ti\0j\x1fk\x7f", 22)));
+    EXPECT_EQ("\"\xe4\xbd\xa0\xe5\xa5\xbd\"", toJson("\xe4\xbd\xa0\xe5\xa5\xbd"));
+}
+
+TEST(json, SerializeContainers)
+{
+    dynamic obj = dynamic::object;
+    obj["b"] = dynamic{ 1, "two", nullptr, dynamic::object,
+                        dynamic(dynamic::Array()) };
+    obj["a"] = 1.5;
+    // members come out in insertion order
+    EXPECT_EQ("{\"b\":[1,\"two\",null,{},[]],\"a\":1.5}", toJson(obj));
+    EXPECT_EQ(
+        "{\n"
+        "  \"b\": [\n"
+        "    1,\n"
+        "    \"two\",\n"
+        "    null,\n"
+        "    {},\n"
+        "    []\n"
+        "  ],\n"
+        "  \"a\": 1.5\n"
+        "}", toPrettyJson(obj));
+
+    JsonSerializationOpts opts;
+    opts.sortKeys = true;
+    string sorted;
+    serializeJson(parseJson("{\"z\":1,\"m\":{\"y\":2,\"x\":3},\"a\":4}"),
+        &sorted, opts);
+    EXPECT_EQ("{\"a\":4,\"m\":{\"x\":3,\"y\":2},\"z\":1}", sorted);
+
+    // serializeJson appends
+    string out = "x=";
+    serializeJson(dynamic{ 1, 2 }, &out);
+    EXPECT_EQ("x=[1,2]", out);
+
+    dynamic intKeys = dynamic::object;
+    intKeys.insert(1, "one");
+    EXPECT_THROW(toJson(intKeys), dynamic::TypeError);
+    opts.allowNonStringKeys = true;
+    out.clear();
+    serializeJson(intKeys, &out, opts);
+    EXPECT_EQ("{1:\"one\"}", out);
+    EXPECT_EQ("{1:\"one\"}", intKeys.dump());
+
+    dynamic nans = { std::numeric_limits<double>::quiet_NaN(),
+                     std::numeric_limits<double>::infinity(),
+                     -std::numeric_limits<double>::infinity() };
+    EXPECT_EQ("[NaN,Infinity,-Infinity]", nans.dump());
+}
+
+TEST(json, RoundTrip)
+{
+    const char* const texts[] = {
+        "[]", "{}", "[null,true,false,0,-1,1.5,\"\"]",
+        "{\"a\":{\"b\":{\"c\":[1,[2,[3,{\"d\":\"e\\n\\u0001\"}]]]}}}",
+        "[1e+300,-2.5e-300,0.1,123456789.0,9007199254740993]",
+    };
+    for (auto text : texts)
+    {
+        EXPECT_EQ(text, toJson(parseJson(text)));
+        EXPECT_EQ(text, toJson(parseJson(toPrettyJson(parseJson(text)))));
+    }
+
+    // Every double survives a round trip
+    uint64_t bits = 0x3ff0000000000001ULL;
+    for (int i = 0; i < 1000; ++i)
+    {
+        bits = bits * 6364136223846793005ULL + 1442695040888963407ULL;
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        if (std::isnan(d) || std::isinf(d))
+        {
+            continue;
+        }
+        EXPECT_EQ(d, parseJson(toJson(d)).getDouble()) << toJson(d);
+    }
+}
+
+TEST(json, ParseIntoArena)
+{
+    const char* inputs[] = {
+        "null", "-7", "2.5", "\"short\"", "\"esc\\u00e9aped\"", "[]", "{}",
+        "[1,[2,[3,[]]],{\"a\":{}}]",
+        "{\"b\":[true,false,null],\"a\":\"x\",\"b\":\"last wins\"}",
+    };
+    Arena arena;
+    for (auto input : inputs)
+    {
+        dynamic d = parseJson(input, &arena);
+        EXPECT_EQ(toJson(parseJson(input)), toJson(d)) << input;
+    }
+
+    string payload;
+    for (int i = 0; i < 100; ++i)
+    {
+        payload += to<string>(i == 0 ? "{" : ",", "\"key", i,
+            "\":{\"id\":", i, ",\"name\":\"member number ", i, "\"}");
+    }
+    payload += "}";
+
+    dynamic owned;
+    {
+        Arena local(256);   // small blocks, to cross many of them
+        dynamic d = parseJson(payload, &local);
+        EXPECT_TRUE(d.isInArena());
+        EXPECT_EQ(100, d.size());
+        EXPECT_EQ(42, d[StringPiece("key42")][StringPiece("id")].getInt());
+        EXPECT_EQ("member number 99",
+            d[StringPiece("key99")][StringPiece("name")].getString());
+        EXPECT_EQ(toJson(parseJson(payload)), toJson(d));
+        owned = d;  // copies out of the arena
+    }
+    EXPECT_FALSE(owned.isInArena());
+    EXPECT_EQ(toJson(parseJson(payload)), toJson(owned));
+    owned["key100"] = 100;
+    EXPECT_EQ(101, owned.size());
+
+    // Errors are reported the same way
+    EXPECT_THROW(parseJson("{\"a\":[1,2}", &arena), JsonParseError);
+}
+
+namespace {
+
+// Writes the events of a JsonReader in a compact form
+class RecordingHandler : public JsonHandler
+{
+public:
+    string events;
+
+    void onNull() override { events += "n "; }
+    void onBool(bool value) override { events += value ? "t " : "f "; }
+    void onInt(int64_t value) override { events += to<string>("i", value, " "); }
+    void onDouble(double value) override
+    {
+        events += to<string>("d", value, " ");
+    }
+    void onString(StringPiece value) override
+    {
+        events += to<string>("s", value, " ");
+    }
+    void onStartObject() override { events += "{ "; }
+    void onKey(StringPiece key) override { events += to<string>("k", key, " "); }
+    void onEndObject() override { events += "} "; }
+    void onStartArray() override { events += "[ "; }
+    void onEndArray() override { events += "] "; }
+    void onEndValue() override { events += "; "; }
+};
+
+// The events JsonReader should give for a value
+void expectedEvents(const dynamic& value, string* out)
+{
+    switch (value.type())
+    {
+    case dynamic::NULLT:
+        *out += "n ";
+        break;
+    case dynamic::BOOL:
+        *out += value.getBool() ? "t " : "f ";
+        break;
+    case dynamic::INT64:
+        *out += to<string>("i", value.getInt(), " ");
+        break;
+    case dynamic::DOUBLE:
+        *out += to<string>("d", value.getDouble(), " ");
+        break;
+    case dynamic::STRING:
+        *out += to<string>("s", value.getString(), " ");
+        break;
+    case dynamic::ARRAY:
+        *out += "[ ";
+        for (size_t i = 0; i < value.size(); ++i)
+        {
+            expectedEvents(value.at(i), out);
+        }
+        *out += "] ";
+        break;
+    case dynamic::OBJECT:
+        *out += "{ ";
+        for (const auto& member : value)
+        {
+            *out += to<string>("k", member.first.getString(), " ");
+            expectedEvents(member.second, out);
+        }
+        *out += "} ";
+        break;
+    }
+}
+
+string readEvents(StringPiece input, size_t chunkSize)
+{
+    RecordingHandler handler;
+    JsonReader reader(&handler);
+    for (size_t i = 0; i < input.size(); i += chunkSize)
+    {
+        reader.feed(input.subpiece(i, chunkSize));
+    }
+    reader.finish();
+    return handler.events;
+}
+
+} // namespace
+
+TEST(json, Reader)
+{
+    const char* const inputs[] = {
+        "null", "true", "false", "0", "-12", "3.25", "-1e-3", "1E+400",
+        "9223372036854775807", "-9223372036854775808", "9223372036854775808",
+        "\"\"", "\"plain\"", "\"esc\\\"aped\\\\\\n\\u00e9\\ud83d\\ude00\"",
+        "[]", "{}", "[[],[[]],{}]",
+        " { \"a\" : [ 1 , 2.5 , \"x\" , null , true , false , { } ] ,\n"
+        "   \"b\\u0041\" : { \"nested\" : { \"deep\" : [ [ -7 ] ] } } } ",
+    };
+    for (auto input : inputs)
+    {
+        string expected;
+        expectedEvents(parseJson(input), &expected);
+        expected += "; ";
+        // Every chunking gives the same events
+        const size_t len = strlen(input);
+        for (size_t chunk = 1; chunk <= len; ++chunk)
+        {
+            EXPECT_EQ(expected, readEvents(input, chunk))
+                << input << " in chunks of " << chunk;
+        }
+        // And every split point of two chunks
+        for (size_t split = 0; split <= len; ++split)
+        {
+            RecordingHandler handler;
+            JsonReader reader(&handler);
+            reader.feed(StringPiece(input, split));
+            reader.feed(StringPiece(input + split, len - split));
+            reader.finish();
+            EXPECT_EQ(expected, handler.events) << input << " split at " << split;
+        }
+    }
+
+    // A stream of values, such as newline-delimited JSON
+    EXPECT_EQ("i1 ; i2 ; { k-a s-b } ; [ ] ; ",
+        readEvents("1 2\n{\"-a\":\"-b\"}\n[]\n", 3));
+    EXPECT_EQ("", readEvents("", 1));
+    EXPECT_EQ("", readEvents(" \n ", 1));
+
+    // Unescaped strings in one chunk are not copied
+    struct PointerHandler : JsonHandler
+    {
+        StringPiece key, value;
+        void onKey(StringPiece k) override { key = k; }
+        void onString(StringPiece v) override { value = v; }
+    } pointers;
+    string text = "{\"key\":\"value\"}";
+    JsonReader reader(&pointers);
+    reader.feed(text);
+    reader.finish();
+    EXPECT_EQ(text.data() + 2, pointers.key.data());
+    EXPECT_EQ(text.data() + 8, pointers.value.data());
+}
+
+TEST(json, ReaderErrors)
+{
+    const char* const bad[] = {
+        "nul", "nulll", "True", "[", "]", "[1,]", "[,1]", "[1 2]",
+        "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "{a:1}", "{\"a\" 1}",
+        "{\"a\":1 \"b\":2}", "01", "-", "+1", "1.", ".5", "1e", "1e+",
+        "0x10", "-a", "\"\\x\"", "\"\\u12\"", "\"\\u12g4\"", "\"\\ud800\"",
+        "\"\\ud800\\u0041\"", "\"\\udc00\"", "\"a\tb\"", "[1]]", "\"abc",
+        "'a'", "NaN", "Infinity", "{\"a\":1}}",
+        // Top-level values need whitespace between them
+        "1true", "[1]2", "{}{}", "1\"a\"", "\"a\"1", "[1]\n2{}",
+    };
+    for (auto s : bad)
+    {
+        for (size_t chunk = 1; chunk <= strlen(s); ++chunk)
+        {
+            EXPECT_THROW(readEvents(s, chunk), JsonParseError)
+                << "input: " << s << " in chunks of " << chunk;
+        }
+    }
+
+    RecordingHandler handler;
+    JsonReader reader(&handler);
+    try
+    {
+        reader.feed("{\n\"a\": [1,\n");
+        reader.feed("2,,3]}");
+        ADD_FAILURE();
+    }
+    catch (const JsonParseError& ex)
+    {
+        EXPECT_STREQ("json parse error on line 3 near `,3]}': "
+            "expected json value", ex.what());
+    }
+
+    // Usable again after reset()
+    reader.reset();
+    handler.events.clear();
+    reader.feed("[1]");
+    reader.finish();
+    EXPECT_EQ("[ i1 ] ; ", handler.events);
+
+    string deep(1024, '[');
+    deep += string(1024, ']');
+    EXPECT_NO_THROW(readEvents(deep, 100));
+    EXPECT_THROW(readEvents("[" + deep + "]", 100), JsonParseError);
+}
+
+TEST(json, PathExtractor)
+{
+    const char* const records[] = {
+        "{\"user\":{\"id\":7,\"name\":\"ann\",\"tags\":[\"a\",\"b\"]},\"n\":1}",
+        "{\"n\":2,\"user\":{\"name\":\"esc\\\"aped\",\"id\":8}}",
+        "{\"user\":[1,2,3],\"n\":{\"user\":{\"id\":9}}}",
+        "[{\"user\":{\"id\":10}}]",
+        "{\"user\":{\"tags\":[[\"x\"],\"y\"],\"id\":null}}",
+        "\"scalar\"",
+    };
+    const char* const pointers[] = {
+        "/user/id", "/user/tags/1", "/user", "/n", "/n/user/id", "/0/user",
+        "/user/tags/0/0", "/missing", "",
+    };
+
+    struct Collector : JsonPathExtractor
+    {
+        explicit Collector(std::vector<dynamic::Path> paths)
+            : JsonPathExtractor(std::move(paths))
+        {
+        }
+        void onEndValue() override
+        {
+            std::vector<string> record;
+            for (size_t i = 0; i < values().size(); ++i)
+            {
+                record.push_back(found(i) ? toJson(values()[i]) : "-");
+            }
+            results.push_back(record);
+        }
+        std::vector<std::vector<string>> results;
+    };
+
+    string stream;
+    std::vector<std::vector<string>> expected;
+    std::vector<dynamic::Path> paths;
+    for (auto pointer : pointers)
+    {
+        paths.emplace_back(pointer);
+    }
+    for (auto record : records)
+    {
+        stream += record;
+        stream += "\n";
+        dynamic doc = parseJson(record);
+        std::vector<string> values;
+        for (const auto& path : paths)
+        {
+            const dynamic* value = doc.get_ptr(path);
+            values.push_back(value ? toJson(*value) : "-");
+        }
+        expected.push_back(values);
+    }
+
+    for (size_t chunk = 1; chunk <= stream.size(); chunk += 7)
+    {
+        Collector collector(paths);
+        JsonReader reader(&collector);
+        for (size_t i = 0; i < stream.size(); i += chunk)
+        {
+            reader.feed(StringPiece(stream).subpiece(i, chunk));
+        }
+        reader.finish();
+        ASSERT_EQ(expected.size(), collector.results.size());
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            EXPECT_EQ(expected[i], collector.results[i])
+                << records[i] << " in chunks of " << chunk;
+        }
+    }
+}
+
+namespace {
+
+// A telemetry-like payload of about 1MB
+string makeJsonPayload()
+{
+    string s = "[";
+    for (int i = 0; i < 4000; ++i)
+    {
+        if (i > 0)
+        {
+            s += ",";
+        }
+        s += to<string>("\n  {\"id\": ", i * 7919, ", \"host\": \"web", i % 97,
+            ".example.com\", \"latency\": ", i * 0.25,
+            ", \"ok\": ", (i % 13 ? "true" : "false"),
+            ", \"path\": \"/api/v2/users/", i,
+            "/friends?limit=50\\u0026offset=100\", \"tags\": [\"alpha\", "
+            "\"beta\", \"gamma\"], \"note\": \"a somewhat longer free form "
+            "description of the request, as found in real logs\"}");
+    }
+    s += "\n]\n";
+    return s;
+}
+
+} // namespace
+
+BENCHMARK(json_parse_1MB, iters)
+{
+    string payload;
+    BENCHMARK_SUSPEND
+    {
+        payload = makeJsonPayload();
+    }
+    for (size_t i = 0; i < iters; ++i)
+    {
+        auto d = parseJson(payload);
+        doNotOptimizeAway(d.size());
+    }
+}
+
+BENCHMARK(json_parse_1MB_arena, iters)
+{
+    string payload;
+    BENCHMARK_SUSPEND
+    {
+        payload = makeJsonPayload();
+    }
+    Arena arena(1024 * 1024);
+    for (size_t i = 0; i < iters; ++i)
+    {
+        auto d = parseJson(payload, &arena);
+        doNotOptimizeAway(d.size());
+        arena.clear();
+    }
+}
+
+BENCHMARK(json_read_1MB_events, iters)
+{
+    string payload;
+    BENCHMARK_SUSPEND
+    {
+        payload = makeJsonPayload();
+    }
+    struct CountingHandler : JsonHandler
+    {
+        size_t count = 0;
+        void onKey(StringPiece key) override { count += key.size(); }
+        void onString(StringPiece value) override { count += value.size(); }
+    } handler;
+    JsonReader reader(&handler);
+    const size_t kChunkSize = 64 * 1024;
+    for (size_t i = 0; i < iters; ++i)
+    {
+        StringPiece input(payload);
+        while (!input.empty())
+        {
+            StringPiece chunk = input.subpiece(0, kChunkSize);
+            reader.feed(chunk);
+            input.advance(chunk.size());
+        }
+        reader.finish();
+    }
+    doNotOptimizeAway(handler.count);
+}
+
+BENCHMARK(json_extract_1MB_paths, iters)
+{
+    string payload;
+    BENCHMARK_SUSPEND
+    {
+        payload = makeJsonPayload();
+    }
+    std::vector<dynamic::Path> paths;
+    paths.emplace_back("/100/host");
+    paths.emplace_back("/3999/tags/2");
+    for (size_t i = 0; i < iters; ++i)
+    {
+        JsonPathExtractor extractor(paths);
+        JsonReader reader(&extractor);
+        reader.feed(payload);
+        reader.finish();
+        doNotOptimizeAway(extractor.found(1));
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(json_serialize_1MB_ostream, iters)
+{
+    dynamic d;
+    BENCHMARK_SUSPEND
+    {
+        d = parseJson(makeJsonPayload());
+    }
+    for (size_t i = 0; i < iters; ++i)
+    {
+        std::ostringstream stream;
+        stream << d;
+        doNotOptimizeAway(stream.str().size());
+    }
+}
+
+BENCHMARK(json_serialize_1MB, iters)
+{
+    dynamic d;
+    BENCHMARK_SUSPEND
+    {
+        d = parseJson(makeJsonPayload());
+    }
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(toJson(d).size());
+    }
+}
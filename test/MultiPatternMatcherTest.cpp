@@ -0,0 +1,262 @@
+#include "MultiPatternMatcher.h"
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "Benchmark.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+typedef MultiPatternMatcher::Match Match;
+
+// Every occurrence, one find() per pattern
+vector<Match> naiveFindAll(const vector<string>& patterns, StringPiece haystack)
+{
+    vector<Match> matches;
+    for (size_t offset = 0; offset < haystack.size(); ++offset)
+    {
+        for (size_t id = 0; id < patterns.size(); ++id)
+        {
+            if (haystack.subpiece(offset).startsWith(patterns[id]))
+            {
+                Match match = {
+                    id, offset, haystack.subpiece(offset, patterns[id].size()),
+                };
+                matches.push_back(match);
+            }
+        }
+    }
+    return matches;
+}
+
+string randomString(size_t size, char alphabet)
+{
+    string s;
+    for (size_t i = 0; i < size; ++i)
+    {
+        s.push_back(static_cast<char>('a' + rand() % alphabet));
+    }
+    return s;
+}
+
+void checkAgainstNaive(const vector<string>& patterns, StringPiece haystack)
+{
+    const MultiPatternMatcher matcher(
+        vector<StringPiece>(patterns.begin(), patterns.end()));
+    const vector<Match> expected = naiveFindAll(patterns, haystack);
+    const vector<Match> actual = matcher.findAll(haystack);
+    ASSERT_EQ(expected.size(), actual.size()) << haystack;
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        ASSERT_EQ(expected[i].pattern, actual[i].pattern) << haystack;
+        ASSERT_EQ(expected[i].offset, actual[i].offset) << haystack;
+        ASSERT_EQ(expected[i].piece.data(), actual[i].piece.data());
+        ASSERT_EQ(expected[i].piece.size(), actual[i].piece.size());
+    }
+
+    Match first;
+    ASSERT_EQ(!expected.empty(), matcher.find(haystack, &first)) << haystack;
+    if (!expected.empty())
+    {
+        EXPECT_EQ(expected[0].pattern, first.pattern) << haystack;
+        EXPECT_EQ(expected[0].offset, first.offset) << haystack;
+    }
+}
+
+} // anonymous namespace
+
+TEST(MultiPatternMatcher, Basic)
+{
+    const MultiPatternMatcher matcher({ "he", "she", "his", "hers" });
+    EXPECT_EQ(4, matcher.size());
+    EXPECT_EQ("his", matcher.pattern(2));
+
+    const string haystack = "ushers";
+    const vector<Match> matches = matcher.findAll(haystack);
+    ASSERT_EQ(3, matches.size());
+    EXPECT_EQ(1, matches[0].pattern);
+    EXPECT_EQ(1, matches[0].offset);
+    EXPECT_EQ("she", matches[0].piece);
+    EXPECT_EQ(0, matches[1].pattern);
+    EXPECT_EQ(2, matches[1].offset);
+    EXPECT_EQ(3, matches[2].pattern);
+    EXPECT_EQ(2, matches[2].offset);
+    EXPECT_EQ(haystack.data() + 2, matches[2].piece.data());
+
+    Match match;
+    ASSERT_TRUE(matcher.find(haystack, &match));
+    EXPECT_EQ(1, match.pattern);
+    EXPECT_TRUE(matcher.contains("this"));
+    EXPECT_FALSE(matcher.contains("hi sh"));
+    EXPECT_FALSE(matcher.contains(""));
+
+    // Duplicates are each reported, and a longer pattern at the same
+    // offset doesn't hide a shorter one
+    const MultiPatternMatcher duplicates({ "abc", "a", "abc" });
+    const vector<Match> all = duplicates.findAll("xabcabc");
+    ASSERT_EQ(6, all.size());
+    EXPECT_EQ(0, all[0].pattern);
+    EXPECT_EQ(1, all[1].pattern);
+    EXPECT_EQ(2, all[2].pattern);
+    EXPECT_EQ(4, all[5].offset);
+
+    // Copies keep their own patterns
+    MultiPatternMatcher copy = matcher;
+    EXPECT_EQ("hers", copy.pattern(3));
+    EXPECT_EQ(3, copy.findAll(haystack).size());
+
+    const MultiPatternMatcher none(vector<StringPiece>{});
+    EXPECT_FALSE(none.contains("anything"));
+    EXPECT_THROW(MultiPatternMatcher({ "a", "" }), std::invalid_argument);
+}
+
+TEST(MultiPatternMatcher, Random)
+{
+    srand(7);
+    // Up to 32 patterns are Teddy's, more Aho-Corasick's
+    const size_t counts[] = { 1, 2, 5, 8, 9, 20, 32, 33, 100 };
+    for (size_t count : counts)
+    {
+        for (int round = 0; round < 50; ++round)
+        {
+            const char alphabet = static_cast<char>(2 + rand() % 6);
+            vector<string> patterns;
+            for (size_t i = 0; i < count; ++i)
+            {
+                patterns.push_back(randomString(1 + rand() % 6, alphabet));
+            }
+            checkAgainstNaive(patterns,
+                              randomString(rand() % 300, alphabet));
+        }
+    }
+
+    // Bytes of all values, so every byte is a class of its own
+    vector<string> patterns;
+    for (int i = 0; i < 256; ++i)
+    {
+        patterns.push_back(string(1, static_cast<char>(i)) + "\xff");
+    }
+    string haystack;
+    for (int i = 0; i < 1000; ++i)
+    {
+        haystack.push_back(static_cast<char>(rand()));
+    }
+    checkAgainstNaive(patterns, haystack);
+}
+
+TEST(MultiPatternMatcher, Adversarial)
+{
+    // Every position is a candidate that fails only at the last byte, so
+    // Teddy hands the rest over to Aho-Corasick; matches on both sides of
+    // the handover are all found, once
+    const vector<string> patterns = { string(15, 'a') + "b", "aab", "ba" };
+    string haystack(100000, 'a');
+    haystack[20] = 'b';
+    haystack[50000] = 'b';
+    haystack.back() = 'b';
+    checkAgainstNaive(patterns, haystack);
+
+    const MultiPatternMatcher matcher(
+        vector<StringPiece>(patterns.begin(), patterns.end()));
+    Match first;
+    ASSERT_TRUE(matcher.find(StringPiece(haystack).subpiece(21), &first));
+    EXPECT_EQ(0, first.pattern);
+    EXPECT_EQ(50000 - 15 - 21, first.offset);
+    EXPECT_TRUE(matcher.findAll(haystack.substr(21, 49979)).empty());
+}
+
+namespace {
+
+const vector<StringPiece>& tokens()
+{
+    static const vector<StringPiece> kTokens = {
+        "<script", "</script", "javascript:", "onload=", "onerror=",
+        "onclick=", "<iframe", "<object", "<embed", "eval(", "document.",
+        "window.", "alert(", "vbscript:", "expression(", "<applet",
+        "<meta", "<link", "<style", "srcdoc=", "formaction=", "onfocus=",
+        "onmouseover=", "data:text", "base64,", "fromCharCode", "innerHTML",
+        "outerHTML", "setTimeout(", "setInterval(", "Function(", "import(",
+        "<svg", "<math", "xlink:", "<base", "<form", "onsubmit=",
+        "onblur=", "location.",
+    };
+    return kTokens;
+}
+
+// 64KB of text, tokens nowhere
+const string& page()
+{
+    static const string kPage = []
+    {
+        const char* words[] = {
+            "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ",
+            "dog ", "<p>", "</p>\n", "<div class=\"x\">", "</div>", "href=",
+        };
+        string s;
+        while (s.size() < 65536)
+        {
+            s += words[rand() % (sizeof(words) / sizeof(words[0]))];
+        }
+        s.resize(65536);
+        return s;
+    }();
+    return kPage;
+}
+
+} // anonymous namespace
+
+BENCHMARK(multi_pattern_64KB_find_each, iters)
+{
+    const string& haystack = page();
+    for (size_t i = 0; i < iters; ++i)
+    {
+        size_t found = 0;
+        for (StringPiece token : tokens())
+        {
+            found += StringPiece(haystack).find(token) != StringPiece::npos;
+        }
+        doNotOptimizeAway(found);
+    }
+}
+
+BENCHMARK(multi_pattern_64KB_matcher, iters)
+{
+    static const MultiPatternMatcher kMatcher(tokens());
+    const string& haystack = page();
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(kMatcher.findAll(haystack).size());
+    }
+}
+
+BENCHMARK(multi_pattern_64KB_matcher_teddy, iters)
+{
+    static const MultiPatternMatcher kMatcher(vector<StringPiece>(
+        tokens().begin(), tokens().begin() + 16));
+    const string& haystack = page();
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(kMatcher.findAll(haystack).size());
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(multi_pattern_1MB_adversarial, iters)
+{
+    static const string kPattern = string(4095, 'a') + "b";
+    static const MultiPatternMatcher kMatcher({ kPattern, "zz" });
+    string haystack;
+    BENCHMARK_SUSPEND
+    {
+        haystack.assign(1 << 20, 'a');
+    }
+    for (size_t i = 0; i < iters; ++i)
+    {
+        doNotOptimizeAway(kMatcher.findAll(haystack).size());
+    }
+}
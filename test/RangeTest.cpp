@@ -27,6 +27,7 @@
 #include <type_traits>
 #include <vector>
 #include <gtest/gtest.h>
+#include "Benchmark.h"
 
 #if defined(__linux__)
 #include <sys/mman.h>
@@ -42,11 +43,29 @@ size_t qfind_first_byte_of_nosse(const StringPiece haystack,
 size_t qfind_first_byte_of_sse42(const StringPiece haystack,
     const StringPiece needles);
 
+size_t qfind_first_byte_of_avx2(const StringPiece haystack,
+    const StringPiece needles);
+
+size_t qfind_first_byte_of_avx512(const StringPiece haystack,
+    const StringPiece needles);
+
 size_t qfind_first_byte_of_byteset(const StringPiece haystack,
     const StringPiece needles);
 
 } // namespace detail
 
+namespace {
+
+// The CPU has the instructions and the OS saves their registers
+bool haveAvx2() { return CpuId().avx2() && CpuId().osSupportsAvx(); }
+
+bool haveAvx512bw()
+{
+    return CpuId().avx512bw() && CpuId().osSupportsAvx512();
+}
+
+} // anonymous namespace
+
 TEST(StringPiece, All)
 {
     const char* foo = "foo";
@@ -455,6 +474,52 @@ TEST(qfind, UInt32_Ranges)
   EXPECT_EQ(qfind(a_range, b_range), 1);
 }
 
+TEST(qfind, Substrings)
+{
+    // Against std::search, on small alphabets so that the needles' first
+    // and last bytes turn up everywhere and long partial matches are common
+    std::mt19937 rng(7);
+    const char* alphabets[] = { "ab", "aAbB", "xyzXYZ@[`{", "a\x80\xff" };
+    for (size_t n = 0; n < 20000; ++n) {
+        const string alphabet = alphabets[n % 4];
+        string haystack(rng() % (n % 10 == 0 ? 2000 : 120), '\0');
+        string needle(rng() % (n % 7 == 0 ? 200 : 10), '\0');
+        for (auto& c : haystack) {
+            c = alphabet[rng() % alphabet.size()];
+        }
+        for (auto& c : needle) {
+            c = alphabet[rng() % alphabet.size()];
+        }
+        if (n % 3 == 0 && needle.size() <= haystack.size()) {
+            haystack.replace(rng() % (haystack.size() - needle.size() + 1),
+                             needle.size(), needle);
+        }
+        StringPiece h(haystack);
+        StringPiece nd(needle);
+        auto exact = std::search(h.begin(), h.end(), nd.begin(), nd.end());
+        auto folded = std::search(h.begin(), h.end(), nd.begin(), nd.end(),
+                                  asciiCaseInsensitive);
+        EXPECT_EQ(exact == h.end() && !nd.empty()
+                  ? StringPiece::npos : exact - h.begin(), h.find(nd)) << n;
+        EXPECT_EQ(folded == h.end() && !nd.empty()
+                  ? StringPiece::npos : folded - h.begin(),
+                  qfind(h, nd, asciiCaseInsensitive)) << n;
+        EXPECT_EQ(exact == h.end() && !nd.empty()
+                  ? StringPiece::npos : exact - h.begin(),
+                  qfind(ByteRange(h), ByteRange(nd))) << n;
+    }
+
+    // Every position is a candidate, and each fails late; this is where the
+    // search goes over to Two-Way
+    string as(1 << 16, 'a');
+    const string needle = string(250, 'a') + "b" + string(250, 'a');
+    EXPECT_EQ(StringPiece::npos, StringPiece(as).find(needle));
+    as.replace(60000, needle.size(), needle);
+    EXPECT_EQ(60000, StringPiece(as).find(needle));
+    EXPECT_EQ(60000, qfind(StringPiece(as), StringPiece("A" + needle.substr(1)),
+                           asciiCaseInsensitive));
+}
+
 template <typename NeedleFinder>
 class NeedleFinderTest : public ::testing::Test {
  public:
@@ -471,6 +536,32 @@ struct SseNeedleFinder {
   }
 };
 
+// Each tier runs where the CPU has it, and is the SSE-less one elsewhere
+struct Sse42NeedleFinder {
+  static size_t find_first_byte_of(StringPiece haystack, StringPiece needles) {
+    static auto const fn = CpuId().sse42() ? detail::qfind_first_byte_of_sse42
+                                           : detail::qfind_first_byte_of_nosse;
+    return fn(haystack, needles);
+  }
+};
+
+struct Avx2NeedleFinder {
+  static size_t find_first_byte_of(StringPiece haystack, StringPiece needles) {
+    static auto const fn = haveAvx2() ? detail::qfind_first_byte_of_avx2
+                                      : detail::qfind_first_byte_of_nosse;
+    return fn(haystack, needles);
+  }
+};
+
+struct Avx512NeedleFinder {
+  static size_t find_first_byte_of(StringPiece haystack, StringPiece needles) {
+    static auto const fn = haveAvx512bw()
+        ? detail::qfind_first_byte_of_avx512
+        : detail::qfind_first_byte_of_nosse;
+    return fn(haystack, needles);
+  }
+};
+
 struct NoSseNeedleFinder {
   static size_t find_first_byte_of(StringPiece haystack, StringPiece needles) {
     return detail::qfind_first_byte_of_nosse(haystack, needles);
@@ -483,9 +574,47 @@ struct ByteSetNeedleFinder {
   }
 };
 
+// The needles as a ByteSet, searched by each tier of its own
+struct PrecompiledNoSseNeedleFinder {
+  static size_t find_first_byte_of(StringPiece haystack, StringPiece needles) {
+    return detail::qfind_byteset_nosse(haystack, ByteSet(needles), true);
+  }
+};
+
+struct PrecompiledSsse3NeedleFinder {
+  static size_t find_first_byte_of(StringPiece haystack, StringPiece needles) {
+    static auto const fn = CpuId().ssse3() ? detail::qfind_byteset_ssse3
+                                           : detail::qfind_byteset_nosse;
+    return fn(haystack, ByteSet(needles), true);
+  }
+};
+
+struct PrecompiledAvx2NeedleFinder {
+  static size_t find_first_byte_of(StringPiece haystack, StringPiece needles) {
+    static auto const fn = haveAvx2() ? detail::qfind_byteset_avx2
+                                      : detail::qfind_byteset_nosse;
+    return fn(haystack, ByteSet(needles), true);
+  }
+};
+
+struct PrecompiledAvx512NeedleFinder {
+  static size_t find_first_byte_of(StringPiece haystack, StringPiece needles) {
+    static auto const fn = haveAvx512bw() ? detail::qfind_byteset_avx512
+                                          : detail::qfind_byteset_nosse;
+    return fn(haystack, ByteSet(needles), true);
+  }
+};
+
 typedef ::testing::Types<SseNeedleFinder,
+                         Sse42NeedleFinder,
+                         Avx2NeedleFinder,
+                         Avx512NeedleFinder,
                          NoSseNeedleFinder,
-                         ByteSetNeedleFinder> NeedleFinders;
+                         ByteSetNeedleFinder,
+                         PrecompiledNoSseNeedleFinder,
+                         PrecompiledSsse3NeedleFinder,
+                         PrecompiledAvx2NeedleFinder,
+                         PrecompiledAvx512NeedleFinder> NeedleFinders;
 TYPED_TEST_CASE(NeedleFinderTest, NeedleFinders);
 
 TYPED_TEST(NeedleFinderTest, Null) 
@@ -575,6 +704,211 @@ TYPED_TEST(NeedleFinderTest, Base)
     }
 }
 
+TYPED_TEST(NeedleFinderTest, Random)
+{
+    // Every length up to a few blocks of the widest vector, with needles
+    // from all of the byte range
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (size_t n = 0; n < 2000; ++n) {
+        string needles(n % 40, '\0');
+        for (auto& c : needles) {
+            c = static_cast<char>(byte(rng));
+        }
+        string s(n % 300, '\0');
+        for (auto& c : s) {
+            c = static_cast<char>(byte(rng));
+        }
+        for (size_t i = 0; i < 8 && !s.empty(); ++i) {
+            StringPiece haystack(s);
+            haystack.advance(i % s.size());
+            auto f = std::find_first_of(haystack.begin(), haystack.end(),
+                needles.begin(), needles.end());
+            auto expected = (f == haystack.end())
+                ? StringPiece::npos : f - haystack.begin();
+            EXPECT_EQ(expected, this->find_first_byte_of(haystack, needles))
+                << n << " " << i;
+        }
+    }
+}
+
+TEST(ByteSet, Basic)
+{
+    static constexpr ByteSet kEmpty;
+    static constexpr ByteSet kDelimiters(",;\t\xff");
+    static constexpr ByteSet kWithNul("a\0b");
+    static_assert(kDelimiters.contains(';') && !kDelimiters.contains(' '), "");
+    static_assert(kDelimiters.contains('\xff'), "");
+    static_assert(!kDelimiters.contains('\x7f'), "");
+    static_assert(kWithNul.contains('\0') && !kEmpty.contains('\0'), "");
+
+    for (int i = 0; i < 256; ++i) {
+        const char c = static_cast<char>(i);
+        EXPECT_EQ(c == ',' || c == ';' || c == '\t' || c == '\xff',
+                  kDelimiters.contains(c)) << i;
+        EXPECT_TRUE(ByteSet(StringPiece(&c, 1)).contains(c)) << i;
+        EXPECT_FALSE(kEmpty.contains(c)) << i;
+    }
+
+    StringPiece sp("key=value;x,y");
+    EXPECT_EQ(9, sp.find_first_of(kDelimiters));
+    EXPECT_EQ(11, sp.find_first_of(kDelimiters, 10));
+    EXPECT_EQ(StringPiece::npos, sp.find_first_of(kDelimiters, 12));
+    EXPECT_EQ(StringPiece::npos, sp.find_first_of(kDelimiters, 100));
+    EXPECT_EQ(9, qfind_first_of(ByteRange(sp), kDelimiters));
+    EXPECT_EQ(StringPiece::npos, qfind_first_of(sp, kEmpty));
+    EXPECT_EQ(4, qfind_first_not_of(StringPiece(" \t \tx"), ByteSet(" \t")));
+    EXPECT_EQ(StringPiece::npos,
+              qfind_first_not_of(StringPiece(" \t"), ByteSet(" \t")));
+    EXPECT_EQ(0, qfind_first_not_of(StringPiece("x"), kEmpty));
+}
+
+TEST(ByteSet, FirstNotOf)
+{
+    typedef size_t (*Finder)(StringPiece, const ByteSet&, bool);
+    const Finder finders[] = {
+        detail::qfind_byteset_nosse,
+        CpuId().ssse3() ? detail::qfind_byteset_ssse3
+                        : detail::qfind_byteset_nosse,
+        haveAvx2() ? detail::qfind_byteset_avx2
+                   : detail::qfind_byteset_nosse,
+        haveAvx512bw() ? detail::qfind_byteset_avx512
+                       : detail::qfind_byteset_nosse,
+    };
+    // Runs of bytes from the set, now and then broken by one that isn't
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (size_t n = 0; n < 2000; ++n) {
+        string members(1 + n % 40, '\0');
+        for (auto& c : members) {
+            c = static_cast<char>(byte(rng));
+        }
+        const ByteSet set(members);
+        string s(n % 300, '\0');
+        for (auto& c : s) {
+            c = byte(rng) < 4 ? static_cast<char>(byte(rng))
+                              : members[byte(rng) % members.size()];
+        }
+        for (size_t i = 0; i < 8 && !s.empty(); ++i) {
+            StringPiece haystack(s);
+            haystack.advance(i % s.size());
+            auto f = std::find_if(haystack.begin(), haystack.end(),
+                [&](char c) {
+                    return members.find(c) == string::npos;
+                });
+            auto expected = (f == haystack.end())
+                ? StringPiece::npos : f - haystack.begin();
+            for (auto finder : finders) {
+                EXPECT_EQ(expected, finder(haystack, set, false))
+                    << n << " " << i;
+            }
+        }
+    }
+}
+
+TEST(ByteSet, Reverse)
+{
+    typedef size_t (*Finder)(StringPiece, const ByteSet&, bool);
+    const Finder finders[] = {
+        detail::rfind_byteset_nosse,
+        CpuId().ssse3() ? detail::rfind_byteset_ssse3
+                        : detail::rfind_byteset_nosse,
+        haveAvx2() ? detail::rfind_byteset_avx2
+                   : detail::rfind_byteset_nosse,
+        haveAvx512bw() ? detail::rfind_byteset_avx512
+                       : detail::rfind_byteset_nosse,
+    };
+    typedef size_t (*ByteFinder)(StringPiece, char);
+    const ByteFinder byteFinders[] = {
+        detail::rfind_byte_nosse,
+        CpuId().sse2() ? detail::rfind_byte_sse2 : detail::rfind_byte_nosse,
+        haveAvx2() ? detail::rfind_byte_avx2 : detail::rfind_byte_nosse,
+        haveAvx512bw() ? detail::rfind_byte_avx512
+                       : detail::rfind_byte_nosse,
+    };
+    // Mostly bytes from the set, so both searches find something nearby
+    // as often as far away or not at all
+    std::mt19937 rng(43);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (size_t n = 0; n < 2000; ++n) {
+        string members(1 + n % 40, '\0');
+        for (auto& c : members) {
+            c = static_cast<char>(byte(rng));
+        }
+        const ByteSet set(members);
+        const int odds = 1 + n % 64;
+        string s(n % 300, '\0');
+        for (auto& c : s) {
+            c = byte(rng) < odds ? static_cast<char>(byte(rng))
+                                 : members[byte(rng) % members.size()];
+        }
+        for (size_t i = 0; i < 8 && !s.empty(); ++i) {
+            StringPiece haystack(s);
+            haystack.subtract(i % s.size());
+            const string str = haystack.str();
+            const size_t lastOf = str.find_last_of(members);
+            const size_t lastNotOf = str.find_last_not_of(members);
+            for (auto finder : finders) {
+                EXPECT_EQ(lastOf, finder(haystack, set, true)) << n << " " << i;
+                EXPECT_EQ(lastNotOf, finder(haystack, set, false))
+                    << n << " " << i;
+            }
+            for (auto finder : byteFinders) {
+                EXPECT_EQ(str.rfind(members[0]), finder(haystack, members[0]))
+                    << n << " " << i;
+            }
+        }
+    }
+}
+
+TEST(Range, NotOfAndLastOf)
+{
+    StringPiece sp("  key = value;  ");
+    EXPECT_EQ(2, sp.find_first_not_of(" "));
+    EXPECT_EQ(6, sp.find_first_not_of(" ", 5));
+    EXPECT_EQ(StringPiece::npos, sp.find_first_not_of(" ", 16));
+    EXPECT_EQ(StringPiece::npos, sp.find_first_not_of(" ", 100));
+    EXPECT_EQ(2, sp.find_first_not_of(' '));
+    EXPECT_EQ(2, sp.find_first_not_of(ByteSet(" \t")));
+    EXPECT_EQ(13, sp.find_last_of("=;"));
+    EXPECT_EQ(13, sp.find_last_of(';'));
+    EXPECT_EQ(13, sp.find_last_of(ByteSet("=;")));
+    EXPECT_EQ(13, sp.find_last_not_of(" "));
+    EXPECT_EQ(13, sp.find_last_not_of(' '));
+    EXPECT_EQ(12, sp.find_last_not_of(ByteSet(" ;")));
+    EXPECT_EQ(StringPiece::npos, sp.find_last_of("xz"));
+    EXPECT_EQ(StringPiece::npos, sp.find_last_not_of(ByteSet(" ;=aekluvy")));
+    EXPECT_EQ(StringPiece::npos, StringPiece().find_last_of(' '));
+    EXPECT_EQ(StringPiece::npos, StringPiece().find_first_not_of(' '));
+    EXPECT_EQ(8, ByteRange(sp).find_last_of(ByteSet("kv")));
+
+    // No needles: nothing is one of them, everything isn't
+    EXPECT_EQ(StringPiece::npos, sp.find_last_of(""));
+    EXPECT_EQ(0, sp.find_first_not_of(""));
+    EXPECT_EQ(15, sp.find_last_not_of(""));
+
+    // Past the 16 bytes each kernel probes first
+    const string path = string(100, 'd') + "/dir/" + string(50, 'f') + "  ";
+    EXPECT_EQ(104, StringPiece(path).find_last_of('/'));
+    EXPECT_EQ(104, StringPiece(path).find_last_of(ByteSet("/\\")));
+    EXPECT_EQ(154, StringPiece(path).find_last_not_of(ByteSet(" \t")));
+    EXPECT_EQ(102, StringPiece(path).find_first_not_of(ByteSet("d/")));
+
+    // Ranges of anything else compare element by element
+    const vector<int> v = { 1, 2, 3, 2, 1 };
+    const int ones[] = { 1 };
+    const int twos[] = { 2 };
+    const int onesAndTwos[] = { 1, 2 };
+    Range<const int*> r(v.data(), v.size());
+    EXPECT_EQ(1, r.find_first_not_of(Range<const int*>(ones, 1)));
+    EXPECT_EQ(3, r.find_last_of(Range<const int*>(twos, 1)));
+    EXPECT_EQ(3, r.find_last_not_of(Range<const int*>(ones, 1)));
+    EXPECT_EQ(2, r.find_last_not_of(Range<const int*>(onesAndTwos, 2)));
+    EXPECT_EQ(4, r.find_last_of(1));
+    EXPECT_EQ(StringPiece::npos,
+              r.find_first_not_of(Range<const int*>(v.data(), v.size())));
+}
+
 #if defined(__linux__)
 const size_t kPageSize = 4096;
 // Updates contents so that any read accesses past the last byte will
@@ -836,3 +1170,224 @@ TEST(Range, Constructors)
     EXPECT_EQ(subpiece1.begin(), subpiece2.begin());
     EXPECT_EQ(subpiece1.end(), subpiece2.end());
 }
+
+namespace {
+
+// 4KB of text where the needles first show up at the very end
+string firstOfHaystack()
+{
+    string s;
+    while (s.size() < 4096) {
+        s.append("lorem ipsum dolor sit amet consectetur adipiscing elit ");
+    }
+    s.resize(4096);
+    s.back() = '\n';
+    return s;
+}
+
+template <class Fn>
+void benchmarkFirstOf(size_t iters, Fn fn, StringPiece needles)
+{
+    string haystack;
+    BENCHMARK_SUSPEND {
+        haystack = firstOfHaystack();
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        doNotOptimizeAway(fn(haystack, needles));
+    }
+}
+
+}  // namespace
+
+BENCHMARK(qfind_first_of_4KB_3_needles_sse42, iters)
+{
+    benchmarkFirstOf(iters, detail::qfind_first_byte_of_sse42, ",;\n");
+}
+
+BENCHMARK(qfind_first_of_4KB_3_needles_avx2, iters)
+{
+    benchmarkFirstOf(iters, detail::qfind_first_byte_of_avx2, ",;\n");
+}
+
+BENCHMARK(qfind_first_of_4KB_3_needles, iters)
+{
+    benchmarkFirstOf(iters, detail::qfind_first_byte_of, ",;\n");
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(qfind_first_of_4KB_24_needles_sse42, iters)
+{
+    benchmarkFirstOf(iters, detail::qfind_first_byte_of_sse42,
+                     "\t\n\r\"#$%&'()*+,/:;<=>?@[\\]^");
+}
+
+BENCHMARK(qfind_first_of_4KB_24_needles_avx2, iters)
+{
+    benchmarkFirstOf(iters, detail::qfind_first_byte_of_avx2,
+                     "\t\n\r\"#$%&'()*+,/:;<=>?@[\\]^");
+}
+
+BENCHMARK(qfind_first_of_4KB_24_needles, iters)
+{
+    benchmarkFirstOf(iters, detail::qfind_first_byte_of,
+                     "\t\n\r\"#$%&'()*+,/:;<=>?@[\\]^");
+}
+
+BENCHMARK(qfind_first_of_4KB_24_needles_byteset, iters)
+{
+    static FOLLY_CONSTEXPR ByteSet kNeedles("\t\n\r\"#$%&'()*+,/:;<=>?@[\\]^");
+    string haystack;
+    BENCHMARK_SUSPEND {
+        haystack = firstOfHaystack();
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        doNotOptimizeAway(qfind_first_of(StringPiece(haystack), kNeedles));
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+namespace {
+
+// The fields of a line of short delimited fields, one find at a time
+template <class Fn>
+void benchmarkFields(size_t iters, Fn fn)
+{
+    string line;
+    BENCHMARK_SUSPEND {
+        while (line.size() < 1024) {
+            line.append("id=42;name,alice;tag=x,y;ts 1423001234;");
+        }
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        StringPiece rest(line);
+        size_t fields = 0;
+        for (size_t pos; (pos = fn(rest)) != StringPiece::npos; ++fields) {
+            rest.advance(pos + 1);
+        }
+        doNotOptimizeAway(fields);
+    }
+}
+
+}  // namespace
+
+BENCHMARK(qfind_first_of_1KB_fields, iters)
+{
+    benchmarkFields(iters, [](StringPiece rest) {
+        return qfind_first_of(rest, StringPiece(";, ="));
+    });
+}
+
+BENCHMARK(qfind_first_of_1KB_fields_byteset, iters)
+{
+    static FOLLY_CONSTEXPR ByteSet kDelimiters(";, =");
+    benchmarkFields(iters, [](StringPiece rest) {
+        return qfind_first_of(rest, kDelimiters);
+    });
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(rfind_64KB_nosse, iters)
+{
+    string haystack;
+    BENCHMARK_SUSPEND {
+        haystack.assign(64 * 1024, 'a');
+        haystack[0] = '/';
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        doNotOptimizeAway(detail::rfind_byte_nosse(haystack, '/'));
+    }
+}
+
+BENCHMARK(rfind_64KB, iters)
+{
+    string haystack;
+    BENCHMARK_SUSPEND {
+        haystack.assign(64 * 1024, 'a');
+        haystack[0] = '/';
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        doNotOptimizeAway(StringPiece(haystack).rfind('/'));
+    }
+}
+
+BENCHMARK(find_last_not_of_1KB_trailing_space_string, iters)
+{
+    string line;
+    BENCHMARK_SUSPEND {
+        line = "key=value" + string(1024, ' ');
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        doNotOptimizeAway(line.find_last_not_of(" \t\r\n"));
+    }
+}
+
+BENCHMARK(find_last_not_of_1KB_trailing_space_byteset, iters)
+{
+    static const ByteSet kSpaces(" \t\r\n");
+    string line;
+    BENCHMARK_SUSPEND {
+        line = "key=value" + string(1024, ' ');
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        doNotOptimizeAway(StringPiece(line).find_last_not_of(kSpaces));
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+namespace {
+
+// 64KB of text with mixed case and the needle at the very end
+string substringHaystack()
+{
+    string s;
+    while (s.size() < 64 * 1024) {
+        s.append("the quick brown fox jumps over the lazy dog, ");
+        s.append("then THE QUICK BROWN CAT naps. ");
+    }
+    s.resize(64 * 1024);
+    s.replace(s.size() - 12, 12, "the lazy cat");
+    return s;
+}
+
+}  // namespace
+
+BENCHMARK(qfind_64KB_pedestrian, iters)
+{
+    string haystack;
+    BENCHMARK_SUSPEND {
+        haystack = substringHaystack();
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        doNotOptimizeAway(detail::qfind_subrange(
+            StringPiece(haystack), StringPiece("the lazy cat"),
+            asciiCaseSensitive, std::integral_constant<int, 0>()));
+    }
+}
+
+BENCHMARK(qfind_64KB, iters)
+{
+    string haystack;
+    BENCHMARK_SUSPEND {
+        haystack = substringHaystack();
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        doNotOptimizeAway(StringPiece(haystack).find("the lazy cat"));
+    }
+}
+
+BENCHMARK(qfind_64KB_case_insensitive, iters)
+{
+    string haystack;
+    BENCHMARK_SUSPEND {
+        haystack = substringHaystack();
+    }
+    for (size_t i = 0; i < iters; ++i) {
+        doNotOptimizeAway(qfind(StringPiece(haystack),
+                                StringPiece("THE LAZY CAT"),
+                                asciiCaseInsensitive));
+    }
+}
@@ -19,8 +19,10 @@
 #include <cstdarg>
 #include <random>
 #include <memory>
+#include <set>
 #include <gtest/gtest.h>
 #include "ScopeGuard.h"
+#include "Benchmark.h"
 
 using namespace std;
 
@@ -187,6 +189,34 @@ TEST(Escape, cUnescape) {
                std::invalid_argument);
   EXPECT_THROW({cUnescape("hello\\q");},
                std::invalid_argument);
+
+  EXPECT_EQ("hello\\", cUnescape("hello\\", false));
+  const string plain(100, 'p');
+  EXPECT_EQ(plain + "\n" + plain + "\\",
+            cUnescape(plain + "\\n" + plain + "\\\\"));
+  EXPECT_EQ(plain, cUnescape(plain));
+}
+
+TEST(Escape, cEscapeLong)
+{
+    // Every byte at every position of strings long enough for the vector
+    // paths, against the escape of the byte on its own
+    string plain;
+    for (int i = 0; i < 70; ++i) {
+        plain.push_back('a' + i % 26);
+    }
+    for (int c = 0; c < 256; ++c) {
+        const string escaped = cEscape(string(1, c));
+        for (size_t i = 0; i < plain.size(); ++i) {
+            string in = plain;
+            in[i] = c;
+            string expected = plain.substr(0, i) + escaped + plain.substr(i + 1);
+            ASSERT_EQ(expected, cEscape(in)) << c << " at " << i;
+            ASSERT_EQ(in, cUnescape(cEscape(in))) << c << " at " << i;
+        }
+    }
+    EXPECT_EQ("\\?\\\"" + plain + "\\177",
+              cEscape("?\"" + plain + "\x7f"));
 }
 
 TEST(Escape, uriEscape) 
@@ -257,6 +287,70 @@ bool isHex(int v)
 }  // namespace
 
 
+TEST(Escape, uriEscapeLong)
+{
+    // Every byte at every position of strings long enough for the vector
+    // paths, in each mode, against the escape of the byte on its own
+    const UriEscapeMode modes[] = {
+        UriEscapeMode::ALL, UriEscapeMode::QUERY, UriEscapeMode::PATH,
+    };
+    const string plain =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.~";
+    for (auto mode : modes) {
+        for (int c = 0; c < 256; ++c) {
+            const string escaped = uriEscape(string(1, c), mode);
+            for (size_t i = 0; i < plain.size(); ++i) {
+                string in = plain;
+                in[i] = c;
+                ASSERT_EQ(plain.substr(0, i) + escaped + plain.substr(i + 1),
+                          uriEscape(in, mode)) << c << " at " << i;
+                ASSERT_EQ(in, uriUnescape(uriEscape(in, mode), mode));
+            }
+        }
+    }
+}
+
+TEST(Escape, uriUnescapeLong)
+{
+    // Runs of "%XX" long enough to be decoded several at a time
+    string binary;
+    for (int i = 0; i < 256; ++i) {
+        binary.push_back(i);
+    }
+    const string encoded = uriEscape(binary);
+    EXPECT_EQ(binary, uriUnescape(encoded));
+    string upper = encoded;
+    for (size_t i = 0; i < upper.size(); ++i) {
+        if (upper[i] == '%') {
+            upper[i + 1] = toupper(upper[i + 1]);
+            upper[i + 2] = toupper(upper[i + 2]);
+        }
+    }
+    EXPECT_EQ(binary, uriUnescape(upper));
+    EXPECT_EQ("a b+c", uriUnescape(string("a+b%2bc"), UriEscapeMode::QUERY));
+
+    // Nothing but hex digits, whatever their case bit
+    string control = encoded.substr(0, 30);
+    control[14] = 0x13;
+    EXPECT_THROW(uriUnescape(control), std::invalid_argument);
+
+    // A bad sequence inside a run is still found
+    const string run = encoded.substr(0, 60);
+    for (size_t i = 0; i < run.size(); ++i) {
+        string bad = run;
+        if (i % 3 == 0) {
+            bad[i] = 'x';
+            EXPECT_EQ(uriUnescape(run.substr(0, i)) + "x" +
+                      run.substr(i + 1, 2) + uriUnescape(run.substr(i + 3)),
+                      uriUnescape(bad)) << i;
+        }
+        else {
+            bad[i] = 'g';
+            EXPECT_THROW(uriUnescape(bad), std::invalid_argument) << i;
+        }
+    }
+}
+
 TEST(Escape, uriUnescapePercentDecoding) 
 {
     char c[4] = { '%', '\0', '\0', '\0' };
@@ -759,6 +853,46 @@ TEST(Split, pieces_vector)
     }
 }
 
+TEST(Split, byte_set)
+{
+    static FOLLY_CONSTEXPR ByteSet kSeparators(",; ");
+    vector<StringPiece> pieces;
+    split(kSeparators, "a,b; c", pieces);
+    ASSERT_EQ(4, pieces.size());
+    EXPECT_EQ("a", pieces[0]);
+    EXPECT_EQ("b", pieces[1]);
+    EXPECT_EQ("", pieces[2]);
+    EXPECT_EQ("c", pieces[3]);
+    pieces.clear();
+
+    split(kSeparators, "a,b; c", pieces, true);
+    ASSERT_EQ(3, pieces.size());
+    EXPECT_EQ("c", pieces[2]);
+    pieces.clear();
+
+    split(kSeparators, "", pieces);
+    ASSERT_EQ(1, pieces.size());
+    EXPECT_EQ("", pieces[0]);
+    pieces.clear();
+    split(kSeparators, "", pieces, true);
+    EXPECT_TRUE(pieces.empty());
+
+    // Long enough for the SIMD search, and the same as splitting on a char
+    string line;
+    for (int i = 0; i < 100; ++i) {
+        line.append(i % 7 == 0 ? ",," : "field,");
+    }
+    vector<string> expected, parts;
+    split(',', line, expected);
+    split(ByteSet(","), line, parts);
+    EXPECT_EQ(expected, parts);
+
+    std::set<StringPiece> unique;
+    splitTo<StringPiece>(kSeparators, "x y,x;z", std::inserter(unique,
+        unique.begin()));
+    EXPECT_EQ(3, unique.size());
+}
+
 TEST(Split, fixed) 
 {
     StringPiece a, b, c, d;
@@ -952,6 +1086,60 @@ TEST(String, unhexlify)
     EXPECT_FALSE(unhexlify(input4, output4));
 }
 
+TEST(String, hexlifyLong)
+{
+    // Long enough for the vector paths, with every byte value
+    string binary;
+    for (int i = 0; i < 300; ++i) {
+        binary.push_back(static_cast<char>(i * 7));
+    }
+    string hex;
+    EXPECT_TRUE(hexlify(binary, hex));
+    ASSERT_EQ(600, hex.size());
+    for (size_t i = 0; i < binary.size(); ++i) {
+        EXPECT_EQ(stringPrintf("%02x", binary[i] & 0xff), hex.substr(2 * i, 2));
+    }
+    string back;
+    EXPECT_TRUE(unhexlify(hex, back));
+    EXPECT_EQ(binary, back);
+
+    string upper = hex;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    EXPECT_TRUE(unhexlify(upper, back));
+    EXPECT_EQ(binary, back);
+
+    // A bad digit anywhere is found
+    for (size_t i = 0; i < 130; ++i) {
+        string bad = hex.substr(0, 130);
+        bad[i] = i % 2 ? 'g' : '\x10';
+        EXPECT_FALSE(unhexlify(bad, back)) << i;
+    }
+}
+
+TEST(String, hexlifyBuffer)
+{
+    const string digest = "\xda\x39\xa3\xee\x5e\x6b\x4b\x0d\x32\x55"
+                          "\xbf\xef\x95\x60\x18\x90\xaf\xd8\x07\x09";
+    char buffer[41];
+    MutableStringPiece out(buffer, sizeof(buffer));
+    EXPECT_TRUE(hexlify(digest, &out));
+    EXPECT_EQ(1, out.size());
+    EXPECT_EQ("da39a3ee5e6b4b0d3255bfef95601890afd80709",
+              StringPiece(buffer, 40));
+    EXPECT_FALSE(hexlify("x", &out));
+    EXPECT_EQ(1, out.size());
+
+    char bytes[20];
+    MutableStringPiece raw(bytes, sizeof(bytes));
+    EXPECT_FALSE(unhexlify("abc", &raw));
+    EXPECT_FALSE(unhexlify("zz", &raw));
+    EXPECT_EQ(20, raw.size());
+    EXPECT_TRUE(unhexlify(StringPiece(buffer, 40), &raw));
+    EXPECT_TRUE(raw.empty());
+    EXPECT_EQ(digest, string(bytes, sizeof(bytes)));
+    EXPECT_FALSE(unhexlify("00", &raw));
+}
+
 TEST(String, backslashify) 
 {
     EXPECT_EQ("abc", string("abc"));
@@ -1036,6 +1224,20 @@ void testToLowerAscii(Range<const char*> src)
 
 } // anon namespace
 
+TEST(String, skipWhitespace)
+{
+    EXPECT_EQ("x y ", skipWhitespace(" \t\r\nx y "));
+    EXPECT_EQ("", skipWhitespace(" \t"));
+
+    const ByteSet kBlanks(" \t\v");
+    EXPECT_EQ("\nx", skipWhitespace("\v \t\nx", kBlanks));
+    EXPECT_EQ("x", skipWhitespace(string(100, ' ') + "x", kBlanks));
+    const string blanks(100, '\t');
+    const StringPiece rest = skipWhitespace(blanks, kBlanks);
+    EXPECT_TRUE(rest.empty());
+    EXPECT_EQ(blanks.data() + blanks.size(), rest.data());
+}
+
 TEST(String, toLowerAsciiAligned) 
 {
     static const size_t kSize = 256;
@@ -1064,3 +1266,147 @@ TEST(String, toLowerAsciiUnaligned)
         }
     }
 }
+
+namespace {
+
+// A payload of plain ASCII with an escape every few hundred bytes
+string escapeBenchmarkInput()
+{
+    string s;
+    for (size_t i = 0; s.size() < 64 * 1024; ++i) {
+        s.append("The quick brown fox jumps over the lazy dog; ");
+        if (i % 8 == 7) {
+            s.push_back('\n');
+        }
+    }
+    return s;
+}
+
+}  // namespace
+
+BENCHMARK(cEscape_64KB_ascii, iters)
+{
+    string input;
+    BENCHMARK_SUSPEND {
+        input = escapeBenchmarkInput();
+    }
+    string out;
+    for (size_t i = 0; i < iters; ++i) {
+        out.clear();
+        cEscape(input, out);
+        doNotOptimizeAway(out.size());
+    }
+}
+
+BENCHMARK(cUnescape_64KB_ascii, iters)
+{
+    string input;
+    BENCHMARK_SUSPEND {
+        input = cEscape(escapeBenchmarkInput());
+    }
+    string out;
+    for (size_t i = 0; i < iters; ++i) {
+        out.clear();
+        cUnescape(input, out);
+        doNotOptimizeAway(out.size());
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(uriEscape_64KB_query, iters)
+{
+    string input;
+    BENCHMARK_SUSPEND {
+        for (size_t i = 0; input.size() < 64 * 1024; ++i) {
+            input.append("session_id=8f14e45fceea167a5a36dedd4bea2543");
+            input.append(i % 4 == 0 ? "&q=caf\xc3\xa9 au lait&" : "&lang=en-US&");
+        }
+    }
+    string out;
+    for (size_t i = 0; i < iters; ++i) {
+        out.clear();
+        uriEscape(input, out, UriEscapeMode::QUERY);
+        doNotOptimizeAway(out.size());
+    }
+}
+
+BENCHMARK(uriUnescape_64KB_query, iters)
+{
+    string input;
+    BENCHMARK_SUSPEND {
+        string plain;
+        for (size_t i = 0; plain.size() < 64 * 1024; ++i) {
+            plain.append("session_id=8f14e45fceea167a5a36dedd4bea2543");
+            plain.append(i % 4 == 0 ? "&q=caf\xc3\xa9 au lait&" : "&lang=en-US&");
+        }
+        input = uriEscape(plain, UriEscapeMode::QUERY);
+    }
+    string out;
+    for (size_t i = 0; i < iters; ++i) {
+        out.clear();
+        uriUnescape(input, out, UriEscapeMode::QUERY);
+        doNotOptimizeAway(out.size());
+    }
+}
+
+BENCHMARK(uriUnescape_64KB_utf8, iters)
+{
+    string input;
+    BENCHMARK_SUSPEND {
+        string text;
+        while (text.size() < 24 * 1024) {
+            text.append("\xe4\xb8\xad\xe6\x96\x87\xe6\xa3\x80\xe7\xb4\xa2 ");
+        }
+        input = uriEscape(text);
+    }
+    string out;
+    for (size_t i = 0; i < iters; ++i) {
+        out.clear();
+        uriUnescape(input, out);
+        doNotOptimizeAway(out.size());
+    }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(hexlify_20_bytes_to_buffer, iters)
+{
+    const string digest(20, '\xa7');
+    char buffer[40];
+    for (size_t i = 0; i < iters; ++i) {
+        MutableStringPiece out(buffer, sizeof(buffer));
+        hexlify(digest, &out);
+        doNotOptimizeAway(buffer[i % 40]);
+    }
+}
+
+BENCHMARK(hexlify_4KB, iters)
+{
+    string input(4096, '\0');
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<char>(i * 131);
+    }
+    string out;
+    for (size_t i = 0; i < iters; ++i) {
+        hexlify(input, out);
+        doNotOptimizeAway(out.size());
+    }
+}
+
+BENCHMARK(unhexlify_8KB, iters)
+{
+    string input;
+    BENCHMARK_SUSPEND {
+        string binary(4096, '\0');
+        for (size_t i = 0; i < binary.size(); ++i) {
+            binary[i] = static_cast<char>(i * 131);
+        }
+        hexlify(binary, input);
+    }
+    string out;
+    for (size_t i = 0; i < iters; ++i) {
+        unhexlify(input, out);
+        doNotOptimizeAway(out.size());
+    }
+}